@@ -0,0 +1,226 @@
+#pragma once
+
+#include "MarketDataEvent.h"
+#include "SymbolTable.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// Deterministic multi-symbol OHLCV + bid/ask bars in the data/*.csv schema.
+//
+// Each symbol follows a geometric random walk with its own start price and
+// volatility. Bars come out interleaved by timestamp (every symbol's bar i,
+// then every symbol's bar i + 1), like a merged market file. The generator
+// uses its own RNG and Box-Muller transform instead of <random>
+// distributions, whose output differs between standard libraries. A seed
+// reproduces the same file with the same build; other compilers or libm
+// versions may round std::log/std::cos differently in the last digits.
+class SyntheticMarketData {
+private:
+    static constexpr const char* HEADER =
+        "timestamp,symbol,open,high,low,close,adj_close,volume,bid,ask\n";
+    
+    struct SymbolState {
+        SymbolId id;
+        std::string name;
+        double close;
+        double volatility;  // Per bar
+        double spread_bps;
+        double volume_base;
+    };
+    
+    uint64_t rng_state_;
+    std::time_t start_;
+    std::time_t interval_;
+    std::vector<SymbolState> symbols_;
+    size_t bar_ = 0;     // Index of the bar being generated
+    size_t next_ = 0;    // Next symbol within that bar
+    bool has_spare_ = false;
+    double spare_ = 0.0;
+    
+    // splitmix64
+    uint64_t next_u64() {
+        uint64_t z = (rng_state_ += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+    
+    // Uniform in (0, 1)
+    double uniform() {
+        return (static_cast<double>(next_u64() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    }
+    
+    double normal() {
+        if (has_spare_) {
+            has_spare_ = false;
+            return spare_;
+        }
+        double radius = std::sqrt(-2.0 * std::log(uniform()));
+        double angle = 6.283185307179586 * uniform();
+        spare_ = radius * std::sin(angle);
+        has_spare_ = true;
+        return radius * std::cos(angle);
+    }
+    
+    static void write_row(FILE* file, const std::string& timestamp, const MarketDataEvent& e) {
+        fprintf(file, "%s,%s,%.4f,%.4f,%.4f,%.4f,%.4f,%lld,%.4f,%.4f\n",
+                timestamp.c_str(), e.symbol().c_str(), e.open, e.high, e.low, e.close,
+                e.adj_close, e.volume, e.bid, e.ask);
+    }
+    
+public:
+    // Bars start at 2018-01-02T00:00:00Z and are interval_seconds apart.
+    SyntheticMarketData(size_t symbol_count, uint64_t seed = 42, std::time_t interval_seconds = 60)
+        : rng_state_(seed), start_(1514851200), interval_(interval_seconds) {
+        symbols_.reserve(symbol_count);
+        for (size_t i = 0; i < symbol_count; ++i) {
+            char name[32];
+            snprintf(name, sizeof(name), "SYM%04zu", i);
+            
+            SymbolState state;
+            state.name = name;
+            state.id = SymbolTable::instance().intern(state.name);
+            state.close = 20.0 + 480.0 * uniform();
+            state.volatility = 0.001 + 0.003 * uniform();
+            state.spread_bps = 1.0 + 9.0 * uniform();
+            state.volume_base = 1e5 + 9.9e6 * uniform();
+            symbols_.push_back(state);
+        }
+    }
+    
+    size_t symbol_count() const {
+        return symbols_.size();
+    }
+    
+    // Produces the next bar; never runs out.
+    MarketDataEvent next() {
+        SymbolState& s = symbols_[next_];
+        
+        double open = s.close * std::exp(0.25 * s.volatility * normal());
+        double close = open * std::exp(s.volatility * normal());
+        double high = std::max(open, close) * (1.0 + 0.5 * s.volatility * std::fabs(normal()));
+        double low = std::min(open, close) * (1.0 - 0.5 * s.volatility * std::fabs(normal()));
+        double half_spread = close * s.spread_bps * 0.5e-4;
+        long long volume = static_cast<long long>(s.volume_base * std::exp(0.5 * normal()));
+        s.close = close;
+        
+        MarketDataEvent event(start_ + static_cast<std::time_t>(bar_) * interval_, s.id,
+                              open, high, low, close, close * 0.94, volume,
+                              close - half_spread, close + half_spread);
+        
+        if (++next_ == symbols_.size()) {
+            next_ = 0;
+            ++bar_;
+        }
+        return event;
+    }
+    
+    std::vector<MarketDataEvent> generate(size_t count) {
+        std::vector<MarketDataEvent> events;
+        events.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            events.push_back(next());
+        }
+        return events;
+    }
+    
+    // Writes count bars to filename. Returns false if it cannot be written.
+    bool write_csv(const std::string& filename, size_t count) {
+        FILE* file = fopen(filename.c_str(), "wb");
+        if (file == nullptr) {
+            printf("[ERROR] Could not open file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        fputs(HEADER, file);
+        
+        std::string timestamp;
+        std::time_t formatted = -1;
+        
+        for (size_t i = 0; i < count; ++i) {
+            MarketDataEvent e = next();
+            if (e.timestamp != formatted) {
+                timestamp = format_timestamp(e.timestamp);
+                formatted = e.timestamp;
+            }
+            write_row(file, timestamp, e);
+        }
+        
+        bool ok = fclose(file) == 0;
+        if (!ok) {
+            printf("[ERROR] Could not write file: %s\n", filename.c_str());
+        }
+        return ok;
+    }
+    
+    // Writes count bars split into one directory/SYMnnnn.csv per symbol, the
+    // layout MergedSource reads. Returns the file names, or nothing on failure.
+    std::vector<std::string> write_symbol_files(const std::string& directory, size_t count) {
+        std::vector<std::string> filenames;
+        std::vector<FILE*> files;
+        bool ok = true;
+        
+        for (const SymbolState& s : symbols_) {
+            filenames.push_back(directory + "/" + s.name + ".csv");
+            FILE* file = fopen(filenames.back().c_str(), "wb");
+            if (file == nullptr) {
+                printf("[ERROR] Could not open file: %s\n", filenames.back().c_str());
+                ok = false;
+                break;
+            }
+            fputs(HEADER, file);
+            files.push_back(file);
+        }
+        
+        std::string timestamp;
+        std::time_t formatted = -1;
+        
+        for (size_t i = 0; i < count && ok; ++i) {
+            size_t symbol = next_;
+            MarketDataEvent e = next();
+            if (e.timestamp != formatted) {
+                timestamp = format_timestamp(e.timestamp);
+                formatted = e.timestamp;
+            }
+            write_row(files[symbol], timestamp, e);
+        }
+        
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (fclose(files[i]) != 0 && ok) {
+                printf("[ERROR] Could not write file: %s\n", filenames[i].c_str());
+                ok = false;
+            }
+        }
+        if (!ok) filenames.clear();
+        return filenames;
+    }
+    
+    // ISO-8601 UTC (2018-01-02T09:30:00Z) without gmtime, using the inverse
+    // of Utils::days_from_civil (Howard Hinnant's civil_from_days).
+    static std::string format_timestamp(std::time_t timestamp) {
+        long long seconds = static_cast<long long>(timestamp);
+        long long days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+        long long of_day = seconds - days * 86400;
+        
+        days += 719468;
+        const long long era = (days >= 0 ? days : days - 146096) / 146097;
+        const unsigned doe = static_cast<unsigned>(days - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        const unsigned day = doy - (153 * mp + 2) / 5 + 1;
+        const unsigned month = mp < 10 ? mp + 3 : mp - 9;
+        const long long year = static_cast<long long>(yoe) + era * 400 + (month <= 2 ? 1 : 0);
+        
+        char out[64];
+        snprintf(out, sizeof(out), "%04lld-%02u-%02uT%02d:%02d:%02dZ", year, month, day,
+                 static_cast<int>(of_day / 3600), static_cast<int>(of_day / 60 % 60),
+                 static_cast<int>(of_day % 60));
+        return out;
+    }
+};
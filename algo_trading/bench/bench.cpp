@@ -0,0 +1,690 @@
+#include "SyntheticData.h"
+#include "BacktestingEngine.h"
+#include "FeedHandler.h"
+#include "FeedReplayServer.h"
+#include "MarketDataSource.h"
+#include "MovingAverageStrategy.h"
+#include "PerformanceAnalytics.h"
+#include "Portfolio.h"
+#include "SpscRingBuffer.h"
+#include "ThreadSafeQueue.h"
+#include "TradeLogger.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Microbenchmarks for the backtester's hot paths, plus an end-to-end engine
+// run against a mock model. Inputs come from SyntheticMarketData, so every
+// run with the same --rows/--symbols/--seed measures the same work.
+
+static void print_usage(const char* program) {
+    printf("Usage:\n");
+    printf("  %s [options]                       Run the benchmarks\n", program);
+    printf("  %s --generate <csv_file> [options] Write synthetic bars and exit\n", program);
+    printf("  %s --generate-split <dir> [options] Same, one <dir>/SYMnnnn.csv per symbol\n", program);
+    printf("\nOptions:\n");
+    printf("  --rows <n>          Bars per benchmark / bars to generate (default 1000000)\n");
+    printf("  --symbols <n>       Symbols the bars are spread over (default 10)\n");
+    printf("  --seed <n>          Generator seed (default 42)\n");
+    printf("  --interval <secs>   Seconds between a symbol's bars (default 60)\n");
+    printf("  --repetitions <n>   Timed runs per benchmark; best and median are kept (default 5)\n");
+    printf("  --filter <text>     Only run benchmarks whose name contains text\n");
+    printf("  --mock-latency <us> Busy-wait this long in each mock prediction (default 0)\n");
+    printf("  --json <file>       Also write the results as JSON\n");
+    printf("  --work-dir <dir>    Directory for temporary files (default .)\n");
+}
+
+// Deterministic stand-in for the ML server: the answer is derived from a
+// hash of the features, so ~40% of bars clear the default 0.7 threshold.
+class MockPredictor : public Predictor {
+private:
+    std::chrono::nanoseconds latency_;
+    
+public:
+    explicit MockPredictor(std::chrono::nanoseconds latency = std::chrono::nanoseconds(0))
+        : latency_(latency) {}
+    
+    MLPrediction predict(const std::string& symbol, std::time_t timestamp,
+                         const std::vector<double>& features) override {
+        (void)symbol;
+        (void)timestamp;
+        
+        if (latency_.count() > 0) {
+            auto until = std::chrono::steady_clock::now() + latency_;
+            while (std::chrono::steady_clock::now() < until) {}
+        }
+        
+        uint64_t h = hash_features(features.data(), features.size());
+        double prob_buy = static_cast<double>(h >> 11) * (1.0 / 9007199254740992.0);
+        
+        MLPrediction result;
+        result.prediction = prob_buy >= 0.5 ? 1 : 0;
+        result.probabilities = {1.0 - prob_buy, prob_buy};
+        result.score = std::max(prob_buy, 1.0 - prob_buy);
+        result.model_version = "mock";
+        result.success = true;
+        return result;
+    }
+    
+    std::string model_version() const override {
+        return "mock";
+    }
+};
+
+struct BenchResult {
+    std::string name;
+    size_t items;
+    std::vector<double> seconds;  // One per repetition, sorted
+    
+    double best() const {
+        return seconds.front();
+    }
+    
+    double median() const {
+        return seconds[seconds.size() / 2];
+    }
+};
+
+// Runs each benchmark `repetitions` times. A benchmark body does its own
+// setup and returns the seconds spent in the part being measured.
+class BenchRunner {
+private:
+    size_t repetitions_;
+    std::string filter_;
+    std::vector<BenchResult> results_;
+    
+public:
+    BenchRunner(size_t repetitions, const std::string& filter)
+        : repetitions_(std::max<size_t>(1, repetitions)), filter_(filter) {}
+    
+    bool wants(const std::string& name) const {
+        return filter_.empty() || name.find(filter_) != std::string::npos;
+    }
+    
+    void run(const std::string& name, size_t items, const std::function<double()>& once) {
+        if (!wants(name)) return;
+        
+        BenchResult result{name, items, {}};
+        for (size_t i = 0; i < repetitions_; ++i) {
+            result.seconds.push_back(once());
+        }
+        std::sort(result.seconds.begin(), result.seconds.end());
+        
+        printf("[BENCH] %-28s %10zu items %10.2f ms best %10.2f ms median %12.0f items/s %9.1f ns/item\n",
+               name.c_str(), items, result.best() * 1e3, result.median() * 1e3,
+               items / result.best(), result.best() * 1e9 / items);
+        fflush(stdout);
+        results_.push_back(result);
+    }
+    
+    const std::vector<BenchResult>& results() const {
+        return results_;
+    }
+    
+    size_t repetitions() const {
+        return repetitions_;
+    }
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Pushes events from `producers` threads into one consumer.
+static double run_thread_safe_queue(const std::vector<MarketDataEvent>& events, size_t producers) {
+    ThreadSafeQueue<MarketDataEvent> queue(65536);
+    size_t per_producer = events.size() / producers;
+    size_t received = 0;
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    std::thread consumer([&]() {
+        while (queue.pop()) {
+            ++received;
+        }
+    });
+    
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            size_t begin = p * per_producer;
+            for (size_t i = begin; i < begin + per_producer; ++i) {
+                queue.push(events[i]);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    queue.finish();
+    consumer.join();
+    
+    double seconds = seconds_since(start);
+    if (received != per_producer * producers) {
+        printf("[ERROR] Queue delivered %zu of %zu events\n", received, per_producer * producers);
+    }
+    return seconds;
+}
+
+// Same hand-off as the engine: chunks of 4096 in, batches of 256 out.
+static double run_spsc_ring(const std::vector<MarketDataEvent>& events) {
+    SpscRingBuffer<MarketDataEvent> ring(65536);
+    size_t received = 0;
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    std::thread consumer([&]() {
+        std::vector<MarketDataEvent> batch(256);
+        size_t count;
+        while ((count = ring.pop_batch(Span<MarketDataEvent>(batch.data(), batch.size()))) > 0) {
+            received += count;
+        }
+    });
+    
+    for (size_t i = 0; i < events.size(); i += 4096) {
+        size_t count = std::min<size_t>(4096, events.size() - i);
+        ring.push_batch(Span<const MarketDataEvent>(events.data() + i, count));
+    }
+    ring.finish();
+    consumer.join();
+    
+    double seconds = seconds_since(start);
+    if (received != events.size()) {
+        printf("[ERROR] Ring delivered %zu of %zu events\n", received, events.size());
+    }
+    return seconds;
+}
+
+// One event bounced between two threads over a pair of rings, so each trip
+// pays two consumer wake-ups under the wait strategy.
+static double run_spsc_round_trip(WaitStrategy strategy, size_t trips) {
+    SpscRingBuffer<MarketDataEvent> ping(1024, strategy);
+    SpscRingBuffer<MarketDataEvent> pong(1024, strategy);
+    MarketDataEvent event;
+    
+    std::thread echo([&]() {
+        while (auto received = ping.pop()) {
+            pong.push(*received);
+        }
+    });
+    
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < trips; ++i) {
+        event.timestamp = static_cast<std::time_t>(i);
+        ping.push(event);
+        event = *pong.pop();
+    }
+    double seconds = seconds_since(start);
+    
+    ping.finish();
+    echo.join();
+    return seconds;
+}
+
+// Benchmarks fold their results in here so the optimizer cannot drop the work
+static volatile double g_sink = 0.0;
+
+int main(int argc, char* argv[]) {
+    size_t rows = 1000000;
+    size_t symbols = 10;
+    uint64_t seed = 42;
+    long interval = 60;
+    size_t repetitions = 5;
+    long mock_latency_us = 0;
+    std::string filter;
+    std::string json_file;
+    std::string generate_file;
+    std::string generate_dir;
+    std::string work_dir = ".";
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (arg == "--rows" && i + 1 < argc) {
+            rows = std::stoull(argv[++i]);
+        }
+        else if (arg == "--symbols" && i + 1 < argc) {
+            symbols = std::max<size_t>(1, std::stoull(argv[++i]));
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        }
+        else if (arg == "--interval" && i + 1 < argc) {
+            interval = std::max(1L, std::stol(argv[++i]));
+        }
+        else if (arg == "--repetitions" && i + 1 < argc) {
+            repetitions = std::stoull(argv[++i]);
+        }
+        else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else if (arg == "--mock-latency" && i + 1 < argc) {
+            mock_latency_us = std::max(0L, std::stol(argv[++i]));
+        }
+        else if (arg == "--json" && i + 1 < argc) {
+            json_file = argv[++i];
+        }
+        else if (arg == "--generate" && i + 1 < argc) {
+            generate_file = argv[++i];
+        }
+        else if (arg == "--generate-split" && i + 1 < argc) {
+            generate_dir = argv[++i];
+        }
+        else if (arg == "--work-dir" && i + 1 < argc) {
+            work_dir = argv[++i];
+        }
+        else {
+            printf("[ERROR] Unknown option: %s\n\n", arg.c_str());
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (rows == 0) {
+        printf("[ERROR] --rows must be positive\n");
+        return 1;
+    }
+    
+    if (!generate_file.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        SyntheticMarketData generator(symbols, seed, interval);
+        if (!generator.write_csv(generate_file, rows)) {
+            return 1;
+        }
+        printf("[INFO] Wrote %zu bars for %zu symbols to %s (%.2f s)\n",
+               rows, symbols, generate_file.c_str(), seconds_since(start));
+        return 0;
+    }
+    
+    if (!generate_dir.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        std::error_code error;
+        std::filesystem::create_directories(generate_dir, error);
+        SyntheticMarketData generator(symbols, seed, interval);
+        if (generator.write_symbol_files(generate_dir, rows).empty()) {
+            return 1;
+        }
+        printf("[INFO] Wrote %zu bars for %zu symbols to %s/ (%.2f s)\n",
+               rows, symbols, generate_dir.c_str(), seconds_since(start));
+        return 0;
+    }
+    
+    printf("[INFO] Generating %zu bars for %zu symbols (seed %llu)...\n",
+           rows, symbols, static_cast<unsigned long long>(seed));
+    auto events = std::make_shared<const std::vector<MarketDataEvent>>(
+        SyntheticMarketData(symbols, seed, interval).generate(rows));
+    
+    const std::string csv_file = work_dir + "/bench_data.csv";
+    const std::string trades_file = work_dir + "/bench_trades.csv";
+    
+    BenchRunner runner(repetitions, filter);
+    
+    // CSV loading
+    if (runner.wants("load_csv") || runner.wants("csv_stream")) {
+        if (!SyntheticMarketData(symbols, seed, interval).write_csv(csv_file, rows)) {
+            return 1;
+        }
+        
+        runner.run("load_csv", rows, [&]() {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<MarketDataEvent> loaded = Utils::load_csv(csv_file);
+            double seconds = seconds_since(start);
+            if (loaded.size() != rows) {
+                printf("[ERROR] Loaded %zu of %zu rows\n", loaded.size(), rows);
+            }
+            return seconds;
+        });
+        
+        runner.run("csv_stream", rows, [&]() {
+            auto start = std::chrono::steady_clock::now();
+            CsvFileSource source;
+            source.open(csv_file);
+            std::vector<MarketDataEvent> chunk;
+            size_t total = 0;
+            while (source.read(chunk, 4096) > 0) {
+                total += chunk.size();
+                chunk.clear();
+            }
+            double seconds = seconds_since(start);
+            g_sink = g_sink + static_cast<double>(total);
+            return seconds;
+        });
+        
+        std::remove(csv_file.c_str());
+    }
+    
+    // The same bars from one file per symbol, merged back by timestamp
+    if (runner.wants("merged_source")) {
+        std::vector<std::string> files =
+            SyntheticMarketData(symbols, seed, interval).write_symbol_files(work_dir, rows);
+        if (files.empty()) {
+            return 1;
+        }
+        
+        runner.run("merged_source/" + std::to_string(symbols), rows, [&]() {
+            auto start = std::chrono::steady_clock::now();
+            auto source = MarketDataSource::open(files);
+            std::vector<MarketDataEvent> chunk;
+            size_t total = 0;
+            while (source->read(chunk, 4096) > 0) {
+                total += chunk.size();
+                chunk.clear();
+            }
+            double seconds = seconds_since(start);
+            if (total != rows) {
+                printf("[ERROR] Merged %zu of %zu rows\n", total, rows);
+            }
+            return seconds;
+        });
+        
+        for (const std::string& file : files) {
+            std::remove(file.c_str());
+        }
+    }
+    
+    // The bars through FeedReplayServer and FeedHandler over loopback TCP,
+    // unpaced: wire format, sockets and parsing together
+    if (runner.wants("feed_tcp_loopback")) {
+        FeedAddress address;
+        FeedAddress::parse("tcp://127.0.0.1:19720", address);
+        
+        runner.run("feed_tcp_loopback", rows, [&]() {
+            std::thread server_thread([&]() {
+                FeedReplayServer server;
+                EventBufferSource source(events, "bench");
+                if (server.open(address, FeedReplayOptions())) {
+                    server.run(source);
+                }
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Until it listens
+            
+            auto start = std::chrono::steady_clock::now();
+            FeedHandler feed;
+            std::vector<MarketDataEvent> chunk;
+            chunk.reserve(4096);
+            size_t total = 0;
+            if (feed.open(address, std::chrono::milliseconds(5000))) {
+                while (feed.read(chunk, 4096) > 0) {
+                    total += chunk.size();
+                    chunk.clear();
+                }
+            }
+            double seconds = seconds_since(start);
+            server_thread.join();
+            if (total != rows) {
+                printf("[ERROR] Received %zu of %zu rows\n", total, rows);
+            }
+            return seconds;
+        });
+    }
+    
+    // Queues between the reader and the strategy
+    runner.run("thread_safe_queue/1p1c", rows, [&]() {
+        return run_thread_safe_queue(*events, 1);
+    });
+    runner.run("thread_safe_queue/4p1c", rows / 4 * 4, [&]() {
+        return run_thread_safe_queue(*events, 4);
+    });
+    runner.run("spsc_ring/batch", rows, [&]() {
+        return run_spsc_ring(*events);
+    });
+    
+    // Wake-up latency: ns/item is one round trip
+    const size_t round_trips = 10000;
+    for (WaitStrategy strategy : {WaitStrategy::Blocking, WaitStrategy::Hybrid, WaitStrategy::Spinning}) {
+        runner.run(std::string("spsc_round_trip/") + wait_strategy_name(strategy), round_trips, [&]() {
+            return run_spsc_round_trip(strategy, round_trips);
+        });
+    }
+    
+    // Indicators
+    runner.run("rolling_mean/50", rows, [&]() {
+        RollingMean mean(50);
+        double sink = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (const MarketDataEvent& e : *events) {
+            mean.push(e.close);
+            sink += mean.value();
+        }
+        double seconds = seconds_since(start);
+        g_sink = g_sink + sink;
+        return seconds;
+    });
+    
+    runner.run("rolling_variance/20", rows, [&]() {
+        RollingVariance variance(20);
+        double sink = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (const MarketDataEvent& e : *events) {
+            variance.push(e.close);
+            sink += variance.stddev();
+        }
+        double seconds = seconds_since(start);
+        g_sink = g_sink + sink;
+        return seconds;
+    });
+    
+    runner.run("feature_calculator", rows, [&]() {
+        std::vector<FeatureCalculator> states(SymbolTable::instance().size(), FeatureCalculator(10, 50));
+        double values[FEATURE_COUNT];
+        size_t ready = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const MarketDataEvent& e : *events) {
+            if (states[e.symbol_id].update(e.close, static_cast<double>(e.volume), values)) {
+                ++ready;
+            }
+        }
+        double seconds = seconds_since(start);
+        g_sink = g_sink + static_cast<double>(ready);
+        return seconds;
+    });
+    
+    // Portfolio and trade log: one BUY then one SELL per bar pair
+    const size_t trade_count = std::max<size_t>(2, rows / 4) / 2 * 2;
+    
+    // streaming: the logger writes to a file on its own thread; only the
+    // calling side is timed, which is what execute_trade pays
+    auto execute_trades = [&](bool streaming) {
+        auto logger = std::make_shared<TradeLogger>();
+        if (streaming && !logger->open(trades_file)) {
+            return 0.0;
+        }
+        Portfolio portfolio(1e12, logger);
+        portfolio.set_verbose(false);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < trade_count; i += 2) {
+            const MarketDataEvent& e = (*events)[i % events->size()];
+            portfolio.execute_trade(e.timestamp, "Bench", e.symbol_id, Side::Buy, 10, e.close,
+                                    1, 0.9, 0.9, "mock");
+            portfolio.execute_trade(e.timestamp, "Bench", e.symbol_id, Side::Sell, 10, e.close,
+                                    0, 0.9, 0.1, "mock");
+        }
+        double seconds = seconds_since(start);
+        logger->close();
+        g_sink = g_sink + static_cast<double>(logger->count());
+        return seconds;
+    };
+    
+    // Marking every bar and reading equity, as per-event analytics do
+    runner.run("portfolio_mark", rows, [&]() {
+        auto logger = std::make_shared<TradeLogger>();
+        Portfolio portfolio(1e12, logger);
+        portfolio.set_verbose(false);
+        for (SymbolId id = 0; id < SymbolTable::instance().size(); ++id) {
+            portfolio.execute_trade(0, "Bench", id, Side::Buy, 10, 100.0, 1, 0.9, 0.9, "mock");
+        }
+        double sink = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (const MarketDataEvent& e : *events) {
+            portfolio.mark(e.symbol_id, e.close);
+            sink += portfolio.get_equity();
+        }
+        double seconds = seconds_since(start);
+        g_sink = g_sink + sink;
+        return seconds;
+    });
+    
+    // The same marks with PerformanceAnalytics closing a period per timestamp
+    runner.run("analytics_on_event", rows, [&]() {
+        auto logger = std::make_shared<TradeLogger>();
+        auto portfolio = std::make_shared<Portfolio>(1e12, logger);
+        portfolio->set_verbose(false);
+        for (SymbolId id = 0; id < SymbolTable::instance().size(); ++id) {
+            portfolio->execute_trade(0, "Bench", id, Side::Buy, 10, 100.0, 1, 0.9, 0.9, "mock");
+        }
+        PerformanceAnalytics analytics(portfolio);
+        auto start = std::chrono::steady_clock::now();
+        for (const MarketDataEvent& e : *events) {
+            analytics.on_event(e);
+            portfolio->mark(e.symbol_id, e.close);
+        }
+        analytics.finish();
+        double seconds = seconds_since(start);
+        g_sink = g_sink + analytics.summary().sharpe;
+        return seconds;
+    });
+    
+    runner.run("execute_trade", trade_count, [&]() {
+        return execute_trades(false);
+    });
+    runner.run("execute_trade/streaming", trade_count, [&]() {
+        return execute_trades(true);
+    });
+    std::remove(trades_file.c_str());
+    
+    if (runner.wants("save_to_csv")) {
+        TradeLogger logger;
+        for (size_t i = 0; i < trade_count; ++i) {
+            const MarketDataEvent& e = (*events)[i % events->size()];
+            logger.log_trade(Trade(e.timestamp, "Bench", e.symbol_id, i % 2 ? Side::Sell : Side::Buy,
+                                   10, e.close, 1e6 - e.close * 10, i % 2 ? 0 : 10,
+                                   1, 0.9, 0.9, "mock"));
+        }
+        
+        runner.run("save_to_csv", trade_count, [&]() {
+            auto start = std::chrono::steady_clock::now();
+            logger.save_to_csv(trades_file);
+            return seconds_since(start);
+        });
+        std::remove(trades_file.c_str());
+    }
+    
+    // Whole pipeline: source -> engine queue -> strategy -> mock model -> portfolio
+    runner.run("engine_end_to_end", rows, [&]() {
+        auto logger = std::make_shared<TradeLogger>();
+        auto portfolio = std::make_shared<Portfolio>(10000.0, logger, true);
+        portfolio->set_verbose(false);
+        
+        auto predictor = std::make_shared<MockPredictor>(std::chrono::microseconds(mock_latency_us));
+        auto strategy = std::make_shared<MovingAverageStrategy>(portfolio, 10, 50, 0.7, predictor);
+        strategy->set_verbose(false);
+        
+        auto start = std::chrono::steady_clock::now();
+        BacktestingEngine engine(strategy);
+        engine.start();
+        engine.stream_from(std::make_unique<EventBufferSource>(events, "synthetic"));
+        engine.wait_for_stream();
+        engine.stop();
+        double seconds = seconds_since(start);
+        
+        if (engine.events_processed() != rows) {
+            printf("[ERROR] Engine processed %zu of %zu events\n", engine.events_processed(), rows);
+        }
+        g_sink = g_sink + static_cast<double>(logger->count());
+        return seconds;
+    });
+    
+    // Engine-thread cost of one checkpoint: the engine, strategy and
+    // portfolio after the whole run, serialized into a recycled buffer. The
+    // trade log streams as in AlgoTradingSystem, so trades are not copied.
+    if (runner.wants("checkpoint_state")) {
+        auto logger = std::make_shared<TradeLogger>();
+        logger->open(trades_file);
+        auto portfolio = std::make_shared<Portfolio>(10000.0, logger, true);
+        portfolio->set_verbose(false);
+        auto strategy = std::make_shared<MovingAverageStrategy>(
+            portfolio, 10, 50, 0.7, std::make_shared<MockPredictor>(std::chrono::microseconds(0)));
+        strategy->set_verbose(false);
+        for (const MarketDataEvent& e : *events) {
+            strategy->on_event(e);
+        }
+        
+        BacktestingEngine engine(strategy);
+        const size_t checkpoints = 100;
+        std::vector<char> buffer;
+        runner.run("checkpoint_state/" + std::to_string(symbols), checkpoints, [&]() {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < checkpoints; ++i) {
+                StateWriter state(std::move(buffer));
+                state.put_symbols();
+                engine.save_state(state);
+                buffer = state.release();
+            }
+            double seconds = seconds_since(start);
+            g_sink = g_sink + static_cast<double>(buffer.size());
+            return seconds;
+        });
+        logger->close();
+        std::remove(trades_file.c_str());
+    }
+    
+    if (!json_file.empty()) {
+        nlohmann::json output;
+        output["context"] = {
+            {"date", static_cast<long long>(std::time(nullptr))},
+            {"rows", rows},
+            {"symbols", symbols},
+            {"seed", seed},
+            {"repetitions", runner.repetitions()},
+            {"mock_latency_us", mock_latency_us},
+            {"hardware_threads", std::thread::hardware_concurrency()},
+#ifdef ALGO_METRICS
+            {"metrics", true},
+#else
+            {"metrics", false},
+#endif
+#ifdef NDEBUG
+            {"build", "release"}
+#else
+            {"build", "debug"}
+#endif
+        };
+        
+        output["benchmarks"] = nlohmann::json::array();
+        for (const BenchResult& result : runner.results()) {
+            output["benchmarks"].push_back({
+                {"name", result.name},
+                {"items", result.items},
+                {"best_seconds", result.best()},
+                {"median_seconds", result.median()},
+                {"items_per_second", result.items / result.best()},
+                {"ns_per_item", result.best() * 1e9 / result.items}
+            });
+        }
+        
+        std::ofstream file(json_file);
+        if (!file.is_open()) {
+            printf("[ERROR] Could not open file: %s\n", json_file.c_str());
+            return 1;
+        }
+        file << output.dump(2) << "\n";
+        printf("[INFO] Saved %zu results to: %s\n", runner.results().size(), json_file.c_str());
+    }
+    
+    return 0;
+}
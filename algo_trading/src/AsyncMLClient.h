@@ -0,0 +1,168 @@
+#pragma once
+
+#include "Predictor.h"
+#include "ml_client.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Prediction server client with several requests in flight.
+//
+// Each worker thread owns one keep-alive MLClient connection and takes
+// requests from a shared queue, so up to `connections` round trips overlap.
+// predict_async() returns as soon as the request is queued; it only waits
+// when max_in_flight requests are already queued or running. Callbacks run
+// on the worker threads, in completion order.
+class AsyncMLClient : public Predictor {
+private:
+    struct Request {
+        std::string symbol;
+        std::time_t timestamp;
+        std::vector<double> features;
+        PredictionCallback done;
+    };
+    
+    std::string host_;
+    int port_;
+    size_t max_in_flight_;
+    std::chrono::milliseconds timeout_;  // 0 = MLClient defaults
+    
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable space_ready_;
+    std::deque<Request> queue_;
+    size_t in_flight_ = 0;  // Queued or running
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+    
+    mutable std::mutex control_mutex_;
+    MLClient control_;  // Health checks and batch calls
+    
+    size_t completed_ = 0;
+    size_t failed_ = 0;
+    
+    void worker_loop() {
+        MLClient client(host_, port_);
+        if (timeout_.count() > 0) {
+            client.set_timeouts(timeout_, timeout_);
+        }
+        
+        while (true) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_ready_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+                if (queue_.empty()) {
+                    return;  // Stopping and drained
+                }
+                request = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            
+            MLPrediction result = client.predict(request.symbol, request.timestamp, request.features);
+            request.done(result);
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --in_flight_;
+                ++completed_;
+                if (!result.success) ++failed_;
+            }
+            space_ready_.notify_one();
+        }
+    }
+    
+public:
+    // max_in_flight = 0 allows two requests per connection, so each worker
+    // has the next request ready when its response arrives. A non-zero
+    // timeout caps both connecting and reading on every connection.
+    AsyncMLClient(const std::string& host = "127.0.0.1", int port = 8000,
+                  size_t connections = 4, size_t max_in_flight = 0,
+                  std::chrono::milliseconds timeout = std::chrono::milliseconds(0))
+        : host_(host), port_(port),
+          max_in_flight_(max_in_flight > 0 ? max_in_flight : 2 * std::max<size_t>(1, connections)),
+          timeout_(timeout), control_(host, port) {
+        if (timeout_.count() > 0) {
+            control_.set_timeouts(timeout_, timeout_);
+        }
+        connections = std::max<size_t>(1, connections);
+        workers_.reserve(connections);
+        for (size_t i = 0; i < connections; ++i) {
+            workers_.emplace_back([this]() { worker_loop(); });
+        }
+    }
+    
+    // Answers everything still queued, then joins the workers.
+    ~AsyncMLClient() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_ready_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+        print_report();
+    }
+    
+    AsyncMLClient(const AsyncMLClient&) = delete;
+    AsyncMLClient& operator=(const AsyncMLClient&) = delete;
+    
+    void predict_async(const std::string& symbol, std::time_t timestamp,
+                       const std::vector<double>& features, PredictionCallback done) override {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            space_ready_.wait(lock, [this]() { return in_flight_ < max_in_flight_; });
+            ++in_flight_;
+            queue_.push_back(Request{symbol, timestamp, features, std::move(done)});
+        }
+        work_ready_.notify_one();
+    }
+    
+    MLPrediction predict(const std::string& symbol, std::time_t timestamp,
+                         const std::vector<double>& features) override {
+        return predict_future(symbol, timestamp, features).get();
+    }
+    
+    bool is_asynchronous() const override {
+        return true;
+    }
+    
+    bool predict_batch(const double* features, size_t rows, size_t feature_count,
+                       std::vector<MLPrediction>& out) override {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        return control_.predict_batch(features, rows, feature_count, out);
+    }
+    
+    bool check_health() override {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        return control_.check_health();
+    }
+    
+    std::string model_version() const override {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        return control_.model_version();
+    }
+    
+    size_t connections() const {
+        return workers_.size();
+    }
+    
+    size_t max_in_flight() const {
+        return max_in_flight_;
+    }
+    
+    void print_report() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (completed_ == 0 && in_flight_ == 0) return;
+        printf("[ML] Async client: %zu predictions over %zu connections (%zu failed)\n",
+               completed_, workers_.size(), failed_);
+    }
+};
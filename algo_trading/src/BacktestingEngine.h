@@ -1,22 +1,66 @@
 #pragma once
 
 #include "MarketDataEvent.h"
-#include "ThreadSafeQueue.h"
+#include "MarketDataSource.h"
+#include "SpscRingBuffer.h"
+#include "ReplayClock.h"
 #include "TradingStrategy.h"
+#include "PerformanceAnalytics.h"
+#include "Checkpoint.h"
+#include "Metrics.h"
+#include "LowLatency.h"
 #include <thread>
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+#include <vector>
 
+struct StreamOptions {
+    size_t chunk_size = 4096;  // Events read from the source per batch
+    size_t max_events = 0;     // 0 = whole source
+};
+
+// Events flow producer -> SpscRingBuffer -> processing thread. Only one
+// thread may feed the engine at a time: either the caller of add_event()/
+// add_events() or the producer started by stream_from().
 class BacktestingEngine {
 private:
-    ThreadSafeQueue<MarketDataEvent> event_queue_;
+    static constexpr size_t DEFAULT_QUEUE_CAPACITY = 65536;
+    static constexpr size_t POP_BATCH = 256;
+    
+    SpscRingBuffer<MarketDataEvent> event_queue_;
     std::shared_ptr<TradingStrategy> strategy_;
+    std::shared_ptr<PerformanceAnalytics> analytics_;
+    std::shared_ptr<CheckpointWriter> checkpoint_;
+    std::chrono::steady_clock::duration checkpoint_interval_{};
     std::thread processing_thread_;
+    int engine_cpu_ = -1;
     std::atomic<bool> running_;
+    ReplayClock clock_;
+    
+    std::unique_ptr<MarketDataSource> source_;
+    std::thread producer_thread_;
+    int producer_cpu_ = -1;
+    std::atomic<bool> producing_;
+    std::atomic<size_t> events_streamed_;
+    
+    std::atomic<size_t> events_processed_;
+    mutable std::mutex last_event_mutex_;
+    MarketDataEvent last_event_;
     
 public:
-    BacktestingEngine(std::shared_ptr<TradingStrategy> strategy)
-        : strategy_(strategy), running_(false) {}
+    // max_queued_events bounds the events held between producer and strategy
+    // (0 = default capacity). It is rounded up to a power of two.
+    BacktestingEngine(std::shared_ptr<TradingStrategy> strategy, size_t max_queued_events = 0,
+                      WaitStrategy wait_strategy = WaitStrategy::Hybrid)
+        : event_queue_(max_queued_events > 0 ? max_queued_events : DEFAULT_QUEUE_CAPACITY,
+                       wait_strategy),
+          strategy_(strategy), running_(false),
+          producing_(false), events_streamed_(0), events_processed_(0) {
+        event_queue_.set_wakeup_metric(METRIC_ENGINE_WAKEUP);
+    }
     
     ~BacktestingEngine() {
         stop();
@@ -26,38 +70,209 @@ public:
         event_queue_.push(event);
     }
     
+    // Copies a whole batch into the queue, waiting for space as needed.
+    size_t add_events(Span<const MarketDataEvent> events) {
+        return event_queue_.push_batch(events);
+    }
+    
+    // Must be called before start().
+    void set_replay(ReplayMode mode, double speed = 1.0) {
+        clock_ = ReplayClock(mode, speed);
+    }
+    
+    // Must be called before start(). The analytics see each event before the
+    // strategy, so a timestamp's period closes before the next one is marked.
+    void set_analytics(std::shared_ptr<PerformanceAnalytics> analytics) {
+        analytics_ = analytics;
+    }
+    
+    // Must be called before start(). Snapshots the engine, strategy,
+    // portfolio and analytics every interval and once more after the last
+    // event. The engine thread only serializes into memory; writer does the
+    // file work.
+    void set_checkpoint(std::shared_ptr<CheckpointWriter> writer, std::chrono::steady_clock::duration interval) {
+        checkpoint_ = writer;
+        checkpoint_interval_ = interval;
+    }
+    
+    // Must be called before start() and stream_from(). Pins the producer
+    // and engine threads to these cores (-1 = any) and pre-faults their
+    // stacks.
+    void set_cpus(int producer_cpu, int engine_cpu) {
+        producer_cpu_ = producer_cpu;
+        engine_cpu_ = engine_cpu;
+    }
+    
+    // Events processed, the last of them, then the strategy and analytics.
+    // Call from the engine thread, or while it is not running.
+    void save_state(StateWriter& state) const {
+        state.put<uint64_t>(events_processed_.load());
+        state.put(last_event());
+        strategy_->save_state(state);
+        state.put(static_cast<bool>(analytics_));
+        if (analytics_) analytics_->save_state(state);
+    }
+    
+    // Restores a save_state() into an engine set up like the saved one.
+    // Must be called before start(); the source then continues after
+    // events_processed() events.
+    bool load_state(StateReader& state) {
+        uint64_t events = 0;
+        MarketDataEvent last;
+        if (!state.get(events) || !state.get(last)) return false;
+        last.symbol_id = state.symbol(last.symbol_id);
+        if (last.symbol_id == SymbolTable::INVALID_ID) return state.fail("missing a symbol");
+        if (!strategy_->load_state(state) || !state.expect(static_cast<bool>(analytics_), "analytics setting")) {
+            return false;
+        }
+        if (analytics_ && !analytics_->load_state(state)) return false;
+        
+        events_processed_ = static_cast<size_t>(events);
+        std::lock_guard<std::mutex> lock(last_event_mutex_);
+        last_event_ = last;
+        return state.ok();
+    }
+    
     void start() {
         running_ = true;
         
         processing_thread_ = std::thread([this]() {
+            LowLatency::prepare_thread(engine_cpu_, "engine");
             printf("[INFO] Backtesting engine started\n");
             
+            std::vector<MarketDataEvent> batch(POP_BATCH);
+            auto next_checkpoint = std::chrono::steady_clock::now() + checkpoint_interval_;
+            
             while (running_) {
-                auto event = event_queue_.pop();
+                size_t count;
+                {
+                    METRICS_SCOPE(METRIC_QUEUE_POP);
+                    count = event_queue_.pop_batch(Span<MarketDataEvent>(batch.data(), batch.size()));
+                }
                 
-                if (!event.has_value()) {
+                if (count == 0) {
                     break;  // Queue finished
                 }
                 
-                strategy_->on_market_data(event.value());
+                for (size_t i = 0; i < count; ++i) {
+                    clock_.pace(batch[i].timestamp);
+                    if (analytics_) analytics_->on_event(batch[i]);
+                    strategy_->on_event(batch[i]);
+                    if (batch[i].feed_stamp != 0) {
+                        METRICS_RECORD(METRIC_FEED_DECISION, batch[i].feed_age_ns(std::chrono::steady_clock::now()));
+                    }
+                }
+                events_processed_.fetch_add(count, std::memory_order_relaxed);
+                METRICS_COUNT(METRIC_EVENTS, count);
+                
+                {
+                    std::lock_guard<std::mutex> lock(last_event_mutex_);
+                    last_event_ = batch[count - 1];
+                }
+                
+                if (checkpoint_ && std::chrono::steady_clock::now() >= next_checkpoint) {
+                    take_checkpoint();
+                    next_checkpoint = std::chrono::steady_clock::now() + checkpoint_interval_;
+                }
             }
             
+            // Before on_finish(), so a resumed run can still go on
+            if (checkpoint_ && events_processed_ > 0) take_checkpoint();
+            
+            strategy_->on_finish();
+            if (analytics_) analytics_->finish();
             printf("[INFO] Backtesting engine stopped\n");
+            clock_.print_report();
         });
     }
     
+private:
+    void take_checkpoint() {
+        METRICS_SCOPE(METRIC_CHECKPOINT);
+        StateWriter state(checkpoint_->take_buffer());
+        state.put_symbols();
+        save_state(state);
+        checkpoint_->submit(state.release(), events_processed_, last_event().timestamp);
+    }
+    
+public:
+    // Starts a producer thread that reads the source chunk by chunk and feeds
+    // the engine. The queue is bounded, so the producer blocks once the window
+    // is full; memory stays bounded and processing starts with the first chunk.
+    void stream_from(std::unique_ptr<MarketDataSource> source, const StreamOptions& options = {}) {
+        wait_for_stream();
+        
+        source_ = std::move(source);
+        producing_ = true;
+        
+        producer_thread_ = std::thread([this, options]() {
+            LowLatency::prepare_thread(producer_cpu_, "producer");
+            std::vector<MarketDataEvent> chunk;
+            chunk.reserve(options.chunk_size);
+            
+            while (producing_) {
+                chunk.clear();
+                
+                size_t want = options.chunk_size;
+                if (options.max_events > 0) {
+                    want = std::min(want, options.max_events - events_streamed_);
+                }
+                
+                if (want == 0 || source_->read(chunk, want) == 0) {
+                    break;  // Limit reached or source exhausted
+                }
+                
+                size_t pushed;
+                {
+                    METRICS_SCOPE(METRIC_QUEUE_PUSH);
+                    pushed = event_queue_.push_batch(
+                        Span<const MarketDataEvent>(chunk.data(), chunk.size()));
+                }
+                events_streamed_ += pushed;
+                
+                if (pushed < chunk.size()) {
+                    break;  // Engine stopped
+                }
+            }
+            
+            producing_ = false;
+            printf("[INFO] Streamed %zu events from: %s\n",
+                   events_streamed_.load(), source_->name().c_str());
+        });
+    }
+    
+    // Blocks until the producer has pushed its last event.
+    void wait_for_stream() {
+        if (producer_thread_.joinable()) {
+            producer_thread_.join();
+        }
+    }
+    
+    // Stops the producer, lets the strategy drain what is already queued and
+    // joins both threads.
     void stop() {
+        producing_ = false;
+        event_queue_.finish();
+        wait_for_stream();
+        
         if (running_) {
-            running_ = false;
-            event_queue_.finish();
-            
             if (processing_thread_.joinable()) {
                 processing_thread_.join();
             }
+            running_ = false;
         }
     }
     
     bool is_running() const {
         return running_;
     }
+    
+    size_t events_processed() const {
+        return events_processed_;
+    }
+    
+    MarketDataEvent last_event() const {
+        std::lock_guard<std::mutex> lock(last_event_mutex_);
+        return last_event_;
+    }
 };
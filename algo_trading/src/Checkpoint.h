@@ -0,0 +1,237 @@
+#pragma once
+
+#include "CheckpointState.h"
+#include "TradeLogger.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Checkpoint file written by CheckpointWriter.
+//
+//   CheckpointHeader
+//   payload[payload_size]: symbol dictionary, then BacktestingEngine state
+//
+// The file is written next to its final name, synced and renamed over it, so
+// the name always holds one whole checkpoint. Values are stored in native
+// byte order; a checkpoint is read back by the same build.
+struct CheckpointHeader {
+    static constexpr char MAGIC[8] = {'A', 'L', 'G', 'O', 'C', 'K', 'P', 'T'};
+    static constexpr uint32_t VERSION = 2;  // 2: 256-byte Trade
+    
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t payload_size;
+    uint64_t checksum;   // FNV-1a of the payload
+    uint64_t events;     // Events processed when it was taken
+    uint64_t trades;     // Trades logged by then
+    int64_t timestamp;   // Of the last processed event
+    
+    static uint64_t hash(const char* data, size_t size) {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < size; ++i) {
+            h = (h ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ull;
+        }
+        return h;
+    }
+};
+
+static_assert(sizeof(CheckpointHeader) == 56, "CheckpointHeader layout changed");
+
+// Writes checkpoints on a background thread.
+//
+// The engine serializes its state into memory and hands it over with
+// submit(), which only swaps a buffer under a lock; a newer checkpoint
+// replaces one still waiting. Before writing, the thread waits until the
+// trades the checkpoint counts are in the trade log file, so a checkpoint on
+// disk never refers to trades the log lost.
+class CheckpointWriter {
+private:
+    static constexpr std::chrono::seconds LOG_WAIT{10};
+    
+    std::string filename_;
+    std::shared_ptr<const TradeLogger> logger_;
+    
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    bool has_pending_ = false;
+    bool stopping_ = false;
+    CheckpointHeader pending_header_{};
+    bool pending_log_wait_ = false;
+    std::vector<char> pending_;
+    std::vector<char> spare_;  // Last payload written, for reuse
+    std::thread thread_;
+    size_t written_ = 0;  // Writer thread only
+    
+    static bool sync(FILE* file) {
+        if (fflush(file) != 0) return false;
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+    
+    bool write_file(CheckpointHeader header, const std::vector<char>& payload, bool log_wait) {
+        header.checksum = CheckpointHeader::hash(payload.data(), payload.size());
+        
+        // A streaming log must have the counted trades in its file first;
+        // its writer gets there within the flush interval
+        auto deadline = std::chrono::steady_clock::now() + LOG_WAIT;
+        while (log_wait && logger_->written() < header.trades) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                printf("[WARNING] Trade log is behind; checkpoint at event %llu skipped\n",
+                       static_cast<unsigned long long>(header.events));
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        
+        std::string temp = filename_ + ".tmp";
+        FILE* file = fopen(temp.c_str(), "wb");
+        if (file == nullptr) {
+            printf("[ERROR] Could not open file: %s\n", temp.c_str());
+            return false;
+        }
+        
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fwrite(payload.data(), 1, payload.size(), file) == payload.size() &&
+                  sync(file);
+        ok = fclose(file) == 0 && ok;
+        
+        std::error_code error;
+        if (ok) {
+            std::filesystem::rename(temp, filename_, error);
+        }
+        if (!ok || error) {
+            printf("[ERROR] Could not write file: %s\n", filename_.c_str());
+            std::filesystem::remove(temp, error);
+            return false;
+        }
+        return true;
+    }
+    
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            ready_.wait(lock, [this]() { return has_pending_ || stopping_; });
+            if (!has_pending_) break;
+            
+            CheckpointHeader header = pending_header_;
+            bool log_wait = pending_log_wait_;
+            std::vector<char> payload = std::move(pending_);
+            has_pending_ = false;
+            
+            lock.unlock();
+            if (write_file(header, payload, log_wait)) ++written_;
+            lock.lock();
+            spare_ = std::move(payload);
+        }
+    }
+    
+public:
+    // logger is the trade log the checkpointed portfolio writes to, or
+    // nullptr.
+    CheckpointWriter(const std::string& filename, std::shared_ptr<const TradeLogger> logger)
+        : filename_(filename), logger_(logger) {
+        thread_ = std::thread([this]() { run(); });
+    }
+    
+    ~CheckpointWriter() {
+        close();
+    }
+    
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+    
+    // A buffer to serialize the next checkpoint into: the storage of one
+    // already written, or empty.
+    std::vector<char> take_buffer() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::move(spare_);
+    }
+    
+    // Queues a serialized state taken after `events` events, the last at
+    // timestamp. Call from the thread that logs trades.
+    void submit(std::vector<char> payload, uint64_t events, std::time_t timestamp) {
+        CheckpointHeader header{};
+        std::memcpy(header.magic, CheckpointHeader::MAGIC, sizeof(header.magic));
+        header.version = CheckpointHeader::VERSION;
+        header.payload_size = payload.size();
+        header.events = events;
+        header.trades = logger_ ? logger_->count() : 0;
+        header.timestamp = static_cast<int64_t>(timestamp);
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_header_ = header;
+            pending_log_wait_ = logger_ && logger_->is_streaming();
+            pending_ = std::move(payload);
+            has_pending_ = true;
+        }
+        ready_.notify_one();
+    }
+    
+    // Writes the last submitted checkpoint, if any, and stops the thread.
+    void close() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_one();
+        thread_.join();
+        printf("[INFO] Wrote %zu checkpoints to: %s\n", written_, filename_.c_str());
+    }
+    
+    const std::string& filename() const {
+        return filename_;
+    }
+    
+    // Reads and verifies a checkpoint file. Returns false (after printing
+    // why) if it is missing, truncated, corrupt or from another version.
+    static bool load(const std::string& filename, CheckpointHeader& header, std::vector<char>& payload) {
+        FILE* file = fopen(filename.c_str(), "rb");
+        if (file == nullptr) {
+            printf("[ERROR] Could not open file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+                  std::memcmp(header.magic, CheckpointHeader::MAGIC, sizeof(header.magic)) == 0;
+        if (ok && header.version != CheckpointHeader::VERSION) {
+            printf("[ERROR] Checkpoint version %u is not supported (expected %u)\n",
+                   header.version, CheckpointHeader::VERSION);
+            fclose(file);
+            return false;
+        }
+        std::error_code error;
+        uintmax_t file_size = std::filesystem::file_size(filename, error);
+        ok = ok && !error && header.payload_size == file_size - sizeof(header);
+        if (ok) {
+            payload.resize(header.payload_size);
+            ok = fread(payload.data(), 1, payload.size(), file) == payload.size() &&
+                 CheckpointHeader::hash(payload.data(), payload.size()) == header.checksum;
+        }
+        fclose(file);
+        
+        if (!ok) {
+            printf("[ERROR] Not a valid checkpoint: %s\n", filename.c_str());
+        }
+        return ok;
+    }
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "SymbolTable.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Appends component state to a byte buffer. Only trivially copyable values
+// are written raw; everything else is built from them.
+class StateWriter {
+private:
+    std::vector<char> buffer_;  // [0, size_) written; grows by doubling
+    size_t size_ = 0;
+    
+    void append(const void* data, size_t length) {
+        if (buffer_.size() - size_ < length) {
+            buffer_.resize(std::max(buffer_.size() * 2, size_ + length));
+        }
+        std::memcpy(buffer_.data() + size_, data, length);
+        size_ += length;
+    }
+    
+public:
+    StateWriter() = default;
+    
+    // Writes into buffer's storage, so a recycled buffer costs no
+    // allocation or page faults.
+    explicit StateWriter(std::vector<char> buffer)
+        : buffer_(std::move(buffer)) {}
+    
+    template<typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "put() needs a trivially copyable type");
+        append(&value, sizeof(T));
+    }
+    
+    template<typename T>
+    void put_vector(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "put_vector() needs a trivially copyable type");
+        put<uint64_t>(values.size());
+        append(values.data(), values.size() * sizeof(T));
+    }
+    
+    void put_string(const std::string& text) {
+        put<uint64_t>(text.size());
+        append(text.data(), text.size());
+    }
+    
+    // Every interned ticker in id order, so saved SymbolIds can be mapped
+    // onto the ids of the process that loads them.
+    void put_symbols() {
+        const SymbolTable& table = SymbolTable::instance();
+        size_t count = table.size();
+        put<uint64_t>(count);
+        for (size_t id = 0; id < count; ++id) {
+            put_string(table.name(static_cast<SymbolId>(id)));
+        }
+    }
+    
+    size_t size() const {
+        return size_;
+    }
+    
+    // The bytes written, leaving the writer empty.
+    std::vector<char> release() {
+        buffer_.resize(size_);
+        size_ = 0;
+        return std::move(buffer_);
+    }
+};
+
+// Reads back what StateWriter wrote. The first failure sticks: later reads
+// return false and ok() stays false, so loaders can check once at the end.
+class StateReader {
+private:
+    const char* data_;
+    size_t size_;
+    size_t offset_ = 0;
+    bool ok_ = true;
+    std::vector<SymbolId> symbols_;  // Saved SymbolId -> this process
+    
+public:
+    StateReader(const char* data, size_t size)
+        : data_(data), size_(size) {}
+    
+    template<typename T>
+    bool get(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "get() needs a trivially copyable type");
+        if (!ok_ || size_ - offset_ < sizeof(T)) return fail("truncated");
+        std::memcpy(&value, data_ + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return true;
+    }
+    
+    template<typename T>
+    bool get_vector(std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "get_vector() needs a trivially copyable type");
+        uint64_t count = 0;
+        if (!get(count)) return false;
+        if (count > (size_ - offset_) / sizeof(T)) return fail("truncated");
+        values.resize(count);
+        std::memcpy(values.data(), data_ + offset_, count * sizeof(T));
+        offset_ += count * sizeof(T);
+        return true;
+    }
+    
+    bool get_string(std::string& text) {
+        uint64_t length = 0;
+        if (!get(length)) return false;
+        if (length > size_ - offset_) return fail("truncated");
+        text.assign(data_ + offset_, length);
+        offset_ += length;
+        return true;
+    }
+    
+    // Interns the saved tickers; symbol() maps ids from then on.
+    bool get_symbols() {
+        uint64_t count = 0;
+        if (!get(count)) return false;
+        symbols_.clear();
+        std::string name;
+        for (uint64_t i = 0; i < count; ++i) {
+            if (!get_string(name)) return false;
+            symbols_.push_back(SymbolTable::instance().intern(name));
+        }
+        return true;
+    }
+    
+    // The id this process uses for a saved SymbolId.
+    SymbolId symbol(SymbolId saved) const {
+        return saved < symbols_.size() ? symbols_[saved] : SymbolTable::INVALID_ID;
+    }
+    
+    // Checks a saved setting against the one in use, so state is never
+    // restored into a differently configured component.
+    template<typename T>
+    bool expect(const T& current, const char* what) {
+        T saved{};
+        if (!get(saved)) return false;
+        if (!(saved == current)) {
+            printf("[ERROR] Checkpoint was taken with a different %s\n", what);
+            ok_ = false;
+            return false;
+        }
+        return true;
+    }
+    
+    bool fail(const char* reason) {
+        if (ok_) printf("[ERROR] Checkpoint state is %s\n", reason);
+        ok_ = false;
+        return false;
+    }
+    
+    bool ok() const {
+        return ok_;
+    }
+    
+    bool at_end() const {
+        return offset_ == size_;
+    }
+};
@@ -0,0 +1,333 @@
+#pragma once
+
+#include "Predictor.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bounds how long a bar can wait for the model.
+//
+// Every call gets `budget` to answer; a late or failed answer counts as a
+// failure. After failure_threshold failures in a row the circuit opens: calls
+// fail at once (error "Circuit open") so the strategy can use its fallback
+// signal, and a background thread checks the wrapped predictor's health every
+// probe_interval. The first healthy probe closes the circuit again.
+//
+// A watchdog thread answers "Deadline exceeded" for any call still open at
+// its deadline, and an answer arriving after that is dropped. A synchronous
+// wrapped predictor (MLClient, ShmPredictor, RandomForest) is called on a
+// worker thread owned by the breaker, one call at a time, so the caller never
+// waits past the budget however it behaves; calls queued behind a late one
+// time out without reaching it.
+//
+// A late answer still occupies the wrapped predictor, so give it timeouts of
+// about the same budget (MLClient::set_timeouts, AsyncMLClient's timeout).
+class CircuitBreaker : public Predictor {
+private:
+    using Clock = std::chrono::steady_clock;
+    
+    struct Call {
+        std::atomic<bool> answered{false};
+        Clock::time_point deadline;
+        PredictionCallback done;
+        
+        // For the worker
+        std::string symbol;
+        std::time_t timestamp = 0;
+        std::vector<double> features;
+    };
+    using CallPtr = std::shared_ptr<Call>;
+    
+    std::shared_ptr<Predictor> inner_;
+    std::chrono::milliseconds budget_;
+    size_t failure_threshold_;
+    std::chrono::milliseconds probe_interval_;
+    
+    std::atomic<bool> open_{false};
+    std::atomic<size_t> consecutive_failures_{0};
+    
+    std::mutex probe_mutex_;
+    std::condition_variable probe_wake_;
+    bool stopping_ = false;
+    std::thread probe_thread_;
+    
+    // Open calls by deadline (budget is fixed, so in call order), and calls
+    // waiting for the worker
+    std::mutex calls_mutex_;
+    std::condition_variable deadline_wake_;
+    std::condition_variable work_ready_;
+    std::deque<CallPtr> deadlines_;
+    std::deque<CallPtr> jobs_;
+    bool calls_stopping_ = false;
+    std::thread watchdog_thread_;
+    std::thread worker_thread_;  // Only for a synchronous inner predictor
+    std::mutex inner_mutex_;     // Serializes a synchronous inner predictor
+    
+    std::atomic<size_t> calls_{0};
+    std::atomic<size_t> timeouts_{0};
+    std::atomic<size_t> failures_{0};
+    std::atomic<size_t> short_circuited_{0};
+    std::atomic<size_t> trips_{0};
+    
+    static MLPrediction failure(const char* message) {
+        MLPrediction result;
+        result.error_message = message;
+        return result;
+    }
+    
+    void record(bool success) {
+        if (success) {
+            consecutive_failures_ = 0;
+            return;
+        }
+        
+        ++failures_;
+        if (++consecutive_failures_ >= failure_threshold_ && !open_.exchange(true)) {
+            ++trips_;
+            printf("[ML] Circuit open after %zu failed predictions; probing every %lld ms\n",
+                   consecutive_failures_.load(), static_cast<long long>(probe_interval_.count()));
+            {
+                // The probe thread is now either waiting or about to see open_
+                std::lock_guard<std::mutex> lock(probe_mutex_);
+            }
+            probe_wake_.notify_one();
+        }
+    }
+    
+    // Delivers a call's answer unless it already timed out. An answer after
+    // the deadline is a timeout even if the watchdog has not seen it yet.
+    void complete(Call& call, const MLPrediction& result) {
+        if (call.answered.exchange(true)) return;
+        
+        if (Clock::now() > call.deadline) {
+            ++timeouts_;
+            record(false);
+            call.done(failure("Deadline exceeded"));
+            return;
+        }
+        record(result.success);
+        call.done(result);
+    }
+    
+    void expire(Call& call) {
+        if (call.answered.exchange(true)) return;
+        
+        ++timeouts_;
+        record(false);
+        call.done(failure("Deadline exceeded"));
+    }
+    
+    // Times out calls at their deadline. On shutdown, times out what is left.
+    void watchdog_loop() {
+        std::unique_lock<std::mutex> lock(calls_mutex_);
+        
+        while (true) {
+            if (deadlines_.empty()) {
+                if (calls_stopping_) break;
+                deadline_wake_.wait(lock);
+                continue;
+            }
+            
+            CallPtr call = deadlines_.front();
+            if (!call->answered && !calls_stopping_ && Clock::now() < call->deadline) {
+                deadline_wake_.wait_until(lock, call->deadline);
+                continue;
+            }
+            deadlines_.pop_front();
+            
+            lock.unlock();
+            expire(*call);
+            lock.lock();
+        }
+    }
+    
+    // Runs a synchronous inner predictor's calls, skipping those that timed
+    // out while queued.
+    void worker_loop() {
+        std::unique_lock<std::mutex> lock(calls_mutex_);
+        
+        while (true) {
+            work_ready_.wait(lock, [this]() { return calls_stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) break;
+            
+            CallPtr call = jobs_.front();
+            jobs_.pop_front();
+            if (call->answered) continue;
+            
+            lock.unlock();
+            MLPrediction result;
+            {
+                std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+                result = inner_->predict(call->symbol, call->timestamp, call->features);
+            }
+            complete(*call, result);
+            lock.lock();
+        }
+    }
+    
+    bool inner_health() {
+        if (inner_->is_asynchronous()) return inner_->check_health();
+        std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+        return inner_->check_health();
+    }
+    
+    // Sleeps while the circuit is closed; while it is open, checks health
+    // once per interval and closes it on the first success.
+    void probe_loop() {
+        std::unique_lock<std::mutex> lock(probe_mutex_);
+        
+        while (!stopping_) {
+            if (!open_) {
+                probe_wake_.wait(lock, [this]() { return stopping_ || open_.load(); });
+                continue;
+            }
+            
+            probe_wake_.wait_for(lock, probe_interval_, [this]() { return stopping_; });
+            if (stopping_) break;
+            
+            lock.unlock();
+            bool healthy = inner_health();
+            lock.lock();
+            
+            if (healthy) {
+                consecutive_failures_ = 0;
+                open_ = false;
+                printf("[ML] Circuit closed: model answering again\n");
+            }
+        }
+    }
+    
+public:
+    CircuitBreaker(std::shared_ptr<Predictor> inner, std::chrono::milliseconds budget,
+                   size_t failure_threshold = 3,
+                   std::chrono::milliseconds probe_interval = std::chrono::milliseconds(1000))
+        : inner_(inner), budget_(budget),
+          failure_threshold_(failure_threshold > 0 ? failure_threshold : 1),
+          probe_interval_(probe_interval) {
+        probe_thread_ = std::thread([this]() { probe_loop(); });
+        watchdog_thread_ = std::thread([this]() { watchdog_loop(); });
+        if (!inner_->is_asynchronous()) {
+            worker_thread_ = std::thread([this]() { worker_loop(); });
+        }
+    }
+    
+    ~CircuitBreaker() {
+        {
+            std::lock_guard<std::mutex> lock(probe_mutex_);
+            stopping_ = true;
+        }
+        probe_wake_.notify_one();
+        probe_thread_.join();
+        
+        {
+            std::lock_guard<std::mutex> lock(calls_mutex_);
+            calls_stopping_ = true;
+        }
+        work_ready_.notify_one();
+        deadline_wake_.notify_one();
+        if (worker_thread_.joinable()) {
+            worker_thread_.join();
+        }
+        watchdog_thread_.join();
+        print_report();
+    }
+    
+    CircuitBreaker(const CircuitBreaker&) = delete;
+    CircuitBreaker& operator=(const CircuitBreaker&) = delete;
+    
+    bool is_open() const {
+        return open_;
+    }
+    
+    MLPrediction predict(const std::string& symbol, std::time_t timestamp,
+                         const std::vector<double>& features) override {
+        return predict_future(symbol, timestamp, features).get();
+    }
+    
+    // The answer, or "Deadline exceeded", is delivered by the deadline, on
+    // the worker, watchdog or wrapped predictor's thread.
+    void predict_async(const std::string& symbol, std::time_t timestamp,
+                       const std::vector<double>& features, PredictionCallback done) override {
+        if (open_) {
+            ++short_circuited_;
+            done(failure("Circuit open"));
+            return;
+        }
+        
+        ++calls_;
+        auto call = std::make_shared<Call>();
+        call->deadline = Clock::now() + budget_;
+        call->done = std::move(done);
+        
+        const bool asynchronous = inner_->is_asynchronous();
+        if (!asynchronous) {
+            call->symbol = symbol;
+            call->timestamp = timestamp;
+            call->features = features;
+        }
+        {
+            std::lock_guard<std::mutex> lock(calls_mutex_);
+            if (deadlines_.empty()) deadline_wake_.notify_one();
+            deadlines_.push_back(call);
+            if (!asynchronous) jobs_.push_back(call);
+        }
+        
+        if (asynchronous) {
+            inner_->predict_async(symbol, timestamp, features,
+                [this, call](const MLPrediction& result) { complete(*call, result); });
+        } else {
+            work_ready_.notify_one();
+        }
+    }
+    
+    bool is_asynchronous() const override {
+        return true;
+    }
+    
+    // Not bounded by the budget, which is per bar: a batch takes as long as
+    // the wrapped predictor's own timeouts allow. A failed batch still
+    // counts towards opening the circuit.
+    bool predict_batch(const double* features, size_t rows, size_t feature_count,
+                       std::vector<MLPrediction>& out) override {
+        if (open_) {
+            ++short_circuited_;
+            out.assign(rows, failure("Circuit open"));
+            return false;
+        }
+        
+        ++calls_;
+        bool ok;
+        if (inner_->is_asynchronous()) {
+            ok = inner_->predict_batch(features, rows, feature_count, out);
+        } else {
+            std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+            ok = inner_->predict_batch(features, rows, feature_count, out);
+        }
+        record(ok);
+        return ok;
+    }
+    
+    bool check_health() override {
+        return inner_health();
+    }
+    
+    std::string model_version() const override {
+        return inner_->model_version();
+    }
+    
+    void print_report() const {
+        if (failures_ == 0 && short_circuited_ == 0) return;
+        
+        printf("[ML] Circuit breaker: %zu calls, %zu failed (%zu over the %lld ms budget), "
+               "opened %zu times, %zu calls skipped while open\n",
+               calls_.load(), failures_.load(), timeouts_.load(),
+               static_cast<long long>(budget_.count()), trips_.load(), short_circuited_.load());
+    }
+};
@@ -0,0 +1,277 @@
+#pragma once
+
+#include "Indicators.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FEATURE_KERNEL_AVX2 1
+#define FEATURE_KERNEL_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(__AVX2__)
+#include <immintrin.h>
+#define FEATURE_KERNEL_AVX2 1
+#define FEATURE_KERNEL_AVX2_TARGET
+#endif
+
+// Computes the MovingAverageStrategy features for a whole close/volume series
+// at once, into a row-major n x FEATURE_COUNT matrix (row i = bar i).
+//
+// Each window is summed oldest to newest, the same order as the original
+// per-bar std::accumulate code, and the AVX2 path computes four consecutive
+// bars per lane group in that same order without FMA. The scalar and AVX2
+// paths therefore give bitwise-identical results; FeatureCalculator's running
+// sums agree with both to rounding (around 1e-12 relative).
+//
+// Rows before first_row() are zero-filled: those bars are FeatureCalculator's
+// warm-up, for which update() returns false.
+class FeatureKernel {
+public:
+    enum class Path {
+        Auto,    // AVX2 when the CPU has it
+        Scalar,
+        Avx2     // Same as Auto; falls back to scalar without AVX2
+    };
+    
+private:
+    static constexpr size_t VOLATILITY_PERIOD = 20;
+    static constexpr size_t VOLUME_PERIOD = 20;
+    static constexpr size_t RETURN_LAG = 4;
+    
+    size_t short_period_;
+    size_t long_period_;
+    size_t history_cap_;
+    
+    // Whether each window can fill inside the capped history (see
+    // FeatureCalculator); if not the feature keeps its default.
+    bool short_fits_;
+    bool volatility_fits_;
+    bool volume_fits_;
+    
+    // All features of bar i from the raw series (i >= first_row()).
+    void compute_row(const double* close, const double* volume, size_t i, double* out) const {
+        size_t size = std::min(i + 1, history_cap_);
+        double c = close[i];
+        
+        double return_5 = 0.0;
+        if (size > RETURN_LAG) {
+            return_5 = (c - close[i - RETURN_LAG]) / close[i - RETURN_LAG];
+        }
+        
+        double short_ma = 0.0;
+        if (short_fits_ && size >= short_period_) {
+            double sum = 0.0;
+            for (size_t k = i + 1 - short_period_; k <= i; ++k) sum += close[k];
+            short_ma = sum / static_cast<double>(short_period_);
+        }
+        
+        double long_sum = 0.0;
+        for (size_t k = i + 1 - long_period_; k <= i; ++k) long_sum += close[k];
+        
+        double volatility = 0.0;
+        if (volatility_fits_ && size >= VOLATILITY_PERIOD) {
+            double sum = 0.0;
+            for (size_t k = i + 1 - VOLATILITY_PERIOD; k <= i; ++k) sum += close[k];
+            double mean = sum / static_cast<double>(VOLATILITY_PERIOD);
+            
+            double sq_sum = 0.0;
+            for (size_t k = i + 1 - VOLATILITY_PERIOD; k <= i; ++k) {
+                sq_sum += (close[k] - mean) * (close[k] - mean);
+            }
+            volatility = std::sqrt(sq_sum / static_cast<double>(VOLATILITY_PERIOD));
+        }
+        
+        double volume_ratio = 1.0;
+        if (volume_fits_ && i >= VOLUME_PERIOD) {
+            double sum = 0.0;
+            for (size_t k = i - VOLUME_PERIOD; k < i; ++k) sum += volume[k];
+            double avg_volume = sum / static_cast<double>(VOLUME_PERIOD);
+            if (avg_volume > 0) volume_ratio = volume[i] / avg_volume;
+        }
+        
+        out[FEATURE_RETURN_1] = (c - close[i - 1]) / close[i - 1];
+        out[FEATURE_RETURN_5] = return_5;
+        out[FEATURE_SHORT_MA] = short_ma;
+        out[FEATURE_LONG_MA] = long_sum / static_cast<double>(long_period_);
+        out[FEATURE_VOLATILITY] = volatility;
+        out[FEATURE_VOLUME_RATIO] = volume_ratio;
+        out[FEATURE_CLOSE] = c;
+        out[FEATURE_MOMENTUM] = return_5;
+    }
+    
+#ifdef FEATURE_KERNEL_AVX2
+    // Lane j of sums[g] sums the period values ending at last[4 * g + j],
+    // oldest first. The four groups are independent add chains, which hides
+    // the add latency.
+    FEATURE_KERNEL_AVX2_TARGET
+    static void window_sums(const double* last, size_t period, __m256d* sums) {
+        const double* p = last + 1 - period;
+        __m256d s0 = _mm256_setzero_pd();
+        __m256d s1 = _mm256_setzero_pd();
+        __m256d s2 = _mm256_setzero_pd();
+        __m256d s3 = _mm256_setzero_pd();
+        
+        for (size_t k = 0; k < period; ++k) {
+            s0 = _mm256_add_pd(s0, _mm256_loadu_pd(p + k));
+            s1 = _mm256_add_pd(s1, _mm256_loadu_pd(p + k + 4));
+            s2 = _mm256_add_pd(s2, _mm256_loadu_pd(p + k + 8));
+            s3 = _mm256_add_pd(s3, _mm256_loadu_pd(p + k + 12));
+        }
+        
+        sums[0] = s0;
+        sums[1] = s1;
+        sums[2] = s2;
+        sums[3] = s3;
+    }
+    
+    // Writes rows [i, i + 16). Every row must be past the point where all
+    // windows are full, so no lane needs a per-bar condition.
+    FEATURE_KERNEL_AVX2_TARGET
+    void compute_block_avx2(const double* close, const double* volume, size_t i, double* out) const {
+        const __m256d short_n = _mm256_set1_pd(static_cast<double>(short_period_));
+        const __m256d long_n = _mm256_set1_pd(static_cast<double>(long_period_));
+        const __m256d vol_n = _mm256_set1_pd(static_cast<double>(VOLATILITY_PERIOD));
+        const __m256d volume_n = _mm256_set1_pd(static_cast<double>(VOLUME_PERIOD));
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d one = _mm256_set1_pd(1.0);
+        
+        __m256d short_sum[4], long_sum[4], vol_sum[4], sq_sum[4], volume_sum[4];
+        
+        if (short_fits_) window_sums(close + i, short_period_, short_sum);
+        window_sums(close + i, long_period_, long_sum);
+        
+        if (volatility_fits_) {
+            window_sums(close + i, VOLATILITY_PERIOD, vol_sum);
+            
+            __m256d m0 = _mm256_div_pd(vol_sum[0], vol_n);
+            __m256d m1 = _mm256_div_pd(vol_sum[1], vol_n);
+            __m256d m2 = _mm256_div_pd(vol_sum[2], vol_n);
+            __m256d m3 = _mm256_div_pd(vol_sum[3], vol_n);
+            __m256d q0 = zero, q1 = zero, q2 = zero, q3 = zero;
+            
+            const double* p = close + i + 1 - VOLATILITY_PERIOD;
+            for (size_t k = 0; k < VOLATILITY_PERIOD; ++k) {
+                __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(p + k), m0);
+                __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(p + k + 4), m1);
+                __m256d d2 = _mm256_sub_pd(_mm256_loadu_pd(p + k + 8), m2);
+                __m256d d3 = _mm256_sub_pd(_mm256_loadu_pd(p + k + 12), m3);
+                q0 = _mm256_add_pd(q0, _mm256_mul_pd(d0, d0));
+                q1 = _mm256_add_pd(q1, _mm256_mul_pd(d1, d1));
+                q2 = _mm256_add_pd(q2, _mm256_mul_pd(d2, d2));
+                q3 = _mm256_add_pd(q3, _mm256_mul_pd(d3, d3));
+            }
+            
+            sq_sum[0] = q0;
+            sq_sum[1] = q1;
+            sq_sum[2] = q2;
+            sq_sum[3] = q3;
+        }
+        
+        if (volume_fits_) window_sums(volume + i - 1, VOLUME_PERIOD, volume_sum);
+        
+        for (size_t g = 0; g < 4; ++g) {
+            size_t row = i + 4 * g;
+            __m256d c = _mm256_loadu_pd(close + row);
+            __m256d prev = _mm256_loadu_pd(close + row - 1);
+            __m256d lag = _mm256_loadu_pd(close + row - RETURN_LAG);
+            
+            __m256d return_1 = _mm256_div_pd(_mm256_sub_pd(c, prev), prev);
+            __m256d return_5 = _mm256_div_pd(_mm256_sub_pd(c, lag), lag);
+            __m256d short_ma = short_fits_ ? _mm256_div_pd(short_sum[g], short_n) : zero;
+            __m256d long_ma = _mm256_div_pd(long_sum[g], long_n);
+            
+            __m256d volatility = zero;
+            if (volatility_fits_) {
+                volatility = _mm256_sqrt_pd(_mm256_div_pd(sq_sum[g], vol_n));
+            }
+            
+            __m256d volume_ratio = one;
+            if (volume_fits_) {
+                __m256d avg = _mm256_div_pd(volume_sum[g], volume_n);
+                __m256d ratio = _mm256_div_pd(_mm256_loadu_pd(volume + row), avg);
+                __m256d positive = _mm256_cmp_pd(avg, zero, _CMP_GT_OQ);
+                volume_ratio = _mm256_blendv_pd(one, ratio, positive);
+            }
+            
+            // Transpose 2 x (4 features x 4 bars) into 4 rows of 8
+            store_rows(out + row * FEATURE_COUNT, return_1, return_5, short_ma, long_ma, 0);
+            store_rows(out + row * FEATURE_COUNT, volatility, volume_ratio, c, return_5, 4);
+        }
+    }
+    
+    FEATURE_KERNEL_AVX2_TARGET
+    static void store_rows(double* rows, __m256d f0, __m256d f1, __m256d f2, __m256d f3,
+                           size_t column) {
+        __m256d t0 = _mm256_unpacklo_pd(f0, f1);  // f0[0] f1[0] f0[2] f1[2]
+        __m256d t1 = _mm256_unpackhi_pd(f0, f1);  // f0[1] f1[1] f0[3] f1[3]
+        __m256d t2 = _mm256_unpacklo_pd(f2, f3);
+        __m256d t3 = _mm256_unpackhi_pd(f2, f3);
+        
+        _mm256_storeu_pd(rows + 0 * FEATURE_COUNT + column, _mm256_permute2f128_pd(t0, t2, 0x20));
+        _mm256_storeu_pd(rows + 1 * FEATURE_COUNT + column, _mm256_permute2f128_pd(t1, t3, 0x20));
+        _mm256_storeu_pd(rows + 2 * FEATURE_COUNT + column, _mm256_permute2f128_pd(t0, t2, 0x31));
+        _mm256_storeu_pd(rows + 3 * FEATURE_COUNT + column, _mm256_permute2f128_pd(t1, t3, 0x31));
+    }
+#endif
+
+public:
+    FeatureKernel(int short_period = 10, int long_period = 50)
+        : short_period_(static_cast<size_t>(std::max(1, short_period))),
+          long_period_(static_cast<size_t>(std::max(1, long_period))),
+          history_cap_(long_period_ + 10),
+          short_fits_(short_period_ <= history_cap_),
+          volatility_fits_(VOLATILITY_PERIOD <= history_cap_),
+          volume_fits_(VOLUME_PERIOD < history_cap_) {}
+    
+    static bool avx2_available() {
+#if defined(FEATURE_KERNEL_AVX2) && defined(__GNUC__)
+        return __builtin_cpu_supports("avx2");
+#elif defined(FEATURE_KERNEL_AVX2)
+        return true;
+#else
+        return false;
+#endif
+    }
+    
+    // First bar with features; earlier rows are warm-up.
+    size_t first_row() const {
+        return long_period_;
+    }
+    
+    // out must hold n * FEATURE_COUNT doubles. Returns the number of rows
+    // with features (n - first_row(), or 0 for a short series).
+    size_t compute(const double* close, const double* volume, size_t n, double* out,
+                   Path path = Path::Auto) const {
+        size_t first = std::min(first_row(), n);
+        std::memset(out, 0, first * FEATURE_COUNT * sizeof(double));
+        
+        size_t i = first;
+        
+#ifdef FEATURE_KERNEL_AVX2
+        if (path != Path::Scalar && avx2_available()) {
+            // Vector rows need every window full for all four lanes
+            size_t short_begin = short_fits_ ? short_period_ - 1 : 0;
+            size_t vector_begin = std::max({first, VOLUME_PERIOD, short_begin, RETURN_LAG});
+            vector_begin = std::min(vector_begin, n);
+            
+            for (; i < vector_begin; ++i) {
+                compute_row(close, volume, i, out + i * FEATURE_COUNT);
+            }
+            
+            for (; i + 16 <= n; i += 16) {
+                compute_block_avx2(close, volume, i, out);
+            }
+        }
+#else
+        (void)path;
+#endif
+        
+        for (; i < n; ++i) {
+            compute_row(close, volume, i, out + i * FEATURE_COUNT);
+        }
+        
+        return n - first;
+    }
+};
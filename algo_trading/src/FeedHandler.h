@@ -0,0 +1,344 @@
+#pragma once
+
+#include "FeedProtocol.h"
+#include "FeedSocket.h"
+#include "MarketDataEvent.h"
+#include "MarketDataSource.h"
+#include "Metrics.h"
+#include "SymbolTable.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Live market data from a feed in the FeedProtocol.h format, such as a
+// FeedReplayServer, as a MarketDataSource.
+//
+// Packets are received into one reusable buffer and parsed where they land:
+// each bar or tick becomes a MarketDataEvent appended to the caller's chunk,
+// so nothing is allocated per message. read() hands over what has arrived as
+// soon as the socket has nothing more instead of waiting to fill the chunk.
+//
+// Backpressure comes from the engine's bounded queue: while it is full the
+// producer stops calling read(), the socket buffer fills and TCP holds the
+// sender back. UDP cannot, so what overflows the socket buffer is lost; the
+// sequence numbers show how much. The feed ends with its End message, when a
+// TCP sender closes, or after idle_timeout without data.
+//
+// Waiting for data sleeps in select() unless set_busy_poll() is on, which
+// polls the socket instead so a packet is picked up without a wake-up.
+class FeedHandler : public MarketDataSource {
+public:
+    struct Stats {
+        uint64_t packets = 0;
+        uint64_t messages = 0;        // Received in sequence
+        uint64_t events = 0;
+        uint64_t gaps = 0;
+        uint64_t missed = 0;          // Messages lost in those gaps
+        uint64_t stale = 0;           // Repeated or late messages dropped
+        uint64_t unknown_symbol = 0;  // Events for a symbol never named
+        uint64_t malformed = 0;       // Packets dropped whole or in part
+    };
+    
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+    static constexpr int UDP_RECEIVE_BUFFER = 8 << 20;
+    static constexpr uint32_t MAX_SYMBOLS = 1 << 20;
+    static constexpr uint64_t GAP_WARNINGS = 10;
+    
+    FeedAddress address_;
+    FeedSocket socket_;
+    std::chrono::milliseconds idle_timeout_{0};
+    bool busy_poll_ = false;
+    
+    std::vector<char> buffer_;
+    size_t begin_ = 0;  // Received, not yet parsed: [begin_, end_)
+    size_t end_ = 0;
+    
+    // Packet being parsed
+    const char* cursor_ = nullptr;
+    const char* packet_end_ = nullptr;
+    size_t remaining_ = 0;  // Messages left in it
+    size_t stale_ = 0;      // How many of those were already seen
+    uint32_t stamp_ = 0;
+    
+    uint64_t next_sequence_ = 1;
+    std::vector<SymbolId> symbols_;  // Feed symbol number -> SymbolId
+    Stats stats_;
+    bool ended_ = false;
+    bool reported_ = false;
+    
+    static bool valid(const FeedPacketHeader& header) {
+        return std::memcmp(header.magic, FeedPacketHeader::MAGIC, sizeof(header.magic)) == 0 &&
+               header.version == FeedPacketHeader::VERSION &&
+               header.length >= sizeof(FeedPacketHeader) && header.length <= FeedPacketHeader::MAX_SIZE;
+    }
+    
+    // Waits for data and appends it to the buffer. Returns false once the
+    // feed is over.
+    bool receive() {
+        if (begin_ == end_) {
+            begin_ = end_ = 0;
+        } else if (buffer_.size() - end_ < FeedPacketHeader::MAX_SIZE) {
+            std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        
+        if (!wait_for_data()) {
+            printf("[FEED] No data for %lld ms, ending the feed\n",
+                   static_cast<long long>(idle_timeout_.count()));
+            return false;
+        }
+        
+        long received = socket_.receive(buffer_.data() + end_, buffer_.size() - end_);
+        if (received == 0 && !address_.udp) {
+            printf("[WARNING] %s closed before the end of the session\n", name().c_str());
+            return false;
+        }
+        if (received < 0) {
+            printf("[ERROR] Could not receive from %s\n", name().c_str());
+            return false;
+        }
+        
+        // A datagram must be exactly one packet, so the buffer stays a clean
+        // run of packets
+        if (address_.udp) {
+            FeedPacketHeader header;
+            if (static_cast<size_t>(received) < sizeof(header)) {
+                ++stats_.malformed;
+                return true;
+            }
+            std::memcpy(&header, buffer_.data() + end_, sizeof(header));
+            if (!valid(header) || header.length != static_cast<uint32_t>(received)) {
+                ++stats_.malformed;
+                return true;
+            }
+        }
+        
+        end_ += static_cast<size_t>(received);
+        return true;
+    }
+    
+    // Returns false after idle_timeout without data.
+    bool wait_for_data() {
+        if (!busy_poll_) {
+            return socket_.wait_readable(idle_timeout_.count() > 0 ? idle_timeout_
+                                                                 : std::chrono::milliseconds(-1));
+        }
+        
+        auto deadline = std::chrono::steady_clock::now() + idle_timeout_;
+        while (!socket_.wait_readable(std::chrono::milliseconds(0))) {
+            if (idle_timeout_.count() > 0 && std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Starts on the next whole packet in the buffer. Returns false if there
+    // is none yet.
+    bool next_packet() {
+        if (end_ - begin_ < sizeof(FeedPacketHeader)) return false;
+        
+        FeedPacketHeader header;
+        std::memcpy(&header, buffer_.data() + begin_, sizeof(header));
+        if (!valid(header)) {
+            // Only a TCP stream gets here; its framing is lost for good
+            printf("[ERROR] %s sent something that is not a feed packet\n", name().c_str());
+            ++stats_.malformed;
+            ended_ = true;
+            return false;
+        }
+        if (end_ - begin_ < header.length) return false;
+        
+        cursor_ = buffer_.data() + begin_ + sizeof(header);
+        packet_end_ = buffer_.data() + begin_ + header.length;
+        begin_ += header.length;
+        remaining_ = header.message_count;
+        stamp_ = MarketDataEvent::make_feed_stamp(header.sent_ns);
+        ++stats_.packets;
+        METRICS_RECORD(METRIC_FEED_WIRE, feed_clock_ns() - header.sent_ns);
+        
+        if (header.sequence > next_sequence_) {
+            uint64_t missed = header.sequence - next_sequence_;
+            ++stats_.gaps;
+            stats_.missed += missed;
+            if (stats_.gaps <= GAP_WARNINGS) {
+                printf("[WARNING] Feed gap: %llu messages missed before sequence %llu%s\n",
+                       static_cast<unsigned long long>(missed),
+                       static_cast<unsigned long long>(header.sequence),
+                       stats_.gaps == GAP_WARNINGS ? " (further gaps are only counted)" : "");
+            }
+            next_sequence_ = header.sequence;
+        }
+        
+        stale_ = static_cast<size_t>(std::min<uint64_t>(next_sequence_ - header.sequence, remaining_));
+        stats_.stale += stale_;
+        return true;
+    }
+    
+    // Parses the message at cursor_. Returns 1 if it appended an event.
+    size_t parse_message(std::vector<MarketDataEvent>& out) {
+        FeedMessageHeader header;
+        if (static_cast<size_t>(packet_end_ - cursor_) < sizeof(header)) {
+            return drop_packet();
+        }
+        std::memcpy(&header, cursor_, sizeof(header));
+        if (header.length < sizeof(header) || header.length > packet_end_ - cursor_) {
+            return drop_packet();
+        }
+        
+        const char* message = cursor_;
+        cursor_ += header.length;
+        --remaining_;
+        if (stale_ > 0) {
+            --stale_;
+            return 0;
+        }
+        ++next_sequence_;
+        ++stats_.messages;
+        
+        switch (header.type) {
+            case FeedMessageType::Bar: {
+                if (header.length < sizeof(FeedBarMessage)) return drop_packet();
+                SymbolId symbol = lookup(header.symbol);
+                if (symbol == SymbolTable::INVALID_ID) return 0;
+                
+                FeedBarMessage bar;
+                std::memcpy(&bar, message, sizeof(bar));
+                out.emplace_back(static_cast<std::time_t>(bar.timestamp), symbol, bar.open, bar.high,
+                                 bar.low, bar.close, bar.adj_close, static_cast<long long>(bar.volume),
+                                 bar.bid, bar.ask);
+                break;
+            }
+            case FeedMessageType::Tick: {
+                if (header.length < sizeof(FeedTickMessage)) return drop_packet();
+                SymbolId symbol = lookup(header.symbol);
+                if (symbol == SymbolTable::INVALID_ID) return 0;
+                
+                FeedTickMessage tick;
+                std::memcpy(&tick, message, sizeof(tick));
+                out.emplace_back(static_cast<std::time_t>(tick.timestamp), symbol, tick.price, tick.price,
+                                 tick.price, tick.price, tick.price, static_cast<long long>(tick.size),
+                                 tick.bid, tick.ask);
+                break;
+            }
+            case FeedMessageType::Symbol: {
+                if (header.length < sizeof(FeedSymbolMessage)) return drop_packet();
+                if (header.symbol >= MAX_SYMBOLS) return drop_packet();
+                
+                const char* name = message + offsetof(FeedSymbolMessage, name);
+                size_t length = 0;
+                while (length < sizeof(FeedSymbolMessage::name) && name[length] != '\0') ++length;
+                if (header.symbol >= symbols_.size()) {
+                    symbols_.resize(header.symbol + 1, SymbolTable::INVALID_ID);
+                }
+                symbols_[header.symbol] = SymbolTable::instance().intern(std::string(name, length));
+                return 0;
+            }
+            case FeedMessageType::End:
+                ended_ = true;
+                return 0;
+            default:
+                return 0;  // A newer message type
+        }
+        
+        out.back().feed_stamp = stamp_;
+        ++stats_.events;
+        return 1;
+    }
+    
+    SymbolId lookup(uint32_t symbol) {
+        if (symbol < symbols_.size() && symbols_[symbol] != SymbolTable::INVALID_ID) {
+            return symbols_[symbol];
+        }
+        ++stats_.unknown_symbol;
+        return SymbolTable::INVALID_ID;
+    }
+    
+    // Gives up on the rest of a packet that does not add up.
+    size_t drop_packet() {
+        ++stats_.malformed;
+        remaining_ = 0;
+        stale_ = 0;
+        return 0;
+    }
+    
+    void report() {
+        if (reported_) return;
+        reported_ = true;
+        
+        printf("[FEED] %s: %llu packets, %llu messages, %llu events\n", name().c_str(),
+               static_cast<unsigned long long>(stats_.packets),
+               static_cast<unsigned long long>(stats_.messages),
+               static_cast<unsigned long long>(stats_.events));
+        if (stats_.gaps > 0 || stats_.stale > 0 || stats_.unknown_symbol > 0 || stats_.malformed > 0) {
+            printf("[WARNING] Feed: %llu gaps (%llu messages missed), %llu late or repeated, "
+                   "%llu for unknown symbols, %llu malformed packets\n",
+                   static_cast<unsigned long long>(stats_.gaps),
+                   static_cast<unsigned long long>(stats_.missed),
+                   static_cast<unsigned long long>(stats_.stale),
+                   static_cast<unsigned long long>(stats_.unknown_symbol),
+                   static_cast<unsigned long long>(stats_.malformed));
+        }
+    }
+    
+public:
+    // Connects to a TCP feed, or binds a UDP one (joining its group if it is
+    // multicast). idle_timeout 0 waits for data for ever.
+    bool open(const FeedAddress& address, std::chrono::milliseconds idle_timeout) {
+        address_ = address;
+        idle_timeout_ = idle_timeout;
+        buffer_.resize(BUFFER_SIZE);
+        
+        bool ok = address.udp ? socket_.bind_receiver(address, UDP_RECEIVE_BUFFER)
+                              : socket_.connect(address);
+        if (ok) {
+            printf("[FEED] %s %s\n", address.udp ? "Receiving on" : "Connected to", name().c_str());
+        }
+        return ok;
+    }
+    
+    // Polls the socket rather than sleeping while waiting for data.
+    void set_busy_poll(bool busy_poll) {
+        busy_poll_ = busy_poll;
+    }
+    
+    size_t read(std::vector<MarketDataEvent>& out, size_t max_events) override {
+        size_t count = 0;
+        
+        while (count < max_events && !ended_) {
+            if (remaining_ == 0 && !next_packet()) {
+                if (ended_) break;
+                
+                // Hand over what has arrived rather than wait to fill the chunk
+                if (count > 0 && !socket_.wait_readable(std::chrono::milliseconds(0))) break;
+                if (!receive()) {
+                    ended_ = true;
+                    break;
+                }
+                continue;
+            }
+            
+            count += parse_message(out);
+        }
+        
+        if (ended_ && count == 0) {
+            report();
+        }
+        return count;
+    }
+    
+    std::string name() const override {
+        return address_.to_string();
+    }
+    
+    const Stats& stats() const {
+        return stats_;
+    }
+};
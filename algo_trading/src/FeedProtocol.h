@@ -0,0 +1,158 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Binary market-data feed sent by FeedReplayServer and read by FeedHandler.
+//
+// A session is a stream of packets, one per UDP datagram or back to back on
+// a TCP connection:
+//
+//   FeedPacketHeader
+//   message_count messages, each starting with a FeedMessageHeader
+//
+// Every message has a sequence number; a packet carries the number of its
+// first message, and the next packet continues where it left off, so a
+// receiver spots lost or repeated messages from the packet header alone.
+// Messages carry their own length: receivers skip types they do not know.
+// Feed symbol numbers are the sender's; a Symbol message names each one
+// before its first bar or tick, and may name it again later (over UDP, so a
+// lost one is made up for). The session ends with an End message.
+//
+// Values are stored in native byte order, like the tick store: both ends are
+// expected to run on the same kind of machine.
+struct FeedPacketHeader {
+    static constexpr char MAGIC[4] = {'A', 'L', 'G', 'F'};
+    static constexpr uint16_t VERSION = 1;
+    
+    // Largest packet on either transport; fits one UDP datagram
+    static constexpr size_t MAX_SIZE = 65507;
+    
+    char magic[4];
+    uint16_t version;
+    uint16_t message_count;
+    uint32_t length;     // Bytes, this header included
+    uint32_t reserved;
+    uint64_t sequence;   // Of the first message; the session starts at 1
+    uint64_t sent_ns;    // Sender's steady clock when the packet went out
+};
+
+enum class FeedMessageType : uint8_t {
+    Symbol = 'S',
+    Bar = 'B',
+    Tick = 'T',
+    End = 'E'
+};
+
+struct FeedMessageHeader {
+    uint16_t length;       // Bytes, this header included
+    FeedMessageType type;
+    uint8_t reserved;
+    uint32_t symbol;       // Feed symbol number
+};
+
+// Names a feed symbol number.
+struct FeedSymbolMessage {
+    FeedMessageHeader header;
+    char name[24];         // NUL-padded; longer names are not sent
+};
+
+// One OHLCV bar with the quote at its close.
+struct FeedBarMessage {
+    FeedMessageHeader header;
+    int64_t timestamp;
+    double open;
+    double high;
+    double low;
+    double close;
+    double adj_close;
+    int64_t volume;
+    double bid;
+    double ask;
+};
+
+// One trade with the quote around it. Becomes an event whose open, high,
+// low and close are all the trade price.
+struct FeedTickMessage {
+    FeedMessageHeader header;
+    int64_t timestamp;
+    double price;
+    int64_t size;
+    double bid;
+    double ask;
+};
+
+// Last message of a session.
+struct FeedEndMessage {
+    FeedMessageHeader header;
+};
+
+static_assert(sizeof(FeedPacketHeader) == 32, "FeedPacketHeader layout changed");
+static_assert(sizeof(FeedMessageHeader) == 8, "FeedMessageHeader layout changed");
+static_assert(sizeof(FeedSymbolMessage) == 32, "FeedSymbolMessage layout changed");
+static_assert(sizeof(FeedBarMessage) == 80, "FeedBarMessage layout changed");
+static_assert(sizeof(FeedTickMessage) == 48, "FeedTickMessage layout changed");
+static_assert(std::is_trivially_copyable<FeedBarMessage>::value, "Feed messages are copied as bytes");
+
+// Steady clock in nanoseconds, as stamped into FeedPacketHeader::sent_ns.
+// The steady clock is shared by all processes on a machine, so the sender's
+// stamp can be compared with the receiver's clock there.
+inline uint64_t feed_clock_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Builds packets into a caller-provided buffer of FeedPacketHeader::MAX_SIZE
+// bytes or less.
+class FeedPacketWriter {
+private:
+    char* buffer_;
+    size_t capacity_;
+    size_t size_ = sizeof(FeedPacketHeader);
+    uint16_t count_ = 0;
+    uint64_t first_sequence_;
+    
+public:
+    FeedPacketWriter(char* buffer, size_t capacity, uint64_t first_sequence)
+        : buffer_(buffer), capacity_(capacity), first_sequence_(first_sequence) {}
+    
+    // Appends a message if it fits. Returns false if the packet is full.
+    template<typename Message>
+    bool add(const Message& message) {
+        if (size_ + sizeof(Message) > capacity_ || count_ == UINT16_MAX) return false;
+        std::memcpy(buffer_ + size_, &message, sizeof(Message));
+        size_ += sizeof(Message);
+        ++count_;
+        return true;
+    }
+    
+    // Fills in the header, stamped now. Returns the packet size.
+    size_t finish() {
+        FeedPacketHeader header{};
+        std::memcpy(header.magic, FeedPacketHeader::MAGIC, sizeof(header.magic));
+        header.version = FeedPacketHeader::VERSION;
+        header.message_count = count_;
+        header.length = static_cast<uint32_t>(size_);
+        header.sequence = first_sequence_;
+        header.sent_ns = feed_clock_ns();
+        std::memcpy(buffer_, &header, sizeof(header));
+        return size_;
+    }
+    
+    // Starts the next packet after this one's messages.
+    void reset() {
+        first_sequence_ += count_;
+        size_ = sizeof(FeedPacketHeader);
+        count_ = 0;
+    }
+    
+    bool empty() const {
+        return count_ == 0;
+    }
+    
+    uint64_t next_sequence() const {
+        return first_sequence_ + count_;
+    }
+};
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "FeedProtocol.h"
+#include "FeedSocket.h"
+#include "MarketDataEvent.h"
+#include "MarketDataSource.h"
+#include "ReplayClock.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FeedReplayOptions {
+    double rate = 0.0;                         // Events per second, 0 = unpaced
+    ReplayMode replay = ReplayMode::MaxSpeed;  // ScaledRealTime paces by timestamps
+    double speed = 1.0;                        // For ScaledRealTime
+    bool ticks = false;                        // Send ticks (close, volume), not bars
+    size_t max_events = 0;                     // 0 = whole source
+};
+
+// Streams a MarketDataSource as a feed in the FeedProtocol.h format, so a
+// backtest can run against a network feed on one machine.
+//
+// Over TCP it waits for one client and the socket holds it back when the
+// client falls behind; over UDP it sends to the address, multicast or not,
+// whether anyone listens or not. Events can go out at a fixed rate or with
+// the gaps between their timestamps (ReplayClock's realtime mode); a packet
+// is sent as soon as no further event is due, so no event waits for the next
+// one. Unpaced, packets are filled to the transport's size.
+//
+// Over UDP each symbol is named again every REANNOUNCE_PACKETS packets, so a
+// receiver that lost a Symbol message only drops that symbol's events until
+// the next one. Symbols whose names do not fit a Symbol message are not sent
+// at all, since a cut name could merge two of them at the receiver.
+class FeedReplayServer {
+private:
+    static constexpr size_t UDP_PACKET = 1472;   // One Ethernet frame
+    static constexpr size_t TCP_PACKET = 16384;
+    static constexpr size_t CHUNK = 4096;
+    static constexpr uint64_t REANNOUNCE_PACKETS = 100;
+    static constexpr size_t MAX_NAME = sizeof(FeedSymbolMessage::name) - 1;
+    
+    using Clock = std::chrono::steady_clock;
+    
+    struct Announcement {
+        bool sent = false;
+        bool refused = false;   // Name too long for the feed
+        uint64_t packet = 0;    // packets_ when last sent
+    };
+    
+    FeedAddress address_;
+    FeedReplayOptions options_;
+    FeedSocket socket_;
+    std::vector<char> packet_;
+    std::vector<Announcement> announced_;  // By SymbolId
+    uint64_t packets_ = 0;
+    
+    template<typename Message>
+    static Message message_of(FeedMessageType type, uint32_t symbol) {
+        Message message;
+        std::memset(&message, 0, sizeof(message));
+        message.header.length = static_cast<uint16_t>(sizeof(Message));
+        message.header.type = type;
+        message.header.symbol = symbol;
+        return message;
+    }
+    
+public:
+    // Opens the feed. Over TCP this blocks until a client connects.
+    bool open(const FeedAddress& address, const FeedReplayOptions& options) {
+        address_ = address;
+        options_ = options;
+        packet_.resize(address.udp ? UDP_PACKET : TCP_PACKET);
+        
+        if (address.udp) {
+            if (!socket_.connect_sender(address)) return false;
+            printf("[FEED] Sending to %s\n", address.to_string().c_str());
+            return true;
+        }
+        
+        FeedSocket listener;
+        if (!listener.listen(address)) return false;
+        printf("[FEED] Waiting for a client on %s...\n", address.to_string().c_str());
+        fflush(stdout);
+        if (!socket_.accept(listener)) return false;
+        printf("[FEED] Client connected\n");
+        return true;
+    }
+    
+    // Sends the source, then the end of the session. Returns the events sent.
+    size_t run(MarketDataSource& source) {
+        FeedPacketWriter writer(packet_.data(), packet_.size(), 1);
+        ReplayClock clock(ReplayMode::ScaledRealTime, options_.speed);
+        const bool paced = options_.rate > 0 || options_.replay == ReplayMode::ScaledRealTime;
+        const Clock::time_point start = Clock::now();
+        bool ok = true;
+        size_t sent = 0;
+        size_t skipped = 0;
+        
+        auto flush = [&]() {
+            if (writer.empty() || !ok) return;
+            ok = socket_.send_all(packet_.data(), writer.finish());
+            writer.reset();
+            ++packets_;
+        };
+        auto add = [&](const auto& message) {
+            if (!writer.add(message)) {
+                flush();
+                writer.add(message);
+            }
+        };
+        // The k-th event (from 0) is due at start + k / rate
+        auto due = [&](size_t k, const MarketDataEvent& event) {
+            if (options_.rate > 0) {
+                return start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(static_cast<double>(k) / options_.rate));
+            }
+            return clock.due(event.timestamp);
+        };
+        // Names the event's symbol if it is due. Returns false if the symbol
+        // cannot be sent.
+        auto announce = [&](const MarketDataEvent& event) {
+            if (event.symbol_id >= announced_.size()) {
+                announced_.resize(event.symbol_id + 1);
+            }
+            Announcement& announcement = announced_[event.symbol_id];
+            if (announcement.refused) return false;
+            if (announcement.sent &&
+                (!address_.udp || packets_ < announcement.packet + REANNOUNCE_PACKETS)) {
+                return true;
+            }
+            
+            const std::string& name = event.symbol();
+            if (name.size() > MAX_NAME) {
+                printf("[WARNING] Symbol %s is longer than %zu characters; not sending its events\n",
+                       name.c_str(), MAX_NAME);
+                announcement.refused = true;
+                return false;
+            }
+            auto symbol = message_of<FeedSymbolMessage>(FeedMessageType::Symbol, event.symbol_id);
+            std::memcpy(symbol.name, name.data(), name.size());
+            add(symbol);
+            announcement.sent = true;
+            announcement.packet = packets_;
+            return true;
+        };
+        
+        std::vector<MarketDataEvent> chunk;
+        chunk.reserve(CHUNK);
+        
+        while (ok && (options_.max_events == 0 || sent + skipped < options_.max_events)) {
+            chunk.clear();
+            size_t want = CHUNK;
+            if (options_.max_events > 0) {
+                want = std::min(want, options_.max_events - sent - skipped);
+            }
+            if (source.read(chunk, want) == 0) break;
+            
+            for (size_t i = 0; i < chunk.size() && ok; ++i) {
+                const MarketDataEvent& event = chunk[i];
+                if (!announce(event)) {
+                    // What is queued may be waiting on this event
+                    ++skipped;
+                    if (paced) flush();
+                    continue;
+                }
+                if (paced) {
+                    std::this_thread::sleep_until(due(sent, event));
+                }
+                
+                if (options_.ticks) {
+                    auto tick = message_of<FeedTickMessage>(FeedMessageType::Tick, event.symbol_id);
+                    tick.timestamp = static_cast<int64_t>(event.timestamp);
+                    tick.price = event.close;
+                    tick.size = static_cast<int64_t>(event.volume);
+                    tick.bid = event.bid;
+                    tick.ask = event.ask;
+                    add(tick);
+                } else {
+                    auto bar = message_of<FeedBarMessage>(FeedMessageType::Bar, event.symbol_id);
+                    bar.timestamp = static_cast<int64_t>(event.timestamp);
+                    bar.open = event.open;
+                    bar.high = event.high;
+                    bar.low = event.low;
+                    bar.close = event.close;
+                    bar.adj_close = event.adj_close;
+                    bar.volume = static_cast<int64_t>(event.volume);
+                    bar.bid = event.bid;
+                    bar.ask = event.ask;
+                    add(bar);
+                }
+                ++sent;
+                
+                // Paced, send as soon as the next event is not due yet
+                if (paced && (i + 1 == chunk.size() || Clock::now() < due(sent, chunk[i + 1]))) {
+                    flush();
+                }
+            }
+        }
+        
+        add(message_of<FeedEndMessage>(FeedMessageType::End, 0));
+        flush();
+        
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (!ok) {
+            printf("[ERROR] Could not send to %s\n", address_.to_string().c_str());
+        }
+        printf("[FEED] Sent %zu events in %llu packets to %s (%.2f s, %.0f events/s)\n", sent,
+               static_cast<unsigned long long>(packets_), address_.to_string().c_str(), seconds,
+               seconds > 0 ? sent / seconds : 0.0);
+        if (skipped > 0) {
+            printf("[WARNING] %zu events not sent: symbol names too long for the feed\n", skipped);
+        }
+        return sent;
+    }
+};
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Where a market-data feed is: tcp://host:port or udp://host:port. Hosts
+// are IPv4 addresses or localhost; a UDP address in 224.0.0.0/4 is a
+// multicast group.
+struct FeedAddress {
+    bool udp = false;
+    std::string host;
+    uint16_t port = 0;
+    in_addr ip{};
+    
+    // Returns false (after printing why) if url is not a feed address.
+    static bool parse(const std::string& url, FeedAddress& address) {
+        size_t scheme_end = url.find("://");
+        size_t colon = url.rfind(':');
+        std::string scheme = url.substr(0, scheme_end);
+        bool ok = scheme_end != std::string::npos && (scheme == "tcp" || scheme == "udp") &&
+                  colon > scheme_end + 3;
+        
+        if (ok) {
+            address.udp = scheme == "udp";
+            address.host = url.substr(scheme_end + 3, colon - scheme_end - 3);
+            long port = std::strtol(url.c_str() + colon + 1, nullptr, 10);
+            address.port = static_cast<uint16_t>(port);
+            std::string numeric = address.host == "localhost" ? "127.0.0.1" : address.host;
+            ok = port > 0 && port <= 65535 && inet_pton(AF_INET, numeric.c_str(), &address.ip) == 1;
+        }
+        
+        if (!ok) {
+            printf("[ERROR] Not a feed address (tcp://host:port or udp://host:port): %s\n", url.c_str());
+        }
+        return ok;
+    }
+    
+    bool is_multicast() const {
+        return udp && (ntohl(ip.s_addr) >> 28) == 0xE;
+    }
+    
+    sockaddr_in socket_address() const {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr = ip;
+        return address;
+    }
+    
+    std::string to_string() const {
+        return std::string(udp ? "udp://" : "tcp://") + host + ":" + std::to_string(port);
+    }
+};
+
+// Thin owner of one IPv4 socket, with the few operations the feed needs.
+// Functions return false after printing what failed, like the file classes.
+class FeedSocket {
+public:
+#ifdef _WIN32
+    using Handle = SOCKET;
+    static constexpr Handle INVALID = INVALID_SOCKET;
+#else
+    using Handle = int;
+    static constexpr Handle INVALID = -1;
+#endif
+
+private:
+    Handle handle_ = INVALID;
+    bool has_target_ = false;  // UDP sender: datagrams go to target_
+    sockaddr_in target_{};
+    
+    // Winsock needs starting once per process
+    static bool startup() {
+#ifdef _WIN32
+        static const bool started = []() {
+            WSADATA data;
+            return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+        return started;
+#else
+        return true;
+#endif
+    }
+    
+    bool create(int type, const FeedAddress& address) {
+        close();
+        if (startup()) {
+            handle_ = ::socket(AF_INET, type, 0);
+        }
+        if (handle_ == INVALID) {
+            printf("[ERROR] Could not create a socket for %s\n", address.to_string().c_str());
+            return false;
+        }
+        return true;
+    }
+    
+    template<typename T>
+    bool set_option(int level, int name, const T& value) {
+        return setsockopt(handle_, level, name, reinterpret_cast<const char*>(&value), sizeof(value)) == 0;
+    }
+    
+    bool fail(const char* what, const FeedAddress& address) {
+        printf("[ERROR] Could not %s %s\n", what, address.to_string().c_str());
+        close();
+        return false;
+    }
+    
+public:
+    FeedSocket() = default;
+    
+    ~FeedSocket() {
+        close();
+    }
+    
+    FeedSocket(const FeedSocket&) = delete;
+    FeedSocket& operator=(const FeedSocket&) = delete;
+    
+    FeedSocket(FeedSocket&& other) noexcept {
+        *this = std::move(other);
+    }
+    
+    FeedSocket& operator=(FeedSocket&& other) noexcept {
+        if (this != &other) {
+            close();
+            handle_ = other.handle_;
+            has_target_ = other.has_target_;
+            target_ = other.target_;
+            other.handle_ = INVALID;
+        }
+        return *this;
+    }
+    
+    void close() {
+        if (handle_ == INVALID) return;
+#ifdef _WIN32
+        closesocket(handle_);
+#else
+        ::close(handle_);
+#endif
+        handle_ = INVALID;
+        has_target_ = false;
+    }
+    
+    bool is_open() const {
+        return handle_ != INVALID;
+    }
+    
+    // TCP client side.
+    bool connect(const FeedAddress& address) {
+        if (!create(SOCK_STREAM, address)) return false;
+        sockaddr_in target = address.socket_address();
+        if (::connect(handle_, reinterpret_cast<const sockaddr*>(&target), sizeof(target)) != 0) {
+            return fail("connect to", address);
+        }
+        set_option(IPPROTO_TCP, TCP_NODELAY, 1);
+        return true;
+    }
+    
+    // TCP server side: listens on address for one connection.
+    bool listen(const FeedAddress& address) {
+        if (!create(SOCK_STREAM, address)) return false;
+        set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+        sockaddr_in local = address.socket_address();
+        if (::bind(handle_, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0 ||
+            ::listen(handle_, 1) != 0) {
+            return fail("listen on", address);
+        }
+        return true;
+    }
+    
+    // Waits for a client on a listening socket and takes over its connection.
+    bool accept(FeedSocket& listener) {
+        close();
+        handle_ = ::accept(listener.handle_, nullptr, nullptr);
+        if (handle_ == INVALID) {
+            printf("[ERROR] Could not accept a feed connection\n");
+            return false;
+        }
+        set_option(IPPROTO_TCP, TCP_NODELAY, 1);
+        return true;
+    }
+    
+    // UDP receive side: binds the port and joins the group if the address is
+    // multicast. receive_buffer is the kernel buffer asked for, which is all
+    // that absorbs bursts on UDP.
+    bool bind_receiver(const FeedAddress& address, int receive_buffer) {
+        if (!create(SOCK_DGRAM, address)) return false;
+        set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+        set_option(SOL_SOCKET, SO_RCVBUF, receive_buffer);
+        
+        // A group is joined on every interface, so bind the port only
+        sockaddr_in local = address.socket_address();
+        if (address.is_multicast()) {
+            local.sin_addr.s_addr = htonl(INADDR_ANY);
+        }
+        if (::bind(handle_, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0) {
+            return fail("bind", address);
+        }
+        
+        if (address.is_multicast()) {
+            ip_mreq group{};
+            group.imr_multiaddr = address.ip;
+            group.imr_interface.s_addr = htonl(INADDR_ANY);
+            if (!set_option(IPPROTO_IP, IP_ADD_MEMBERSHIP, group)) {
+                return fail("join multicast group", address);
+            }
+        }
+        return true;
+    }
+    
+    // UDP send side. The socket is not connected, so nobody listening is not
+    // an error. Multicast stays on this host's network and is looped back,
+    // so a receiver on the same machine sees it.
+    bool connect_sender(const FeedAddress& address) {
+        if (!create(SOCK_DGRAM, address)) return false;
+        if (address.is_multicast()) {
+            set_option(IPPROTO_IP, IP_MULTICAST_TTL, 1);
+            set_option(IPPROTO_IP, IP_MULTICAST_LOOP, 1);
+        }
+        target_ = address.socket_address();
+        has_target_ = true;
+        return true;
+    }
+    
+    // Waits until there is something to receive. A negative timeout waits
+    // for ever. Returns false on timeout.
+    bool wait_readable(std::chrono::milliseconds timeout) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(handle_, &readable);
+        timeval limit;
+        limit.tv_sec = static_cast<long>(timeout.count() / 1000);
+        limit.tv_usec = static_cast<long>(timeout.count() % 1000 * 1000);
+        return select(static_cast<int>(handle_ + 1), &readable, nullptr, nullptr,
+                      timeout.count() < 0 ? nullptr : &limit) > 0;
+    }
+    
+    // One recv(): a datagram, or whatever part of a stream has arrived.
+    // Returns the bytes received, 0 once a stream is closed, -1 on error.
+    long receive(char* buffer, size_t size) {
+        return static_cast<long>(::recv(handle_, buffer, static_cast<int>(size), 0));
+    }
+    
+    // Sends all of data, waiting while the peer's window is full. A datagram
+    // goes out whole or not at all.
+    bool send_all(const char* data, size_t size) {
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL;  // A closed peer is an error, not SIGPIPE
+#else
+        const int flags = 0;
+#endif
+        if (has_target_) {
+            return ::sendto(handle_, data, static_cast<int>(size), flags,
+                            reinterpret_cast<const sockaddr*>(&target_), sizeof(target_)) ==
+                   static_cast<long>(size);
+        }
+        while (size > 0) {
+            long sent = static_cast<long>(::send(handle_, data, static_cast<int>(size), flags));
+            if (sent <= 0) return false;
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+};
@@ -0,0 +1,416 @@
+#pragma once
+
+#include "CheckpointState.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Rolling indicators with O(1) updates over fixed-capacity ring buffers.
+// Windows only allocate once, so per-bar cost does not grow with the window.
+
+// Fixed-capacity ring buffer over contiguous storage. Once full, push()
+// overwrites the oldest value.
+template<typename T>
+class RingBuffer {
+private:
+    std::vector<T> data_;
+    size_t head_ = 0;  // Next slot to write
+    size_t size_ = 0;
+    
+public:
+    explicit RingBuffer(size_t capacity = 1)
+        : data_(std::max<size_t>(1, capacity)) {}
+    
+    // Returns the value pushed out, or T() while not yet full.
+    T push(const T& value) {
+        T evicted = full() ? data_[head_] : T();
+        data_[head_] = value;
+        head_ = (head_ + 1 == data_.size()) ? 0 : head_ + 1;
+        if (size_ < data_.size()) ++size_;
+        return evicted;
+    }
+    
+    // ago(0) is the newest value, ago(size() - 1) the oldest.
+    const T& ago(size_t k) const {
+        size_t index = head_ + data_.size() - 1 - k;
+        return data_[index >= data_.size() ? index - data_.size() : index];
+    }
+    
+    const T& back() const {
+        return ago(0);
+    }
+    
+    size_t size() const {
+        return size_;
+    }
+    
+    size_t capacity() const {
+        return data_.size();
+    }
+    
+    bool full() const {
+        return size_ == data_.size();
+    }
+    
+    bool empty() const {
+        return size_ == 0;
+    }
+    
+    void clear() {
+        head_ = 0;
+        size_ = 0;
+    }
+    
+    void save_state(StateWriter& state) const {
+        state.put<uint64_t>(head_);
+        state.put<uint64_t>(size_);
+        state.put_vector(data_);
+    }
+    
+    // The capacity must match the one saved.
+    bool load_state(StateReader& state) {
+        uint64_t head = 0, size = 0;
+        std::vector<T> data;
+        if (!state.get(head) || !state.get(size) || !state.get_vector(data)) return false;
+        if (data.size() != data_.size() || head >= data.size() || size > data.size()) {
+            return state.fail("for a different window length");
+        }
+        data_ = std::move(data);
+        head_ = static_cast<size_t>(head);
+        size_ = static_cast<size_t>(size);
+        return true;
+    }
+};
+
+// Running sum with Neumaier compensation so adding and removing values over
+// millions of bars does not drift from a fresh sum of the window.
+class CompensatedSum {
+private:
+    double sum_ = 0.0;
+    double compensation_ = 0.0;
+    
+public:
+    void add(double value) {
+        double t = sum_ + value;
+        if (std::fabs(sum_) >= std::fabs(value)) {
+            compensation_ += (sum_ - t) + value;
+        } else {
+            compensation_ += (value - t) + sum_;
+        }
+        sum_ = t;
+    }
+    
+    double value() const {
+        return sum_ + compensation_;
+    }
+    
+    void clear() {
+        sum_ = 0.0;
+        compensation_ = 0.0;
+    }
+};
+
+// Simple moving average over the last `period` values.
+class RollingMean {
+private:
+    RingBuffer<double> window_;
+    CompensatedSum sum_;
+    
+public:
+    explicit RollingMean(size_t period = 1)
+        : window_(period) {}
+    
+    void push(double value) {
+        bool was_full = window_.full();
+        double evicted = window_.push(value);
+        if (was_full) sum_.add(-evicted);
+        sum_.add(value);
+    }
+    
+    // 0 until the window is full.
+    double value() const {
+        return window_.full() ? sum_.value() / static_cast<double>(window_.capacity()) : 0.0;
+    }
+    
+    bool ready() const {
+        return window_.full();
+    }
+    
+    size_t period() const {
+        return window_.capacity();
+    }
+    
+    void clear() {
+        window_.clear();
+        sum_.clear();
+    }
+    
+    void save_state(StateWriter& state) const {
+        window_.save_state(state);
+        state.put(sum_);
+    }
+    
+    bool load_state(StateReader& state) {
+        return window_.load_state(state) && state.get(sum_);
+    }
+};
+
+// Population variance over the last `period` values using Welford's update,
+// extended to remove the value leaving the window. Sliding updates lose
+// precision when the values sit far from zero relative to their spread (a
+// price drifting over years), so the window is re-summed exactly once every
+// `period` updates, which keeps the cost O(1) amortized.
+class RollingVariance {
+private:
+    RingBuffer<double> window_;
+    double mean_ = 0.0;
+    double m2_ = 0.0;  // Sum of squared deviations from mean_
+    size_t since_resync_ = 0;
+    
+    void resync() {
+        size_t n = window_.size();
+        double sum = 0.0;
+        for (size_t i = n; i-- > 0;) {
+            sum += window_.ago(i);
+        }
+        mean_ = sum / static_cast<double>(n);
+        
+        double m2 = 0.0;
+        for (size_t i = n; i-- > 0;) {
+            double d = window_.ago(i) - mean_;
+            m2 += d * d;
+        }
+        m2_ = m2;
+        since_resync_ = 0;
+    }
+    
+public:
+    explicit RollingVariance(size_t period = 1)
+        : window_(period) {}
+    
+    void push(double value) {
+        if (!window_.full()) {
+            window_.push(value);
+            double delta = value - mean_;
+            mean_ += delta / static_cast<double>(window_.size());
+            m2_ += delta * (value - mean_);
+            if (window_.full()) resync();
+            return;
+        }
+        
+        double evicted = window_.push(value);
+        if (++since_resync_ == window_.capacity()) {
+            resync();
+            return;
+        }
+        
+        double old_mean = mean_;
+        mean_ += (value - evicted) / static_cast<double>(window_.capacity());
+        m2_ += (value - evicted) * (value - mean_ + evicted - old_mean);
+        if (m2_ < 0.0) m2_ = 0.0;
+    }
+    
+    double mean() const {
+        return mean_;
+    }
+    
+    // 0 until the window is full.
+    double variance() const {
+        return window_.full() ? m2_ / static_cast<double>(window_.capacity()) : 0.0;
+    }
+    
+    double stddev() const {
+        return std::sqrt(variance());
+    }
+    
+    bool ready() const {
+        return window_.full();
+    }
+    
+    void clear() {
+        window_.clear();
+        mean_ = 0.0;
+        m2_ = 0.0;
+        since_resync_ = 0;
+    }
+    
+    void save_state(StateWriter& state) const {
+        window_.save_state(state);
+        state.put(mean_);
+        state.put(m2_);
+        state.put<uint64_t>(since_resync_);
+    }
+    
+    bool load_state(StateReader& state) {
+        uint64_t since_resync = 0;
+        if (!window_.load_state(state) || !state.get(mean_) || !state.get(m2_) ||
+            !state.get(since_resync)) {
+            return false;
+        }
+        since_resync_ = static_cast<size_t>(since_resync);
+        return true;
+    }
+};
+
+// Relative change against the value `lag` bars back: (x - x[lag]) / x[lag].
+class Lookback {
+private:
+    RingBuffer<double> window_;
+    
+public:
+    explicit Lookback(size_t lag = 1)
+        : window_(lag + 1) {}
+    
+    void push(double value) {
+        window_.push(value);
+    }
+    
+    // 0 until `lag` earlier values have been seen.
+    double change() const {
+        if (!window_.full()) return 0.0;
+        double base = window_.ago(window_.capacity() - 1);
+        return (window_.back() - base) / base;
+    }
+    
+    bool ready() const {
+        return window_.full();
+    }
+    
+    void clear() {
+        window_.clear();
+    }
+    
+    void save_state(StateWriter& state) const {
+        window_.save_state(state);
+    }
+    
+    bool load_state(StateReader& state) {
+        return window_.load_state(state);
+    }
+};
+
+// The eight model features MovingAverageStrategy sends for each bar, in the
+// order train_model.py expects them.
+enum Feature {
+    FEATURE_RETURN_1 = 0,
+    FEATURE_RETURN_5,
+    FEATURE_SHORT_MA,
+    FEATURE_LONG_MA,
+    FEATURE_VOLATILITY,
+    FEATURE_VOLUME_RATIO,
+    FEATURE_CLOSE,
+    FEATURE_MOMENTUM,
+    FEATURE_COUNT
+};
+
+// Per-symbol feature state, updated once per bar.
+//
+// Reproduces the original deque-based strategy exactly, including its edges:
+// history was capped at long_period + 10 bars, so a window longer than that
+// never fills (MA/volatility stay 0, volume ratio stays 1); the first bar
+// with a full long window only sets the previous close; volatility is the
+// population std of the last 20 closes; the volume ratio compares the bar's
+// volume with the mean of the 20 bars before it; return_5 and momentum are
+// both measured against the close 4 bars back.
+class FeatureCalculator {
+private:
+    static constexpr size_t VOLATILITY_PERIOD = 20;
+    static constexpr size_t VOLUME_PERIOD = 20;
+    static constexpr size_t RETURN_LAG = 4;
+    
+    size_t short_period_;
+    size_t long_period_;
+    size_t history_cap_;
+    
+    RollingMean short_ma_;
+    RollingMean long_ma_;
+    RollingVariance volatility_;
+    RollingMean volume_mean_;  // Excludes the current bar
+    Lookback return_5_;
+    
+    size_t bars_ = 0;
+    double prev_close_ = 0.0;
+    bool initialized_ = false;
+    
+    size_t history_size() const {
+        return std::min(bars_, history_cap_);
+    }
+    
+public:
+    FeatureCalculator(int short_period = 10, int long_period = 50)
+        : short_period_(static_cast<size_t>(short_period)),
+          long_period_(static_cast<size_t>(long_period)),
+          history_cap_(static_cast<size_t>(long_period) + 10),
+          short_ma_(short_period_), long_ma_(long_period_),
+          volatility_(VOLATILITY_PERIOD), volume_mean_(VOLUME_PERIOD),
+          return_5_(RETURN_LAG) {}
+    
+    // Adds a bar. Returns true and fills out[FEATURE_COUNT] once enough
+    // history is available, false during warm-up.
+    bool update(double close, double volume, double* out) {
+        // Volume ratio uses the window before this bar is added
+        bool has_volume = volume_mean_.ready() && history_cap_ > VOLUME_PERIOD;
+        double avg_volume = volume_mean_.value();
+        
+        ++bars_;
+        short_ma_.push(close);
+        long_ma_.push(close);
+        volatility_.push(close);
+        volume_mean_.push(volume);
+        return_5_.push(close);
+        
+        size_t size = history_size();
+        
+        if (size < long_period_) {
+            prev_close_ = close;
+            return false;
+        }
+        
+        if (!initialized_) {
+            initialized_ = true;
+            prev_close_ = close;
+            return false;
+        }
+        
+        out[FEATURE_RETURN_1] = (close - prev_close_) / prev_close_;
+        out[FEATURE_RETURN_5] = (size > RETURN_LAG) ? return_5_.change() : 0.0;
+        out[FEATURE_SHORT_MA] = (size >= short_period_) ? short_ma_.value() : 0.0;
+        out[FEATURE_LONG_MA] = long_ma_.value();
+        out[FEATURE_VOLATILITY] = (size >= VOLATILITY_PERIOD) ? volatility_.stddev() : 0.0;
+        out[FEATURE_VOLUME_RATIO] = (has_volume && avg_volume > 0) ? volume / avg_volume : 1.0;
+        out[FEATURE_CLOSE] = close;
+        out[FEATURE_MOMENTUM] = out[FEATURE_RETURN_5];
+        
+        prev_close_ = close;
+        return true;
+    }
+    
+    size_t bars() const {
+        return bars_;
+    }
+    
+    void save_state(StateWriter& state) const {
+        short_ma_.save_state(state);
+        long_ma_.save_state(state);
+        volatility_.save_state(state);
+        volume_mean_.save_state(state);
+        return_5_.save_state(state);
+        state.put<uint64_t>(bars_);
+        state.put(prev_close_);
+        state.put(initialized_);
+    }
+    
+    // The periods must match the ones saved.
+    bool load_state(StateReader& state) {
+        uint64_t bars = 0;
+        if (!short_ma_.load_state(state) || !long_ma_.load_state(state) ||
+            !volatility_.load_state(state) || !volume_mean_.load_state(state) ||
+            !return_5_.load_state(state) || !state.get(bars) || !state.get(prev_close_) ||
+            !state.get(initialized_)) {
+            return false;
+        }
+        bars_ = static_cast<size_t>(bars);
+        return true;
+    }
+};
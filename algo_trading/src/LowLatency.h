@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN  // Keep winsock.h out; httplib.h needs winsock2.h
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// Cores for the threads of a single-engine run; -1 leaves a thread to the
+// scheduler.
+struct CpuPlacement {
+    int producer = -1;  // Reads the source and feeds the engine queue
+    int engine = -1;    // Runs the strategy
+    int logger = -1;    // Writes trades.csv
+    
+    bool any() const {
+        return producer >= 0 || engine >= 0 || logger >= 0;
+    }
+    
+    // Parses "producer,engine,logger", e.g. "2,3,4"; "-" leaves one alone.
+    static bool parse(const std::string& text, CpuPlacement& placement) {
+        int* cpus[3] = {&placement.producer, &placement.engine, &placement.logger};
+        size_t begin = 0;
+        bool ok = true;
+        for (int i = 0; i < 3 && ok; ++i) {
+            size_t end = text.find(',', begin);
+            ok = (end == std::string::npos) == (i == 2);
+            std::string field = text.substr(begin, ok && i < 2 ? end - begin : std::string::npos);
+            begin = end + 1;
+            
+            char* rest = nullptr;
+            long cpu = std::strtol(field.c_str(), &rest, 10);
+            if (field == "-") {
+                *cpus[i] = -1;
+            } else {
+                ok = ok && !field.empty() && *rest == '\0' && cpu >= 0 && cpu < 1024;
+                *cpus[i] = static_cast<int>(cpu);
+            }
+        }
+        
+        if (!ok) {
+            printf("[ERROR] --cpus takes three cores, producer,engine,logger (e.g. 2,3,4): %s\n",
+                   text.c_str());
+        }
+        return ok;
+    }
+};
+
+// Thread placement and memory setup for running with predictable latency:
+// a pinned thread is never migrated away from its warm caches, and locked
+// memory never takes a page fault on the hot path.
+class LowLatency {
+public:
+    // Stack each pinned thread touches up front, so its first deep call
+    // does not fault
+    static constexpr size_t STACK_PREFAULT = 256 * 1024;
+    
+    // Pins the calling thread to cpu and pre-faults its stack. Does nothing
+    // for cpu < 0. Returns false (after a warning) if pinning is refused.
+    static bool prepare_thread(int cpu, const char* role) {
+        if (cpu < 0) return true;
+        
+        prefault_stack();
+        
+        bool pinned = false;
+#if defined(_WIN32)
+        pinned = cpu < 64 && SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pinned = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+        if (!pinned) {
+            printf("[WARNING] Could not pin the %s thread to CPU %d\n", role, cpu);
+        }
+        return pinned;
+    }
+    
+    // Locks the pages the process has mapped now, which also faults them
+    // in; later mappings are left alone, so call it once the hot buffers
+    // and threads exist. Mapped files count too. On success freed memory is
+    // kept rather than handed back to the OS, so it stays locked for reuse.
+    // Needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK (ulimit -l) on
+    // Linux.
+    static bool lock_memory() {
+#if defined(_WIN32)
+        printf("[WARNING] --lock-memory is not supported on Windows\n");
+        return false;
+#else
+        if (mlockall(MCL_CURRENT) != 0) {
+            printf("[WARNING] Could not lock memory (raise ulimit -l or run with CAP_IPC_LOCK)\n");
+            return false;
+        }
+#ifdef __GLIBC__
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+#endif
+        return true;
+#endif
+    }
+    
+    static unsigned cpu_count() {
+        return std::thread::hardware_concurrency();
+    }
+    
+private:
+    static void prefault_stack() {
+        volatile char stack[STACK_PREFAULT];
+        for (size_t i = 0; i < STACK_PREFAULT; i += 4096) {
+            stack[i] = 0;
+        }
+        (void)stack[0];
+    }
+};
@@ -1,11 +1,20 @@
 #pragma once
 
+#include "SymbolTable.h"
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <ctime>
+#include <cstdio>
+#include <type_traits>
 
-struct MarketDataEvent {
+// Trivially copyable so events can be moved through queues and buffers with
+// plain memcpy. The ticker is carried as an interned SymbolId; use symbol()
+// to resolve it where a name is needed.
+struct alignas(16) MarketDataEvent {
     std::time_t timestamp;
-    std::string symbol;
+    SymbolId symbol_id;
+    uint32_t feed_stamp;  // Feed send time for network events, see make_feed_stamp(); 0 = none
     double open;
     double high;
     double low;
@@ -16,15 +25,25 @@ struct MarketDataEvent {
     double ask;
     
     MarketDataEvent()
-        : timestamp(0), symbol(""), open(0), high(0), low(0),
-          close(0), adj_close(0), volume(0), bid(0), ask(0) {}
+        : timestamp(0), symbol_id(SymbolTable::INVALID_ID), feed_stamp(0), open(0), high(0),
+          low(0), close(0), adj_close(0), volume(0), bid(0), ask(0) {}
     
-    MarketDataEvent(std::time_t ts, const std::string& sym,
+    MarketDataEvent(std::time_t ts, SymbolId sym,
                     double o, double h, double l, double c,
                     double ac, long long vol, double b, double a)
-        : timestamp(ts), symbol(sym), open(o), high(h), low(l),
+        : timestamp(ts), symbol_id(sym), feed_stamp(0), open(o), high(h), low(l),
           close(c), adj_close(ac), volume(vol), bid(b), ask(a) {}
     
+    MarketDataEvent(std::time_t ts, const std::string& sym,
+                    double o, double h, double l, double c,
+                    double ac, long long vol, double b, double a)
+        : MarketDataEvent(ts, SymbolTable::instance().intern(sym),
+                          o, h, l, c, ac, vol, b, a) {}
+    
+    const std::string& symbol() const {
+        return SymbolTable::instance().name(symbol_id);
+    }
+    
     double mid_price() const {
         return (bid + ask) / 2.0;
     }
@@ -33,8 +52,28 @@ struct MarketDataEvent {
         return ask - bid;
     }
     
+    // Events received from a network feed carry the time the feed sent them:
+    // the steady clock in 100 ns units, kept modulo 2^32, so an age is exact
+    // for up to about seven minutes.
+    static uint32_t make_feed_stamp(uint64_t steady_ns) {
+        uint32_t stamp = static_cast<uint32_t>(steady_ns / 100);
+        return stamp != 0 ? stamp : 1;
+    }
+    
+    // Nanoseconds since the feed sent this event; only if feed_stamp != 0.
+    uint64_t feed_age_ns(std::chrono::steady_clock::time_point now) const {
+        uint64_t now_ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count());
+        return static_cast<uint64_t>(static_cast<uint32_t>(now_ns / 100 - feed_stamp)) * 100;
+    }
+    
     void print() const {
-        printf("[Event] %s @ %ld: O=%.2f H=%.2f L=%.2f C=%.2f V=%lld\n",
-               symbol.c_str(), timestamp, open, high, low, close, volume);
+        printf("[Event] %s @ %lld: O=%.2f H=%.2f L=%.2f C=%.2f V=%lld\n",
+               symbol().c_str(), static_cast<long long>(timestamp),
+               open, high, low, close, volume);
     }
 };
+
+static_assert(std::is_trivially_copyable<MarketDataEvent>::value,
+              "MarketDataEvent must stay trivially copyable");
+static_assert(sizeof(MarketDataEvent) == 80, "MarketDataEvent layout changed");
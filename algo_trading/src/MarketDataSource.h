@@ -0,0 +1,348 @@
+#pragma once
+
+#include "MarketDataEvent.h"
+#include "MappedFile.h"
+#include "TickStore.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Pull-based stream of market data. Sources hand out events in chunks so the
+// caller never needs the whole data set in memory.
+class MarketDataSource {
+public:
+    virtual ~MarketDataSource() = default;
+    
+    // Appends up to max_events events to out. Returns the number appended;
+    // 0 means the source is exhausted.
+    virtual size_t read(std::vector<MarketDataEvent>& out, size_t max_events) = 0;
+    
+    virtual std::string name() const = 0;
+    
+    // Passes over up to count events without handing them out, as when
+    // resuming from a checkpoint. Returns the number skipped.
+    virtual size_t skip(size_t count) {
+        std::vector<MarketDataEvent> scratch;
+        size_t skipped = 0;
+        while (skipped < count) {
+            scratch.clear();
+            size_t got = read(scratch, std::min<size_t>(count - skipped, 4096));
+            if (got == 0) break;
+            skipped += got;
+        }
+        return skipped;
+    }
+    
+    // Opens a .tick file or falls back to CSV. Returns nullptr on failure.
+    static std::unique_ptr<MarketDataSource> open(const std::string& filename);
+    
+    // Opens each path (a directory stands for its .csv and .tick files in
+    // name order) and merges them by timestamp. A single file is opened
+    // directly. Returns nullptr if any file fails to open.
+    static std::unique_ptr<MarketDataSource> open(const std::vector<std::string>& paths);
+};
+
+// Parses a mapped CSV file lazily, one chunk per read() call.
+class CsvFileSource : public MarketDataSource {
+private:
+    std::string filename_;
+    MappedFile file_;
+    const char* cursor_ = nullptr;
+    MarketDataEvent scratch_;
+    
+public:
+    bool open(const std::string& filename) {
+        filename_ = filename;
+        
+        if (!file_.open(filename)) {
+            printf("[ERROR] Could not open file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        cursor_ = file_.begin();
+        
+        // Skip header
+        if (cursor_ < file_.end()) {
+            const char* line_end;
+            cursor_ = Utils::next_line(cursor_, file_.end(), line_end);
+        }
+        
+        return true;
+    }
+    
+    size_t read(std::vector<MarketDataEvent>& out, size_t max_events) override {
+        size_t count = 0;
+        const char* end = file_.end();
+        
+        while (count < max_events && cursor_ < end) {
+            const char* line_end;
+            const char* next = Utils::next_line(cursor_, end, line_end);
+            
+            if (Utils::parse_csv_row(cursor_, line_end, scratch_)) {
+                out.push_back(scratch_);
+                ++count;
+            } else {
+                printf("[WARNING] Skipping invalid line: %.*s\n",
+                       static_cast<int>(line_end - cursor_), cursor_);
+            }
+            
+            cursor_ = next;
+        }
+        
+        return count;
+    }
+    
+    // Parses and discards, so invalid lines are passed over as read() does
+    // (without warning again) and count must be in events, not lines.
+    size_t skip(size_t count) override {
+        size_t skipped = 0;
+        const char* end = file_.end();
+        while (skipped < count && cursor_ < end) {
+            const char* line_end;
+            const char* next = Utils::next_line(cursor_, end, line_end);
+            if (Utils::parse_csv_row(cursor_, line_end, scratch_)) {
+                ++skipped;
+            }
+            cursor_ = next;
+        }
+        return skipped;
+    }
+    
+    std::string name() const override {
+        return filename_;
+    }
+};
+
+// Serves rows from a memory-mapped tick store.
+class TickStoreSource : public MarketDataSource {
+private:
+    std::string filename_;
+    TickStoreReader reader_;
+    size_t row_ = 0;
+    
+public:
+    bool open(const std::string& filename) {
+        filename_ = filename;
+        row_ = 0;
+        return reader_.open(filename);
+    }
+    
+    size_t read(std::vector<MarketDataEvent>& out, size_t max_events) override {
+        size_t count = 0;
+        
+        while (count < max_events && row_ < reader_.size()) {
+            out.push_back(reader_.event(row_++));
+            ++count;
+        }
+        
+        return count;
+    }
+    
+    size_t skip(size_t count) override {
+        size_t skipped = std::min(count, reader_.size() - row_);
+        row_ += skipped;
+        return skipped;
+    }
+    
+    std::string name() const override {
+        return filename_;
+    }
+    
+    const TickStoreReader& reader() const {
+        return reader_;
+    }
+};
+
+// Replays events already held in memory. The buffer is shared, so several
+// sources (or other readers) can use it at once.
+class EventBufferSource : public MarketDataSource {
+private:
+    std::shared_ptr<const std::vector<MarketDataEvent>> events_;
+    std::string name_;
+    size_t row_ = 0;
+    
+public:
+    EventBufferSource(std::shared_ptr<const std::vector<MarketDataEvent>> events,
+                      const std::string& name)
+        : events_(std::move(events)), name_(name) {}
+    
+    size_t read(std::vector<MarketDataEvent>& out, size_t max_events) override {
+        size_t count = std::min(max_events, events_->size() - row_);
+        out.insert(out.end(), events_->begin() + row_, events_->begin() + row_ + count);
+        row_ += count;
+        return count;
+    }
+    
+    size_t skip(size_t count) override {
+        size_t skipped = std::min(count, events_->size() - row_);
+        row_ += skipped;
+        return skipped;
+    }
+    
+    std::string name() const override {
+        return name_;
+    }
+};
+
+// Merges several time-ordered sources, typically one file per symbol, into
+// one time-ordered stream.
+//
+// Each source is read ahead a small chunk at a time into its own buffer, and
+// a min-heap keyed on (timestamp, source index) picks the next event, so the
+// cost is O(log k) per event for k sources and memory is k chunks however
+// large the files are. Equal timestamps come out in source order, and each
+// source keeps its own order, so the stream is the same on every run.
+class MergedSource : public MarketDataSource {
+private:
+    struct Cursor {
+        std::unique_ptr<MarketDataSource> source;
+        std::vector<MarketDataEvent> buffer;
+        size_t position = 0;
+        std::time_t last_timestamp = 0;
+        bool unordered = false;  // Warned about going back in time
+    };
+    
+    struct HeapEntry {
+        std::time_t timestamp;
+        uint32_t source;
+        
+        // Inverted for std::*_heap, which keeps the largest at the front
+        bool operator<(const HeapEntry& other) const {
+            if (timestamp != other.timestamp) return timestamp > other.timestamp;
+            return source > other.source;
+        }
+    };
+    
+    std::vector<Cursor> cursors_;
+    std::vector<HeapEntry> heap_;
+    size_t read_ahead_;
+    bool primed_ = false;
+    
+    // Makes sure cursor has an unread event. Returns false once its source
+    // is exhausted.
+    bool fill(Cursor& cursor) {
+        if (cursor.position < cursor.buffer.size()) return true;
+        
+        cursor.buffer.clear();
+        cursor.position = 0;
+        return cursor.source->read(cursor.buffer, read_ahead_) > 0;
+    }
+    
+    void prime() {
+        primed_ = true;
+        heap_.reserve(cursors_.size());
+        for (size_t i = 0; i < cursors_.size(); ++i) {
+            if (fill(cursors_[i])) {
+                heap_.push_back(HeapEntry{cursors_[i].buffer.front().timestamp, static_cast<uint32_t>(i)});
+            }
+        }
+        std::make_heap(heap_.begin(), heap_.end());
+    }
+    
+public:
+    // read_ahead is the chunk each source reads at a time.
+    explicit MergedSource(std::vector<std::unique_ptr<MarketDataSource>> sources,
+                          size_t read_ahead = 256)
+        : read_ahead_(std::max<size_t>(1, read_ahead)) {
+        cursors_.resize(sources.size());
+        for (size_t i = 0; i < sources.size(); ++i) {
+            cursors_[i].source = std::move(sources[i]);
+            cursors_[i].buffer.reserve(read_ahead_);
+        }
+    }
+    
+    size_t read(std::vector<MarketDataEvent>& out, size_t max_events) override {
+        if (!primed_) prime();
+        
+        size_t count = 0;
+        while (count < max_events && !heap_.empty()) {
+            std::pop_heap(heap_.begin(), heap_.end());
+            Cursor& cursor = cursors_[heap_.back().source];
+            
+            const MarketDataEvent& event = cursor.buffer[cursor.position++];
+            if (event.timestamp < cursor.last_timestamp && !cursor.unordered) {
+                cursor.unordered = true;
+                printf("[WARNING] %s is not in time order; its events are merged as they come\n",
+                       cursor.source->name().c_str());
+            }
+            cursor.last_timestamp = event.timestamp;
+            out.push_back(event);
+            ++count;
+            
+            if (fill(cursor)) {
+                heap_.back().timestamp = cursor.buffer[cursor.position].timestamp;
+                std::push_heap(heap_.begin(), heap_.end());
+            } else {
+                heap_.pop_back();
+            }
+        }
+        
+        return count;
+    }
+    
+    std::string name() const override {
+        if (cursors_.empty()) return "(no files)";
+        return cursors_.front().source->name() + " + " + std::to_string(cursors_.size() - 1) + " more";
+    }
+    
+    size_t source_count() const {
+        return cursors_.size();
+    }
+};
+
+inline std::unique_ptr<MarketDataSource> MarketDataSource::open(const std::string& filename) {
+    if (TickStoreReader::is_tick_store(filename)) {
+        auto source = std::make_unique<TickStoreSource>();
+        if (!source->open(filename)) return nullptr;
+        return source;
+    }
+    
+    auto source = std::make_unique<CsvFileSource>();
+    if (!source->open(filename)) return nullptr;
+    return source;
+}
+
+inline std::unique_ptr<MarketDataSource> MarketDataSource::open(const std::vector<std::string>& paths) {
+    namespace fs = std::filesystem;
+    
+    std::vector<std::string> files;
+    for (const std::string& path : paths) {
+        std::error_code error;
+        if (!fs::is_directory(path, error)) {
+            files.push_back(path);
+            continue;
+        }
+        
+        std::vector<std::string> listed;
+        for (const auto& entry : fs::directory_iterator(path, error)) {
+            std::string extension = entry.path().extension().string();
+            if (entry.is_regular_file(error) && (extension == ".csv" || extension == ".tick")) {
+                listed.push_back(entry.path().string());
+            }
+        }
+        if (listed.empty()) {
+            printf("[ERROR] No .csv or .tick files in: %s\n", path.c_str());
+            return nullptr;
+        }
+        std::sort(listed.begin(), listed.end());
+        files.insert(files.end(), listed.begin(), listed.end());
+    }
+    
+    if (files.empty()) return nullptr;
+    if (files.size() == 1) return open(files.front());
+    
+    std::vector<std::unique_ptr<MarketDataSource>> sources;
+    sources.reserve(files.size());
+    for (const std::string& file : files) {
+        auto source = open(file);
+        if (!source) return nullptr;
+        sources.push_back(std::move(source));
+    }
+    
+    return std::make_unique<MergedSource>(std::move(sources));
+}
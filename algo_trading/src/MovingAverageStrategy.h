@@ -2,9 +2,30 @@
 
 #include "TradingStrategy.h"
 #include "ml_client.h"
+#include "Indicators.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <chrono>
 #include <deque>
-#include <numeric>
+#include <future>
 #include <memory>
+#include <vector>
+
+// What to trade on when the model does not answer a bar.
+enum class FallbackSignal {
+    None,                // Skip the bar
+    MovingAverageCross,  // BUY while the short MA is above the long MA
+    LastPrediction       // Repeat the symbol's last model answer
+};
+
+inline const char* fallback_signal_name(FallbackSignal signal) {
+    switch (signal) {
+        case FallbackSignal::None: return "none";
+        case FallbackSignal::MovingAverageCross: return "ma";
+        case FallbackSignal::LastPrediction: return "last";
+    }
+    return "?";
+}
 
 class MovingAverageStrategy : public TradingStrategy {
 private:
@@ -12,107 +33,333 @@ private:
     int long_period_;
     double ml_threshold_;
     
-    std::deque<double> price_history_;
-    std::deque<double> volume_history_;
-    std::unique_ptr<MLClient> ml_client_;
+    std::vector<FeatureCalculator> states_;  // Indexed by SymbolId
+    std::shared_ptr<Predictor> predictor_;
+    
+    // A bar whose prediction has been requested but not acted on yet.
+    struct PendingDecision {
+        MarketDataEvent event;
+        double ma_short;
+        double ma_long;
+        std::future<MLPrediction> prediction;
+        std::vector<double> features;  // Kept to ask again after a resume
+    };
+    
+    // Decisions are applied in bar order within a lane: one lane per symbol
+    // when every symbol trades its own cash, otherwise a single lane so the
+    // shared cash sees the same order as a synchronous run.
+    size_t pipeline_depth_ = 1;  // Max predictions outstanding
+    size_t pending_count_ = 0;
+    std::vector<std::deque<PendingDecision>> lanes_;
     
-    double prev_close_;
-    bool initialized_;
+    struct KnownPrediction {
+        bool valid = false;
+        int prediction = 0;
+        double prob_sell = 0.0;
+        double prob_buy = 0.0;
+        double score = 0.0;
+    };
+    
+    FallbackSignal fallback_ = FallbackSignal::None;
+    std::vector<KnownPrediction> last_predictions_;  // Indexed by SymbolId
+    size_t fallbacks_used_ = 0;
+    
+    FeatureCalculator& state_for(SymbolId symbol) {
+        if (symbol >= states_.size()) {
+            states_.resize(symbol + 1, FeatureCalculator(short_period_, long_period_));
+        }
+        return states_[symbol];
+    }
     
 public:
     MovingAverageStrategy(std::shared_ptr<Portfolio> portfolio,
                           int short_period = 10,
                           int long_period = 50,
-                          double ml_threshold = 0.7)
+                          double ml_threshold = 0.7,
+                          std::shared_ptr<Predictor> predictor = nullptr)
         : TradingStrategy(portfolio, "MovingAverage"),
           short_period_(short_period),
           long_period_(long_period),
           ml_threshold_(ml_threshold),
-          prev_close_(0),
-          initialized_(false) {
+          predictor_(predictor) {
+        
+        // A predictor passed in is shared and already checked by the caller
+        if (predictor_) return;
         
-        ml_client_ = std::make_unique<MLClient>("127.0.0.1", 8000);
+        predictor_ = std::make_shared<MLClient>("127.0.0.1", 8000);
 
         
         // Check ML server health
-        if (!ml_client_->check_health()) {
+        if (!predictor_->check_health()) {
             printf("[WARNING] ML server not available. Strategy will not work!\n");
         }
     }
     
     void on_market_data(const MarketDataEvent& event) override {
-        // Add to history
-        price_history_.push_back(event.close);
-        volume_history_.push_back(static_cast<double>(event.volume));
+        // Features are updated incrementally per symbol
+        double values[FEATURE_COUNT];
+        {
+            METRICS_SCOPE(METRIC_FEATURES);
+            if (!state_for(event.symbol_id).update(event.close, static_cast<double>(event.volume), values)) {
+                return;
+            }
+        }
+        
+        // Prepare feature vector for ML model
+        std::vector<double> features(values, values + FEATURE_COUNT);
         
-        // Keep history size manageable
-        if (price_history_.size() > static_cast<size_t>(long_period_ + 10)) {
-            price_history_.pop_front();
-            volume_history_.pop_front();
+        // Call ML model
+        const std::string& symbol = event.symbol();
+        if (verbose_) {
+            printf("[ML] Calling prediction for %s...\n", symbol.c_str());
         }
         
-        // Need enough data for long MA
-        if (price_history_.size() < static_cast<size_t>(long_period_)) {
-            prev_close_ = event.close;
+        double ma_short = values[FEATURE_SHORT_MA];
+        double ma_long = values[FEATURE_LONG_MA];
+        
+        if (pipeline_depth_ <= 1) {
+            drain();  // Bars restored from a pipelined checkpoint go first
+            
+            MLPrediction prediction;
+            {
+                METRICS_SCOPE(METRIC_PREDICT);
+                prediction = predictor_->predict(symbol, event.timestamp, features);
+            }
+            METRICS_COUNT(METRIC_PREDICTIONS, 1);
+            decide(event, prediction, ma_short, ma_long);
             return;
         }
         
-        if (!initialized_) {
-            initialized_ = true;
-            prev_close_ = event.close;
-            return;
+        size_t lane = portfolio_->has_per_symbol_cash() ? event.symbol_id : 0;
+        if (lane >= lanes_.size()) {
+            lanes_.resize(lane + 1);
         }
+        lanes_[lane].push_back(PendingDecision{
+            event, ma_short, ma_long, predictor_->predict_future(symbol, event.timestamp, features),
+            std::move(features)});
+        ++pending_count_;
         
-        // Calculate features
-        double return_1 = (event.close - prev_close_) / prev_close_;
+        apply_ready(lane);
+        if (pending_count_ >= pipeline_depth_) {
+            for (size_t other = 0; other < lanes_.size(); ++other) {
+                apply_ready(other);
+            }
+        }
+        while (pending_count_ >= pipeline_depth_) {
+            apply_front(lane);  // Waits for the oldest bar of this lane
+        }
+    }
+    
+    // Drains every outstanding prediction.
+    void on_finish() override {
+        drain();
         
-        double short_ma = calculate_ma(short_period_);
-        double long_ma = calculate_ma(long_period_);
+        if (fallbacks_used_ > 0) {
+            printf("[INFO] %s: %zu bars traded on the %s fallback signal\n",
+                   name_.c_str(), fallbacks_used_, fallback_signal_name(fallback_));
+        }
+    }
+    
+    // Signal used for bars whose prediction failed (default: skip them).
+    void set_fallback(FallbackSignal fallback) {
+        fallback_ = fallback;
+    }
+    
+    // Lets up to depth predictions be outstanding at once (1 = wait for each
+    // answer before the next bar). Only useful with a predictor that answers
+    // asynchronously, such as AsyncMLClient.
+    void set_pipeline_depth(size_t depth) {
+        pipeline_depth_ = std::max<size_t>(1, depth);
+    }
+    
+    // Adds the periods, per-symbol features, remembered predictions and the
+    // bars still waiting for a prediction. Those are asked for again on load,
+    // so a deterministic model makes the same decisions.
+    void save_state(StateWriter& state) const override {
+        TradingStrategy::save_state(state);
+        state.put(short_period_);
+        state.put(long_period_);
+        state.put(ml_threshold_);
         
-        double volatility = calculate_volatility(20);
-        double volume_ratio = calculate_volume_ratio(20);
+        state.put<uint64_t>(states_.size());
+        for (const FeatureCalculator& calculator : states_) {
+            calculator.save_state(state);
+        }
+        state.put_vector(last_predictions_);
+        state.put<uint64_t>(fallbacks_used_);
         
-        double momentum = (event.close - price_history_[price_history_.size() - 5]) / 
-                         price_history_[price_history_.size() - 5];
+        state.put<uint64_t>(pending_count_);
+        for (const auto& lane : lanes_) {
+            for (const PendingDecision& pending : lane) {
+                state.put(pending.event);
+                state.put(pending.ma_short);
+                state.put(pending.ma_long);
+                state.put_vector(pending.features);
+            }
+        }
+    }
+    
+    bool load_state(StateReader& state) override {
+        if (!TradingStrategy::load_state(state) ||
+            !state.expect(short_period_, "short MA period") ||
+            !state.expect(long_period_, "long MA period") ||
+            !state.expect(ml_threshold_, "ML threshold")) {
+            return false;
+        }
         
-        double return_5 = (event.close - price_history_[price_history_.size() - 5]) / 
-                         price_history_[price_history_.size() - 5];
+        uint64_t count = 0;
+        if (!state.get(count)) return false;
+        for (uint64_t id = 0; id < count; ++id) {
+            SymbolId symbol = state.symbol(static_cast<SymbolId>(id));
+            if (symbol == SymbolTable::INVALID_ID) return state.fail("missing a symbol");
+            if (!state_for(symbol).load_state(state)) return false;
+        }
         
-        // Prepare feature vector for ML model
-        std::vector<double> features = {
-            return_1,
-            return_5,
-            short_ma,
-            long_ma,
-            volatility,
-            volume_ratio,
-            event.close,
-            momentum
-        };
+        std::vector<KnownPrediction> last;
+        uint64_t fallbacks_used = 0;
+        if (!state.get_vector(last) || !state.get(fallbacks_used)) return false;
+        last_predictions_.clear();
+        for (size_t id = 0; id < last.size(); ++id) {
+            SymbolId symbol = state.symbol(static_cast<SymbolId>(id));
+            if (symbol == SymbolTable::INVALID_ID) return state.fail("missing a symbol");
+            if (symbol >= last_predictions_.size()) last_predictions_.resize(symbol + 1);
+            last_predictions_[symbol] = last[id];
+        }
+        fallbacks_used_ = static_cast<size_t>(fallbacks_used);
         
-        // Call ML model
-        printf("[ML] Calling prediction for %s...\n", event.symbol.c_str());
-        MLPrediction ml_pred = ml_client_->predict(event.symbol, event.timestamp, features);
+        // Lanes were saved in lane order, so bars of one lane stay in order
+        if (!state.get(count)) return false;
+        for (uint64_t i = 0; i < count; ++i) {
+            PendingDecision pending;
+            if (!state.get(pending.event) || !state.get(pending.ma_short) ||
+                !state.get(pending.ma_long) || !state.get_vector(pending.features)) {
+                return false;
+            }
+            pending.event.symbol_id = state.symbol(pending.event.symbol_id);
+            if (pending.event.symbol_id == SymbolTable::INVALID_ID) return state.fail("missing a symbol");
+            pending.prediction = predictor_->predict_future(pending.event.symbol(),
+                                                            pending.event.timestamp, pending.features);
+            
+            size_t lane = portfolio_->has_per_symbol_cash() ? pending.event.symbol_id : 0;
+            if (lane >= lanes_.size()) lanes_.resize(lane + 1);
+            lanes_[lane].push_back(std::move(pending));
+            ++pending_count_;
+        }
+        return true;
+    }
+    
+private:
+    void drain() {
+        for (size_t lane = 0; lane < lanes_.size() && pending_count_ > 0; ++lane) {
+            while (!lanes_[lane].empty()) {
+                apply_front(lane);
+            }
+        }
+    }
+    
+    void apply_front(size_t lane) {
+        PendingDecision pending = std::move(lanes_[lane].front());
+        lanes_[lane].pop_front();
+        --pending_count_;
         
-        if (!ml_pred.success) {
-            printf("[ML] Prediction failed: %s\n", ml_pred.error_message.c_str());
-            prev_close_ = event.close;
-            return;
+        MLPrediction prediction;
+        {
+            METRICS_SCOPE(METRIC_PREDICT);  // Only the part not hidden by the pipeline
+            prediction = pending.prediction.get();
+        }
+        METRICS_COUNT(METRIC_PREDICTIONS, 1);
+        decide(pending.event, prediction, pending.ma_short, pending.ma_long);
+    }
+    
+    // Applies the lane's leading decisions whose predictions have arrived.
+    void apply_ready(size_t lane) {
+        auto& queue = lanes_[lane];
+        while (!queue.empty() &&
+               queue.front().prediction.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            apply_front(lane);
+        }
+    }
+    
+    // Builds the fallback signal for a bar without a prediction. Returns
+    // false if there is none.
+    bool fallback_for(SymbolId symbol, double ma_short, double ma_long, MLPrediction& out) const {
+        switch (fallback_) {
+            case FallbackSignal::MovingAverageCross: {
+                out.prediction = ma_short > ma_long ? 1 : 0;
+                out.probabilities = {1.0 - out.prediction, static_cast<double>(out.prediction)};
+                out.score = 1.0;
+                out.model_version = "fallback:ma";
+                break;
+            }
+            case FallbackSignal::LastPrediction: {
+                if (symbol >= last_predictions_.size() || !last_predictions_[symbol].valid) {
+                    return false;
+                }
+                const KnownPrediction& last = last_predictions_[symbol];
+                out.prediction = last.prediction;
+                out.probabilities = {last.prob_sell, last.prob_buy};
+                out.score = last.score;
+                out.model_version = "fallback:last";
+                break;
+            }
+            case FallbackSignal::None:
+                return false;
+        }
+        out.success = true;
+        return true;
+    }
+    
+    void remember(SymbolId symbol, const MLPrediction& prediction) {
+        if (symbol >= last_predictions_.size()) {
+            last_predictions_.resize(symbol + 1);
+        }
+        KnownPrediction& last = last_predictions_[symbol];
+        last.valid = true;
+        last.prediction = prediction.prediction;
+        last.prob_sell = prediction.probabilities[0];
+        last.prob_buy = prediction.probabilities[1];
+        last.score = prediction.score;
+    }
+    
+    void decide(const MarketDataEvent& event, const MLPrediction& prediction,
+                double ma_short, double ma_long) {
+        MLPrediction fallback;
+        const MLPrediction* signal = &prediction;
+        
+        if (!prediction.success) {
+            if (!fallback_for(event.symbol_id, ma_short, ma_long, fallback)) {
+                if (fallback_ == FallbackSignal::None) {
+                    printf("[ML] Prediction failed: %s\n", prediction.error_message.c_str());
+                }
+                return;
+            }
+            if (verbose_) {
+                printf("[ML] Prediction failed (%s), using %s fallback\n",
+                       prediction.error_message.c_str(), fallback_signal_name(fallback_));
+            }
+            ++fallbacks_used_;
+            signal = &fallback;
+        } else if (fallback_ == FallbackSignal::LastPrediction) {
+            remember(event.symbol_id, prediction);
         }
         
-        printf("[ML] Prediction: %d, Score: %.4f, Prob[BUY]: %.4f\n",
-               ml_pred.prediction, ml_pred.score, ml_pred.probabilities[1]);
+        const MLPrediction& ml_pred = *signal;
+        
+        if (verbose_) {
+            printf("[ML] Prediction: %d, Score: %.4f, Prob[BUY]: %.4f\n",
+                   ml_pred.prediction, ml_pred.score, ml_pred.probabilities[1]);
+        }
         
         // Trading logic: Use ML prediction + confidence threshold
-        int position = portfolio_->get_position(event.symbol);
+        int position = portfolio_->get_position(event.symbol_id);
         
         // BUY signal: ML predicts BUY with high confidence
         if (ml_pred.prediction == 1 && ml_pred.score >= ml_threshold_ && position == 0) {
             int quantity = 10;  // Fixed quantity for simplicity
             
-            if (portfolio_->can_buy(event.symbol, quantity, event.close)) {
+            if (portfolio_->can_buy(event.symbol_id, quantity, event.close)) {
                 portfolio_->execute_trade(
-                    event.timestamp, name_, event.symbol, "BUY",
+                    event.timestamp, name_, event.symbol_id, Side::Buy,
                     quantity, event.close,
                     ml_pred.prediction, ml_pred.score, ml_pred.probabilities[1],
                     ml_pred.model_version
@@ -123,62 +370,14 @@ public:
         else if (ml_pred.prediction == 0 && ml_pred.score >= ml_threshold_ && position > 0) {
             int quantity = position;  // Sell all
             
-            if (portfolio_->can_sell(event.symbol, quantity)) {
+            if (portfolio_->can_sell(event.symbol_id, quantity)) {
                 portfolio_->execute_trade(
-                    event.timestamp, name_, event.symbol, "SELL",
+                    event.timestamp, name_, event.symbol_id, Side::Sell,
                     quantity, event.close,
                     ml_pred.prediction, ml_pred.score, ml_pred.probabilities[1],
                     ml_pred.model_version
                 );
             }
         }
-        
-        prev_close_ = event.close;
-    }
-    
-private:
-    double calculate_ma(int period) {
-        if (price_history_.size() < static_cast<size_t>(period)) {
-            return 0.0;
-        }
-        
-        auto start = price_history_.end() - period;
-        auto end = price_history_.end();
-        
-        double sum = std::accumulate(start, end, 0.0);
-        return sum / period;
-    }
-    
-    double calculate_volatility(int period) {
-        if (price_history_.size() < static_cast<size_t>(period)) {
-            return 0.0;
-        }
-        
-        auto start = price_history_.end() - period;
-        auto end = price_history_.end();
-        
-        double mean = std::accumulate(start, end, 0.0) / period;
-        
-        double sq_sum = 0.0;
-        for (auto it = start; it != end; ++it) {
-            sq_sum += (*it - mean) * (*it - mean);
-        }
-        
-        return std::sqrt(sq_sum / period);
-    }
-    
-    double calculate_volume_ratio(int period) {
-        if (volume_history_.size() < static_cast<size_t>(period + 1)) {
-            return 1.0;
-        }
-        
-        double current_volume = volume_history_.back();
-        
-        auto start = volume_history_.end() - period - 1;
-        auto end = volume_history_.end() - 1;
-        
-        double avg_volume = std::accumulate(start, end, 0.0) / period;
-        
-        return (avg_volume > 0) ? (current_volume / avg_volume) : 1.0;
     }
 };
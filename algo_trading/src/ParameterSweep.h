@@ -0,0 +1,257 @@
+#pragma once
+
+#include "MarketDataEvent.h"
+#include "MarketDataSource.h"
+#include "MovingAverageStrategy.h"
+#include "Portfolio.h"
+#include "PerformanceAnalytics.h"
+#include "ThreadPool.h"
+#include "TradeLogger.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SweepConfig {
+    int short_period;
+    int long_period;
+    double ml_threshold;
+};
+
+struct SweepResult {
+    SweepConfig config;
+    size_t trades = 0;
+    double final_value = 0.0;
+    double pnl = 0.0;
+    double pnl_pct = 0.0;
+    double wall_ms = 0.0;
+    double max_drawdown_pct = 0.0;
+    double sharpe = 0.0;
+    double sortino = 0.0;
+    double time_in_market_pct = 0.0;
+    double turnover = 0.0;
+};
+
+// Runs MovingAverageStrategy once per configuration over the same events.
+//
+// The events are loaded once and only read afterwards, so every run walks
+// the same buffer without copying or locking it. Runs are independent tasks on
+// a ThreadPool; each gets its own Portfolio and TradeLogger and calls the
+// strategy directly instead of going through a BacktestingEngine thread.
+class ParameterSweep {
+private:
+    std::vector<MarketDataEvent> events_;
+    std::map<SymbolId, double> final_prices_;
+    double initial_cash_;
+    std::string ml_host_;
+    int ml_port_;
+    std::shared_ptr<Predictor> predictor_;  // Shared by all runs if set
+    
+    // Owned by the sweep, so another sweep never reuses a connection to a
+    // different server
+    mutable std::mutex clients_mutex_;
+    mutable std::map<std::thread::id, std::shared_ptr<MLClient>> clients_;
+    
+    // One ML connection per worker thread, reused across its runs
+    std::shared_ptr<Predictor> thread_predictor() const {
+        if (predictor_) return predictor_;
+        
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        std::shared_ptr<MLClient>& client = clients_[std::this_thread::get_id()];
+        if (!client) {
+            client = std::make_shared<MLClient>(ml_host_, ml_port_);
+        }
+        return client;
+    }
+    
+    static std::vector<double> parse_list(const std::string& text) {
+        std::vector<double> values;
+        std::stringstream stream(text);
+        std::string item;
+        
+        while (std::getline(stream, item, ',')) {
+            if (!item.empty()) {
+                values.push_back(std::stod(item));
+            }
+        }
+        return values;
+    }
+    
+public:
+    explicit ParameterSweep(double initial_cash,
+                            const std::string& ml_host = "127.0.0.1", int ml_port = 8000)
+        : initial_cash_(initial_cash), ml_host_(ml_host), ml_port_(ml_port) {}
+    
+    // Uses predictor (which must be safe to call from several threads, such
+    // as RandomForest) instead of one MLClient per worker thread.
+    void set_predictor(std::shared_ptr<Predictor> predictor) {
+        predictor_ = predictor;
+    }
+    
+    // Reads the whole source into the shared buffer (max_events 0 = all).
+    bool load(MarketDataSource& source, size_t max_events = 0) {
+        const size_t chunk = 65536;
+        
+        while (true) {
+            size_t want = chunk;
+            if (max_events > 0) {
+                want = std::min(want, max_events - events_.size());
+            }
+            if (want == 0 || source.read(events_, want) == 0) break;
+        }
+        
+        for (const auto& event : events_) {
+            final_prices_[event.symbol_id] = event.close;
+        }
+        
+        printf("[INFO] Loaded %zu events from: %s\n", events_.size(), source.name().c_str());
+        return !events_.empty();
+    }
+    
+    SweepResult run_one(const SweepConfig& config) const {
+        auto start = std::chrono::steady_clock::now();
+        
+        auto logger = std::make_shared<TradeLogger>();
+        auto portfolio = std::make_shared<Portfolio>(initial_cash_, logger);
+        portfolio->set_verbose(false);
+        
+        MovingAverageStrategy strategy(portfolio, config.short_period, config.long_period,
+                                       config.ml_threshold, thread_predictor());
+        strategy.set_verbose(false);
+        
+        // Sweeps only keep the summary, so the curve buffer stays tiny
+        PerformanceAnalytics analytics(portfolio, 16);
+        
+        for (const auto& event : events_) {
+            analytics.on_event(event);
+            strategy.on_event(event);
+        }
+        strategy.on_finish();
+        analytics.finish();
+        
+        SweepResult result;
+        result.config = config;
+        result.trades = logger->count();
+        result.final_value = portfolio->get_total_value(final_prices_);
+        result.pnl = result.final_value - portfolio->get_capital();
+        result.pnl_pct = (result.pnl / portfolio->get_capital()) * 100.0;
+        
+        PerformanceSummary performance = analytics.summary();
+        result.max_drawdown_pct = performance.max_drawdown_pct;
+        result.sharpe = performance.sharpe;
+        result.sortino = performance.sortino;
+        result.time_in_market_pct = performance.time_in_market_pct;
+        result.turnover = performance.turnover;
+        result.wall_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+    
+    // Results come back in the order of configs.
+    std::vector<SweepResult> run(const std::vector<SweepConfig>& configs, size_t threads = 0) const {
+        std::vector<SweepResult> results(configs.size());
+        
+        bool healthy = predictor_ ? predictor_->check_health()
+                                  : MLClient(ml_host_, ml_port_).check_health();
+        if (!healthy) {
+            printf("[WARNING] ML server not available. Strategy will not work!\n");
+        }
+        
+        ThreadPool pool(threads);
+        printf("[INFO] Running %zu configurations on %zu threads\n",
+               configs.size(), pool.thread_count());
+        
+        for (size_t i = 0; i < configs.size(); ++i) {
+            pool.submit([this, &configs, &results, i]() {
+                results[i] = run_one(configs[i]);
+            });
+        }
+        pool.wait_idle();
+        
+        return results;
+    }
+    
+    // Cartesian product of comma-separated lists, e.g. "5,10", "30,50",
+    // "0.6,0.7". Combinations with short >= long are skipped.
+    static std::vector<SweepConfig> grid(const std::string& shorts, const std::string& longs,
+                                         const std::string& thresholds) {
+        std::vector<SweepConfig> configs;
+        
+        for (double s : parse_list(shorts)) {
+            for (double l : parse_list(longs)) {
+                if (s >= l) continue;
+                for (double t : parse_list(thresholds)) {
+                    configs.push_back({static_cast<int>(s), static_cast<int>(l), t});
+                }
+            }
+        }
+        return configs;
+    }
+    
+    // One configuration per line: short_period,long_period,ml_threshold.
+    // Blank lines and lines starting with '#' or a letter (a header) are ignored.
+    static std::vector<SweepConfig> load_list(const std::string& filename) {
+        std::vector<SweepConfig> configs;
+        std::ifstream file(filename);
+        
+        if (!file.is_open()) {
+            printf("[ERROR] Could not open file: %s\n", filename.c_str());
+            return configs;
+        }
+        
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#' || std::isalpha(static_cast<unsigned char>(line[0]))) {
+                continue;
+            }
+            
+            std::vector<double> values = parse_list(line);
+            if (values.size() != 3 || values[0] >= values[1]) {
+                printf("[WARNING] Skipping invalid line: %s\n", line.c_str());
+                continue;
+            }
+            configs.push_back({static_cast<int>(values[0]), static_cast<int>(values[1]), values[2]});
+        }
+        return configs;
+    }
+    
+    static bool save_results(const std::vector<SweepResult>& results, const std::string& filename) {
+        std::ofstream file(filename);
+        
+        if (!file.is_open()) {
+            printf("[ERROR] Could not open file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        file << "short_period,long_period,ml_threshold,trades,final_value,pnl,pnl_pct,wall_ms,"
+                "max_drawdown_pct,sharpe,sortino,time_in_market_pct,turnover\n";
+        
+        for (const auto& result : results) {
+            file << result.config.short_period << ","
+                 << result.config.long_period << ","
+                 << result.config.ml_threshold << ","
+                 << result.trades << ","
+                 << result.final_value << ","
+                 << result.pnl << ","
+                 << result.pnl_pct << ","
+                 << result.wall_ms << ","
+                 << result.max_drawdown_pct << ","
+                 << result.sharpe << ","
+                 << result.sortino << ","
+                 << result.time_in_market_pct << ","
+                 << result.turnover << "\n";
+        }
+        
+        file.close();
+        printf("[INFO] Saved %zu results to: %s\n", results.size(), filename.c_str());
+        return true;
+    }
+};
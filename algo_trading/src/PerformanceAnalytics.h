@@ -0,0 +1,319 @@
+#pragma once
+
+#include "MarketDataEvent.h"
+#include "Portfolio.h"
+#include "Indicators.h"
+#include "CheckpointState.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct PerformanceSummary {
+    size_t periods = 0;
+    double start_equity = 0.0;
+    double end_equity = 0.0;
+    double total_return_pct = 0.0;
+    double annual_return_pct = 0.0;
+    double annual_volatility_pct = 0.0;
+    double max_rolling_volatility_pct = 0.0;  // Annualized, over the rolling window
+    double sharpe = 0.0;                      // Annualized, zero risk-free rate
+    double sortino = 0.0;
+    double max_drawdown = 0.0;
+    double max_drawdown_pct = 0.0;
+    std::time_t max_drawdown_peak = 0;
+    std::time_t max_drawdown_trough = 0;
+    double time_in_market_pct = 0.0;          // Periods ending with a position open
+    double avg_exposure_pct = 0.0;            // Mean market value / equity
+    double turnover = 0.0;                    // Traded notional / mean equity
+    double periods_per_year = 0.0;
+};
+
+// Online performance statistics for one Portfolio.
+//
+// Call on_event() for every event before the strategy sees it, and finish()
+// after the last one. A period is one distinct timestamp: when the timestamp
+// moves on, the period that just ended is closed at the portfolio's current
+// equity (O(1), see Portfolio::mark). Closing a period updates the running
+// peak and drawdown, Welford mean/variance of period returns, the downside
+// deviation, the rolling volatility window, exposure and the equity curve.
+//
+// The curve keeps at most `curve_points` samples: when it fills, every other
+// sample is dropped and the sampling stride doubles, so memory is fixed for
+// any run length. Drawdown and the ratios are computed on every period, not
+// on the samples.
+class PerformanceAnalytics {
+public:
+    struct CurvePoint {
+        std::time_t timestamp;
+        double equity;
+        double drawdown_pct;
+    };
+    
+private:
+    std::shared_ptr<const Portfolio> portfolio_;
+    size_t curve_points_;
+    
+    bool started_ = false;
+    std::time_t period_ts_ = 0;
+    std::time_t first_ts_ = 0;
+    
+    double start_equity_ = 0.0;
+    double prev_equity_ = 0.0;
+    double peak_equity_ = 0.0;
+    std::time_t peak_ts_ = 0;
+    
+    size_t periods_ = 0;
+    size_t returns_ = 0;
+    double mean_return_ = 0.0;
+    double m2_return_ = 0.0;
+    double downside_sq_ = 0.0;
+    RollingVariance rolling_;
+    double max_rolling_stddev_ = 0.0;
+    
+    double max_drawdown_ = 0.0;
+    double max_drawdown_pct_ = 0.0;
+    std::time_t max_drawdown_peak_ = 0;
+    std::time_t max_drawdown_trough_ = 0;
+    
+    size_t periods_in_market_ = 0;
+    double exposure_sum_ = 0.0;
+    double equity_sum_ = 0.0;
+    
+    std::vector<CurvePoint> curve_;
+    size_t stride_ = 1;
+    CurvePoint last_point_{0, 0.0, 0.0};
+    
+    void close_period() {
+        double equity = portfolio_->get_equity();
+        ++periods_;
+        
+        if (periods_ == 1) {
+            start_equity_ = equity;
+            peak_equity_ = equity;
+            peak_ts_ = period_ts_;
+        } else if (prev_equity_ != 0.0) {
+            double r = equity / prev_equity_ - 1.0;
+            ++returns_;
+            double delta = r - mean_return_;
+            mean_return_ += delta / static_cast<double>(returns_);
+            m2_return_ += delta * (r - mean_return_);
+            if (r < 0.0) downside_sq_ += r * r;
+            
+            rolling_.push(r);
+            if (rolling_.ready()) {
+                max_rolling_stddev_ = std::max(max_rolling_stddev_, rolling_.stddev());
+            }
+        }
+        prev_equity_ = equity;
+        
+        if (equity > peak_equity_) {
+            peak_equity_ = equity;
+            peak_ts_ = period_ts_;
+        }
+        double drawdown = peak_equity_ - equity;
+        double drawdown_pct = peak_equity_ > 0.0 ? drawdown / peak_equity_ * 100.0 : 0.0;
+        if (drawdown_pct > max_drawdown_pct_) {
+            max_drawdown_ = drawdown;
+            max_drawdown_pct_ = drawdown_pct;
+            max_drawdown_peak_ = peak_ts_;
+            max_drawdown_trough_ = period_ts_;
+        }
+        
+        if (portfolio_->open_positions() > 0) ++periods_in_market_;
+        if (equity != 0.0) {
+            exposure_sum_ += std::fabs(portfolio_->get_market_value()) / equity;
+        }
+        equity_sum_ += equity;
+        
+        last_point_ = CurvePoint{period_ts_, equity, drawdown_pct};
+        if ((periods_ - 1) % stride_ == 0) {
+            if (curve_.size() == curve_points_) {
+                // Keep every other sample and sample half as often
+                size_t kept = 0;
+                for (size_t i = 0; i < curve_.size(); i += 2) {
+                    curve_[kept++] = curve_[i];
+                }
+                curve_.resize(kept);
+                stride_ *= 2;
+            }
+            if ((periods_ - 1) % stride_ == 0) {
+                curve_.push_back(last_point_);
+            }
+        }
+    }
+    
+public:
+    // rolling_window is in periods (20 daily bars is about a month).
+    explicit PerformanceAnalytics(std::shared_ptr<const Portfolio> portfolio,
+                                  size_t curve_points = 2048, size_t rolling_window = 20)
+        : portfolio_(portfolio), curve_points_(std::max<size_t>(2, curve_points & ~size_t(1))),
+          rolling_(rolling_window) {
+        curve_.reserve(curve_points_);
+    }
+    
+    void on_event(const MarketDataEvent& event) {
+        if (!started_) {
+            started_ = true;
+            first_ts_ = event.timestamp;
+            period_ts_ = event.timestamp;
+            return;
+        }
+        if (event.timestamp != period_ts_) {
+            close_period();
+            period_ts_ = event.timestamp;
+        }
+    }
+    
+    // Closes the last period. Call once after the strategy's on_finish().
+    void finish() {
+        if (started_) {
+            close_period();
+            started_ = false;
+        }
+    }
+    
+    void save_state(StateWriter& state) const {
+        state.put<uint64_t>(curve_points_);
+        state.put(started_);
+        state.put(period_ts_);
+        state.put(first_ts_);
+        state.put(start_equity_);
+        state.put(prev_equity_);
+        state.put(peak_equity_);
+        state.put(peak_ts_);
+        state.put<uint64_t>(periods_);
+        state.put<uint64_t>(returns_);
+        state.put(mean_return_);
+        state.put(m2_return_);
+        state.put(downside_sq_);
+        rolling_.save_state(state);
+        state.put(max_rolling_stddev_);
+        state.put(max_drawdown_);
+        state.put(max_drawdown_pct_);
+        state.put(max_drawdown_peak_);
+        state.put(max_drawdown_trough_);
+        state.put<uint64_t>(periods_in_market_);
+        state.put(exposure_sum_);
+        state.put(equity_sum_);
+        state.put_vector(curve_);
+        state.put<uint64_t>(stride_);
+        state.put(last_point_);
+    }
+    
+    bool load_state(StateReader& state) {
+        uint64_t periods = 0, returns = 0, periods_in_market = 0, stride = 0;
+        if (!state.expect<uint64_t>(curve_points_, "equity curve size") ||
+            !state.get(started_) || !state.get(period_ts_) || !state.get(first_ts_) ||
+            !state.get(start_equity_) || !state.get(prev_equity_) || !state.get(peak_equity_) ||
+            !state.get(peak_ts_) || !state.get(periods) || !state.get(returns) ||
+            !state.get(mean_return_) || !state.get(m2_return_) || !state.get(downside_sq_) ||
+            !rolling_.load_state(state) || !state.get(max_rolling_stddev_) ||
+            !state.get(max_drawdown_) || !state.get(max_drawdown_pct_) ||
+            !state.get(max_drawdown_peak_) || !state.get(max_drawdown_trough_) ||
+            !state.get(periods_in_market) || !state.get(exposure_sum_) || !state.get(equity_sum_) ||
+            !state.get_vector(curve_) || !state.get(stride) || !state.get(last_point_)) {
+            return false;
+        }
+        periods_ = static_cast<size_t>(periods);
+        returns_ = static_cast<size_t>(returns);
+        periods_in_market_ = static_cast<size_t>(periods_in_market);
+        stride_ = static_cast<size_t>(stride);
+        curve_.reserve(curve_points_);
+        return true;
+    }
+    
+    PerformanceSummary summary() const {
+        PerformanceSummary s;
+        s.periods = periods_;
+        s.start_equity = start_equity_;
+        s.end_equity = prev_equity_;
+        s.max_drawdown = max_drawdown_;
+        s.max_drawdown_pct = max_drawdown_pct_;
+        s.max_drawdown_peak = max_drawdown_peak_;
+        s.max_drawdown_trough = max_drawdown_trough_;
+        if (periods_ == 0) return s;
+        
+        s.total_return_pct = start_equity_ != 0.0 ? (prev_equity_ / start_equity_ - 1.0) * 100.0 : 0.0;
+        s.time_in_market_pct = periods_in_market_ * 100.0 / static_cast<double>(periods_);
+        s.avg_exposure_pct = exposure_sum_ * 100.0 / static_cast<double>(periods_);
+        
+        double mean_equity = equity_sum_ / static_cast<double>(periods_);
+        if (mean_equity > 0.0) {
+            s.turnover = portfolio_->get_traded_notional() / mean_equity;
+        }
+        
+        // Periods per year from the average spacing of the timestamps, so
+        // daily bars with weekends come out near 252
+        double years = static_cast<double>(period_ts_ - first_ts_) / (365.25 * 86400.0);
+        s.periods_per_year = years > 0.0 ? static_cast<double>(periods_ - 1) / years : 0.0;
+        if (years > 0.0 && start_equity_ > 0.0 && prev_equity_ > 0.0) {
+            s.annual_return_pct = (std::pow(prev_equity_ / start_equity_, 1.0 / years) - 1.0) * 100.0;
+        }
+        
+        if (returns_ > 1) {
+            double annualize = std::sqrt(s.periods_per_year);
+            double stddev = std::sqrt(m2_return_ / static_cast<double>(returns_));
+            double downside = std::sqrt(downside_sq_ / static_cast<double>(returns_));
+            s.annual_volatility_pct = stddev * annualize * 100.0;
+            s.max_rolling_volatility_pct = max_rolling_stddev_ * annualize * 100.0;
+            s.sharpe = stddev > 0.0 ? mean_return_ / stddev * annualize : 0.0;
+            s.sortino = downside > 0.0 ? mean_return_ / downside * annualize : 0.0;
+        }
+        return s;
+    }
+    
+    // Downsampled curve, always ending with the last period.
+    std::vector<CurvePoint> equity_curve() const {
+        std::vector<CurvePoint> curve = curve_;
+        if (periods_ > 0 && (curve.empty() || curve.back().timestamp != last_point_.timestamp)) {
+            curve.push_back(last_point_);
+        }
+        return curve;
+    }
+    
+    // Writes equity_curve() as timestamp,equity,drawdown_pct.
+    bool save_equity_curve(const std::string& filename) const {
+        FILE* file = fopen(filename.c_str(), "wb");
+        if (file == nullptr) {
+            printf("[ERROR] Could not open file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        std::vector<CurvePoint> curve = equity_curve();
+        fputs("timestamp,equity,drawdown_pct\n", file);
+        for (const CurvePoint& point : curve) {
+            fprintf(file, "%lld,%.2f,%.4f\n", static_cast<long long>(point.timestamp),
+                    point.equity, point.drawdown_pct);
+        }
+        
+        if (fclose(file) != 0) {
+            printf("[ERROR] Could not write file: %s\n", filename.c_str());
+            return false;
+        }
+        printf("[INFO] Saved %zu equity points (%zu periods) to: %s\n",
+               curve.size(), periods_, filename.c_str());
+        return true;
+    }
+    
+    void print_report() const {
+        PerformanceSummary s = summary();
+        if (s.periods == 0) return;
+        
+        printf("\n=== PERFORMANCE ===\n");
+        printf("Periods: %zu (%.0f per year)\n", s.periods, s.periods_per_year);
+        printf("Total Return: %.2f%% (annualized %.2f%%)\n", s.total_return_pct, s.annual_return_pct);
+        printf("Volatility: %.2f%% annualized (max rolling %.2f%%)\n",
+               s.annual_volatility_pct, s.max_rolling_volatility_pct);
+        printf("Sharpe: %.2f  Sortino: %.2f\n", s.sharpe, s.sortino);
+        printf("Max Drawdown: $%.2f (%.2f%%), peak %lld -> trough %lld\n",
+               s.max_drawdown, s.max_drawdown_pct,
+               static_cast<long long>(s.max_drawdown_peak), static_cast<long long>(s.max_drawdown_trough));
+        printf("Time in Market: %.1f%%  Avg Exposure: %.1f%%  Turnover: %.2fx\n",
+               s.time_in_market_pct, s.avg_exposure_pct, s.turnover);
+        printf("===================\n");
+    }
+};
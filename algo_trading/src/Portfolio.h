@@ -2,112 +2,332 @@
 
 #include "Trade.h"
 #include "TradeLogger.h"
+#include "SymbolTable.h"
+#include "Indicators.h"
+#include "CheckpointState.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cstdlib>
 #include <string>
 #include <map>
 #include <memory>
+#include <utility>
+#include <vector>
 
+// By default all symbols draw on one cash balance. With per-symbol cash each
+// symbol trades against its own sleeve of initial_cash, opened on its first
+// trade, so results for a symbol do not depend on what other symbols did.
+//
+// Positions live in a flat book indexed by SymbolId. mark() moves a symbol's
+// price and adjusts the portfolio's market value by the change, so equity and
+// unrealized P&L are O(1) to read however many symbols are held. The running
+// sums are compensated so they match a fresh revaluation over long runs.
 class Portfolio {
+public:
+    struct Position {
+        int quantity = 0;
+        double avg_cost = 0.0;      // Average entry price of the open quantity
+        double last_price = 0.0;    // Latest mark (0 = never marked)
+        double realized_pnl = 0.0;
+        double sleeve_cash = 0.0;   // Per-symbol cash only
+        bool has_sleeve = false;
+    };
+    
 private:
     double initial_cash_;
+    double capital_;
     double cash_;
-    std::map<std::string, int> positions_;
+    bool per_symbol_cash_;
+    bool verbose_ = true;
+    std::vector<Position> book_;     // Indexed by SymbolId
+    size_t open_positions_ = 0;
+    CompensatedSum market_value_;    // Sum of quantity * last_price
+    CompensatedSum cost_basis_;      // Sum of quantity * avg_cost
+    CompensatedSum realized_pnl_;
+    double traded_notional_ = 0.0;   // Sum of quantity * price over all fills
     std::shared_ptr<TradeLogger> logger_;
     
+    Position& entry(SymbolId symbol) {
+        if (symbol >= book_.size()) {
+            book_.resize(static_cast<size_t>(symbol) + 1);
+        }
+        return book_[symbol];
+    }
+    
+    const Position* find(SymbolId symbol) const {
+        return symbol < book_.size() ? &book_[symbol] : nullptr;
+    }
+    
+    double& cash_for(Position& position) {
+        if (!per_symbol_cash_) return cash_;
+        
+        if (!position.has_sleeve) {
+            position.has_sleeve = true;
+            position.sleeve_cash = initial_cash_;
+            capital_ += initial_cash_;
+            cash_ += initial_cash_;
+        }
+        return position.sleeve_cash;
+    }
+    
+    // Updates quantity, average cost and realized P&L for a fill of
+    // signed_quantity shares (negative = sold) at price.
+    void apply_fill(Position& position, int signed_quantity, double price) {
+        int old_quantity = position.quantity;
+        double old_cost = old_quantity * position.avg_cost;
+        int new_quantity = old_quantity + signed_quantity;
+        
+        if (old_quantity == 0 || (old_quantity > 0) == (signed_quantity > 0)) {
+            // Opening or adding
+            position.avg_cost = (old_cost + signed_quantity * price) / new_quantity;
+        } else {
+            // Reducing, closing or flipping: the closed part realizes P&L
+            int closed = std::min(std::abs(signed_quantity), std::abs(old_quantity));
+            double pnl = (price - position.avg_cost) * (old_quantity > 0 ? closed : -closed);
+            position.realized_pnl += pnl;
+            realized_pnl_.add(pnl);
+            
+            if (new_quantity == 0) {
+                position.avg_cost = 0.0;
+            } else if ((new_quantity > 0) != (old_quantity > 0)) {
+                position.avg_cost = price;  // Flipped: the remainder opened here
+            }
+        }
+        
+        position.quantity = new_quantity;
+        cost_basis_.add(new_quantity * position.avg_cost - old_cost);
+        market_value_.add(signed_quantity * position.last_price);
+        
+        if (old_quantity == 0 && new_quantity != 0) ++open_positions_;
+        if (old_quantity != 0 && new_quantity == 0) --open_positions_;
+    }
+    
 public:
-    Portfolio(double initial_cash, std::shared_ptr<TradeLogger> logger)
-        : initial_cash_(initial_cash), cash_(initial_cash), logger_(logger) {}
+    Portfolio(double initial_cash, std::shared_ptr<TradeLogger> logger,
+              bool per_symbol_cash = false)
+        : initial_cash_(initial_cash),
+          capital_(per_symbol_cash ? 0.0 : initial_cash),
+          cash_(per_symbol_cash ? 0.0 : initial_cash),
+          per_symbol_cash_(per_symbol_cash), logger_(logger) {}
+    
+    // Moves symbol's price; held shares change the market value by the
+    // difference.
+    void mark(SymbolId symbol, double price) {
+        Position& position = entry(symbol);
+        if (position.quantity != 0) {
+            market_value_.add(position.quantity * (price - position.last_price));
+        }
+        position.last_price = price;
+    }
     
-    bool can_buy(const std::string& symbol, int quantity, double price) const {
+    bool can_buy(SymbolId symbol, int quantity, double price) const {
         double cost = quantity * price;
-        return cash_ >= cost;
+        return get_cash(symbol) >= cost;
     }
     
-    bool can_sell(const std::string& symbol, int quantity) const {
-        auto it = positions_.find(symbol);
-        if (it == positions_.end()) return false;
-        return it->second >= quantity;
+    bool can_sell(SymbolId symbol, int quantity) const {
+        const Position* position = find(symbol);
+        return position != nullptr && position->quantity != 0 && position->quantity >= quantity;
     }
     
     void execute_trade(std::time_t timestamp, const std::string& strategy,
-                       const std::string& symbol, const std::string& side,
+                       SymbolId symbol, Side side,
                        int quantity, double price,
                        int ml_prediction, double ml_score, double ml_prob_buy,
                        const std::string& model_version) {
+        METRICS_SCOPE(METRIC_EXECUTE_TRADE);
+        METRICS_COUNT(METRIC_TRADES, 1);
         
-        if (side == "BUY") {
-            double cost = quantity * price;
-            cash_ -= cost;
-            positions_[symbol] += quantity;
-            
-            printf("[TRADE] BUY %d %s @ $%.2f (Cash: $%.2f)\n",
-                   quantity, symbol.c_str(), price, cash_);
+        Position& position = entry(symbol);
+        double& cash = cash_for(position);
+        
+        // A symbol traded before its first mark is valued at the fill price
+        if (position.last_price == 0.0) {
+            position.last_price = price;
         }
-        else if (side == "SELL") {
-            double proceeds = quantity * price;
-            cash_ += proceeds;
-            positions_[symbol] -= quantity;
-            
-            if (positions_[symbol] == 0) {
-                positions_.erase(symbol);
-            }
-            
-            printf("[TRADE] SELL %d %s @ $%.2f (Cash: $%.2f)\n",
-                   quantity, symbol.c_str(), price, cash_);
+        
+        double amount = quantity * price;
+        traded_notional_ += amount;
+        if (side == Side::Buy) {
+            cash -= amount;
+            if (per_symbol_cash_) cash_ -= amount;
+            apply_fill(position, quantity, price);
+        } else {
+            cash += amount;
+            if (per_symbol_cash_) cash_ += amount;
+            apply_fill(position, -quantity, price);
+        }
+        
+        if (verbose_) {
+            printf("[TRADE] %s %d %s @ $%.2f (Cash: $%.2f)\n", side_name(side), quantity,
+                   SymbolTable::instance().name(symbol).c_str(), price, cash);
         }
         
-        // Log trade
-        Trade trade(timestamp, strategy, symbol, side, quantity, price,
-                    cash_, get_position(symbol),
-                    ml_prediction, ml_score, ml_prob_buy, model_version);
-        logger_->log_trade(trade);
+        logger_->log_trade(Trade(timestamp, strategy, symbol, side, quantity, price,
+                                 cash, position.quantity,
+                                 ml_prediction, ml_score, ml_prob_buy, model_version));
     }
     
     double get_cash() const {
         return cash_;
     }
     
-    int get_position(const std::string& symbol) const {
-        auto it = positions_.find(symbol);
-        return (it != positions_.end()) ? it->second : 0;
+    // Cash available to trade symbol: its sleeve with per-symbol cash,
+    // otherwise the shared balance.
+    double get_cash(SymbolId symbol) const {
+        if (!per_symbol_cash_) return cash_;
+        
+        const Position* position = find(symbol);
+        return (position != nullptr && position->has_sleeve) ? position->sleeve_cash : initial_cash_;
+    }
+    
+    // Cash committed to the portfolio: initial_cash, or one sleeve per
+    // symbol traded with per-symbol cash.
+    double get_capital() const {
+        return capital_;
     }
     
-    double get_total_value(const std::map<std::string, double>& prices) const {
+    // Turns off the [TRADE] console lines; trades are still logged.
+    void set_verbose(bool verbose) {
+        verbose_ = verbose;
+    }
+    
+    bool has_per_symbol_cash() const {
+        return per_symbol_cash_;
+    }
+    
+    // Open positions ordered by SymbolId.
+    std::vector<std::pair<SymbolId, int>> get_positions() const {
+        std::vector<std::pair<SymbolId, int>> positions;
+        positions.reserve(open_positions_);
+        for (size_t id = 0; id < book_.size(); ++id) {
+            if (book_[id].quantity != 0) {
+                positions.emplace_back(static_cast<SymbolId>(id), book_[id].quantity);
+            }
+        }
+        return positions;
+    }
+    
+    int get_position(SymbolId symbol) const {
+        const Position* position = find(symbol);
+        return position != nullptr ? position->quantity : 0;
+    }
+    
+    // Book entry for symbol, or nullptr if it was never marked or traded.
+    const Position* get_book_entry(SymbolId symbol) const {
+        return find(symbol);
+    }
+    
+    size_t open_positions() const {
+        return open_positions_;
+    }
+    
+    // Held shares at their latest marks.
+    double get_market_value() const {
+        return market_value_.value();
+    }
+    
+    // Cash plus market value at the latest marks.
+    double get_equity() const {
+        return cash_ + market_value_.value();
+    }
+    
+    double get_unrealized_pnl() const {
+        return market_value_.value() - cost_basis_.value();
+    }
+    
+    double get_realized_pnl() const {
+        return realized_pnl_.value();
+    }
+    
+    // Value of all fills, bought and sold.
+    double get_traded_notional() const {
+        return traded_notional_;
+    }
+    
+    // Cash plus positions valued at prices; symbols missing from prices use
+    // their latest mark.
+    double get_total_value(const std::map<SymbolId, double>& prices) const {
         double value = cash_;
         
-        for (const auto& [symbol, quantity] : positions_) {
-            auto it = prices.find(symbol);
-            if (it != prices.end()) {
-                value += quantity * it->second;
+        for (size_t id = 0; id < book_.size(); ++id) {
+            if (book_[id].quantity != 0) {
+                value += book_[id].quantity * price_of(static_cast<SymbolId>(id), prices);
             }
         }
         
         return value;
     }
     
-    void print_summary(const std::map<std::string, double>& prices) const {
+    // Cash, the book and the running sums, then the trade log's state.
+    void save_state(StateWriter& state) const {
+        state.put(initial_cash_);
+        state.put(per_symbol_cash_);
+        state.put(capital_);
+        state.put(cash_);
+        state.put_vector(book_);
+        state.put(market_value_);
+        state.put(cost_basis_);
+        state.put(realized_pnl_);
+        state.put(traded_notional_);
+        logger_->save_state(state);
+    }
+    
+    // Restores into a portfolio built with the same initial cash and cash
+    // mode.
+    bool load_state(StateReader& state) {
+        std::vector<Position> book;
+        if (!state.expect(initial_cash_, "initial cash") ||
+            !state.expect(per_symbol_cash_, "cash mode") ||
+            !state.get(capital_) || !state.get(cash_) || !state.get_vector(book) ||
+            !state.get(market_value_) || !state.get(cost_basis_) || !state.get(realized_pnl_) ||
+            !state.get(traded_notional_)) {
+            return false;
+        }
+        
+        book_.clear();
+        open_positions_ = 0;
+        for (size_t id = 0; id < book.size(); ++id) {
+            SymbolId symbol = state.symbol(static_cast<SymbolId>(id));
+            if (symbol == SymbolTable::INVALID_ID) return state.fail("missing a symbol");
+            entry(symbol) = book[id];
+            if (book[id].quantity != 0) ++open_positions_;
+        }
+        return logger_->load_state(state);
+    }
+    
+    void print_summary(const std::map<SymbolId, double>& prices) const {
         printf("\n=== PORTFOLIO SUMMARY ===\n");
-        printf("Initial Cash: $%.2f\n", initial_cash_);
+        printf("Initial Cash: $%.2f\n", capital_);
         printf("Current Cash: $%.2f\n", cash_);
         printf("\nPositions:\n");
         
-        if (positions_.empty()) {
+        if (open_positions_ == 0) {
             printf("  (No positions)\n");
         } else {
-            for (const auto& [symbol, quantity] : positions_) {
-                auto it = prices.find(symbol);
-                double price = (it != prices.end()) ? it->second : 0.0;
+            for (const auto& [symbol, quantity] : get_positions()) {
+                double price = price_of(symbol, prices);
                 double value = quantity * price;
                 printf("  %s: %d shares @ $%.2f = $%.2f\n",
-                       symbol.c_str(), quantity, price, value);
+                       SymbolTable::instance().name(symbol).c_str(), quantity, price, value);
             }
         }
         
         double total_value = get_total_value(prices);
-        double pnl = total_value - initial_cash_;
-        double pnl_pct = (pnl / initial_cash_) * 100.0;
+        double pnl = total_value - capital_;
+        double pnl_pct = (capital_ > 0) ? (pnl / capital_) * 100.0 : 0.0;
         
         printf("\nTotal Value: $%.2f\n", total_value);
         printf("P&L: $%.2f (%.2f%%)\n", pnl, pnl_pct);
         printf("=========================\n");
     }
+    
+private:
+    double price_of(SymbolId symbol, const std::map<SymbolId, double>& prices) const {
+        auto it = prices.find(symbol);
+        if (it != prices.end()) return it->second;
+        
+        const Position* position = find(symbol);
+        return position != nullptr ? position->last_price : 0.0;
+    }
 };
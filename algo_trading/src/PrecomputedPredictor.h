@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Predictor.h"
+#include "Indicators.h"
+#include "MarketDataEvent.h"
+#include "Span.h"
+#include "SymbolTable.h"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Serves predictions fetched ahead of time, keyed by symbol, timestamp and a
+// hash of the feature vector.
+//
+// build() runs the same FeatureCalculator the strategy uses over every event,
+// so during the replay the strategy asks for exactly the feature vectors that
+// were sent. Keying on the features as well keeps bars that repeat a
+// timestamp apart.
+// Lookups do not modify the table, so one instance can serve several shards.
+class PrecomputedPredictor : public Predictor {
+private:
+    struct Key {
+        SymbolId symbol;
+        std::time_t timestamp;
+        uint64_t feature_hash;
+        
+        bool operator==(const Key& other) const {
+            return symbol == other.symbol && timestamp == other.timestamp &&
+                   feature_hash == other.feature_hash;
+        }
+    };
+    
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t h = static_cast<uint64_t>(key.timestamp) * 0x9E3779B97F4A7C15ull;
+            h ^= static_cast<uint64_t>(key.symbol) * 0xC2B2AE3D27D4EB4Full;
+            return static_cast<size_t>(h ^ key.feature_hash);
+        }
+    };
+    
+    struct Entry {
+        int prediction;
+        double prob_sell;
+        double prob_buy;
+        double score;
+    };
+    
+    std::unordered_map<Key, Entry, KeyHash> entries_;
+    std::string model_version_;
+    
+    void add(const Key& key, const MLPrediction& prediction) {
+        Entry entry;
+        entry.prediction = prediction.prediction;
+        entry.prob_sell = prediction.probabilities.size() > 0 ? prediction.probabilities[0] : 0.0;
+        entry.prob_buy = prediction.probabilities.size() > 1 ? prediction.probabilities[1] : 0.0;
+        entry.score = prediction.score;
+        
+        entries_[key] = entry;
+        model_version_ = prediction.model_version;
+    }
+    
+public:
+    // Computes the features of every event in order and fetches predictions
+    // for the distinct ones, batch_size rows per request. Returns false if
+    // any request failed.
+    bool build(Span<const MarketDataEvent> events, int short_period, int long_period,
+               Predictor& source, size_t batch_size = 8192) {
+        std::vector<FeatureCalculator> calculators;
+        std::vector<double> matrix;
+        std::vector<Key> keys;
+        std::unordered_set<Key, KeyHash> queued;
+        
+        double values[FEATURE_COUNT];
+        for (const auto& event : events) {
+            if (event.symbol_id >= calculators.size()) {
+                calculators.resize(event.symbol_id + 1, FeatureCalculator(short_period, long_period));
+            }
+            if (!calculators[event.symbol_id].update(event.close, static_cast<double>(event.volume), values)) {
+                continue;
+            }
+            
+            Key key{event.symbol_id, event.timestamp, hash_features(values, FEATURE_COUNT)};
+            if (entries_.count(key) || !queued.insert(key).second) {
+                continue;  // Already known or already queued
+            }
+            matrix.insert(matrix.end(), values, values + FEATURE_COUNT);
+            keys.push_back(key);
+        }
+        
+        entries_.reserve(entries_.size() + keys.size());
+        std::vector<MLPrediction> predictions;
+        
+        for (size_t begin = 0; begin < keys.size(); begin += batch_size) {
+            size_t count = std::min(batch_size, keys.size() - begin);
+            const double* features = matrix.data() + begin * FEATURE_COUNT;
+            
+            if (!source.predict_batch(features, count, FEATURE_COUNT, predictions)) {
+                return false;
+            }
+            
+            for (size_t i = 0; i < count; ++i) {
+                add(keys[begin + i], predictions[i]);
+            }
+        }
+        
+        return true;
+    }
+    
+    MLPrediction predict(const std::string& symbol, std::time_t timestamp,
+                         const std::vector<double>& features) override {
+        MLPrediction result;
+        
+        auto it = entries_.find(Key{SymbolTable::instance().find(symbol), timestamp,
+                                    hash_features(features.data(), features.size())});
+        if (it == entries_.end()) {
+            result.error_message = "No precomputed prediction";
+            return result;
+        }
+        
+        const Entry& entry = it->second;
+        result.prediction = entry.prediction;
+        result.probabilities = {entry.prob_sell, entry.prob_buy};
+        result.score = entry.score;
+        result.model_version = model_version_;
+        result.success = true;
+        return result;
+    }
+    
+    std::string model_version() const override {
+        return model_version_;
+    }
+    
+    size_t size() const {
+        return entries_.size();
+    }
+};
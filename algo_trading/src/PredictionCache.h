@@ -0,0 +1,457 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Predictor.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Append-only cache file written by PredictionCache.
+//
+//   PredictionCacheHeader
+//   PredictionCacheRecord records[]  in insertion order
+//
+// Records carry a checksum, so a run that died halfway through a write only
+// loses the torn record at the end. All integers are little-endian.
+struct PredictionCacheHeader {
+    static constexpr char MAGIC[8] = {'A', 'L', 'G', 'O', 'P', 'C', 'A', 'C'};
+    static constexpr uint32_t VERSION = 1;
+    
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t reserved[2];
+};
+
+struct PredictionCacheRecord {
+    uint64_t symbol_hash;   // Of the ticker name; SymbolIds change between runs
+    int64_t timestamp;
+    uint64_t feature_hash;
+    uint64_t model_hash;    // Of the model version that answered
+    double prob_sell;
+    double prob_buy;
+    double score;
+    int32_t prediction;
+    uint32_t checksum;      // Of the bytes above
+    
+    uint32_t compute_checksum() const {
+        uint64_t h = Predictor::hash_features(reinterpret_cast<const double*>(this),
+                                              offsetof(PredictionCacheRecord, prediction) / sizeof(double));
+        h = (h ^ static_cast<uint32_t>(prediction)) * 0x100000001b3ull;
+        return static_cast<uint32_t>(h ^ (h >> 32));
+    }
+};
+
+static_assert(sizeof(PredictionCacheHeader) == 32, "PredictionCacheHeader layout changed");
+static_assert(sizeof(PredictionCacheRecord) == 64, "PredictionCacheRecord layout changed");
+
+// Answers repeated predictions from disk instead of asking the model again.
+//
+// Entries are keyed by ticker, timestamp, a hash of the feature vector and
+// the model version, so a backtest replayed against the same model is served
+// almost entirely from the cache. open() maps the file, keeps the records of
+// the current model version and rewrites the file without the others; new
+// answers are appended as they come in. If the model version changes during
+// a run, later lookups stop matching the old entries.
+//
+// The table and the wrapped predictor are both behind locks, so one cache can
+// serve several shards or sweep threads. Misses reach a synchronous predictor
+// one at a time; wrap an AsyncMLClient and use predict_async() to overlap
+// them.
+class PredictionCache : public Predictor {
+private:
+    static constexpr size_t FLUSH_RECORDS = 1024;
+    
+    std::shared_ptr<Predictor> inner_;
+    std::string filename_;
+    FILE* file_ = nullptr;
+    
+    mutable std::mutex mutex_;
+    std::mutex inner_mutex_;
+    std::vector<PredictionCacheRecord> records_;
+    std::vector<uint32_t> slots_;  // Open addressing: record index + 1, 0 = empty
+    size_t flushed_ = 0;           // records_[0, flushed_) are on disk
+    
+    std::string model_version_;
+    uint64_t model_hash_ = 0;
+    
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    size_t loaded_ = 0;
+    size_t dropped_ = 0;
+    
+    static uint64_t hash_string(const std::string& text) {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (unsigned char c : text) {
+            h = (h ^ c) * 0x100000001b3ull;
+        }
+        return h;
+    }
+    
+    static size_t slot_hash(uint64_t symbol_hash, int64_t timestamp, uint64_t feature_hash,
+                            uint64_t model_hash) {
+        uint64_t h = static_cast<uint64_t>(timestamp) * 0x9E3779B97F4A7C15ull;
+        h ^= symbol_hash * 0xC2B2AE3D27D4EB4Full;
+        h ^= feature_hash ^ model_hash;
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+    
+    // Index into records_, or -1. Caller holds mutex_.
+    long find(uint64_t symbol_hash, int64_t timestamp, uint64_t feature_hash) const {
+        if (slots_.empty()) return -1;
+        
+        size_t mask = slots_.size() - 1;
+        for (size_t i = slot_hash(symbol_hash, timestamp, feature_hash, model_hash_) & mask;;
+             i = (i + 1) & mask) {
+            uint32_t slot = slots_[i];
+            if (slot == 0) return -1;
+            
+            const PredictionCacheRecord& record = records_[slot - 1];
+            if (record.feature_hash == feature_hash && record.timestamp == timestamp &&
+                record.symbol_hash == symbol_hash && record.model_hash == model_hash_) {
+                return static_cast<long>(slot - 1);
+            }
+        }
+    }
+    
+    void index(size_t position) {
+        const PredictionCacheRecord& record = records_[position];
+        size_t mask = slots_.size() - 1;
+        size_t i = slot_hash(record.symbol_hash, record.timestamp, record.feature_hash,
+                             record.model_hash) & mask;
+        while (slots_[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        slots_[i] = static_cast<uint32_t>(position + 1);
+    }
+    
+    // Keeps the table at most half full. Caller holds mutex_.
+    void reserve(size_t records) {
+        if (records * 2 <= slots_.size()) return;
+        
+        size_t capacity = 1024;
+        while (capacity < records * 2) capacity <<= 1;
+        
+        slots_.assign(capacity, 0);
+        for (size_t i = 0; i < records_.size(); ++i) {
+            index(i);
+        }
+    }
+    
+    // Caller holds mutex_.
+    void insert(uint64_t symbol_hash, int64_t timestamp, uint64_t feature_hash,
+                const MLPrediction& prediction) {
+        if (prediction.model_version != model_version_) {
+            printf("[WARNING] Model version changed (%s -> %s), cached predictions no longer apply\n",
+                   model_version_.c_str(), prediction.model_version.c_str());
+            model_version_ = prediction.model_version;
+            model_hash_ = hash_string(model_version_);
+        }
+        if (find(symbol_hash, timestamp, feature_hash) >= 0) {
+            return;  // Another thread got here first
+        }
+        
+        PredictionCacheRecord record;
+        record.symbol_hash = symbol_hash;
+        record.timestamp = timestamp;
+        record.feature_hash = feature_hash;
+        record.model_hash = model_hash_;
+        record.prob_sell = prediction.probabilities.size() > 0 ? prediction.probabilities[0] : 0.0;
+        record.prob_buy = prediction.probabilities.size() > 1 ? prediction.probabilities[1] : 0.0;
+        record.score = prediction.score;
+        record.prediction = prediction.prediction;
+        record.checksum = record.compute_checksum();
+        
+        reserve(records_.size() + 1);
+        records_.push_back(record);
+        index(records_.size() - 1);
+        
+        if (records_.size() - flushed_ >= FLUSH_RECORDS) {
+            write_pending();
+        }
+    }
+    
+    MLPrediction to_prediction(const PredictionCacheRecord& record) const {
+        MLPrediction result;
+        result.prediction = record.prediction;
+        result.probabilities = {record.prob_sell, record.prob_buy};
+        result.score = record.score;
+        result.model_version = model_version_;
+        result.success = true;
+        return result;
+    }
+    
+    // Caller holds mutex_.
+    void write_pending() {
+        if (file_ == nullptr || flushed_ == records_.size()) return;
+        
+        size_t count = records_.size() - flushed_;
+        if (fwrite(&records_[flushed_], sizeof(PredictionCacheRecord), count, file_) != count) {
+            printf("[WARNING] Could not append to prediction cache: %s\n", filename_.c_str());
+        }
+        fflush(file_);
+        flushed_ = records_.size();
+    }
+    
+    // Reads the records of the current model version from the file. Returns
+    // false if the file has to be rewritten.
+    bool load() {
+        MappedFile file;
+        if (!file.open(filename_) || file.empty()) {
+            return false;
+        }
+        
+        if (file.size() < sizeof(PredictionCacheHeader)) {
+            printf("[WARNING] Prediction cache %s is truncated, starting over\n", filename_.c_str());
+            return false;
+        }
+        
+        PredictionCacheHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, PredictionCacheHeader::MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != PredictionCacheHeader::VERSION ||
+            header.record_size != sizeof(PredictionCacheRecord)) {
+            printf("[WARNING] %s is not a prediction cache of this version, starting over\n",
+                   filename_.c_str());
+            return false;
+        }
+        
+        size_t body = file.size() - sizeof(PredictionCacheHeader);
+        size_t count = body / sizeof(PredictionCacheRecord);
+        bool clean = (body % sizeof(PredictionCacheRecord)) == 0;
+        
+        records_.reserve(count);
+        const char* data = file.data() + sizeof(PredictionCacheHeader);
+        
+        for (size_t i = 0; i < count; ++i) {
+            PredictionCacheRecord record;
+            std::memcpy(&record, data + i * sizeof(record), sizeof(record));
+            
+            if (record.checksum != record.compute_checksum()) {
+                clean = false;
+                break;  // Torn write; nothing after it can be trusted
+            }
+            if (record.model_hash != model_hash_) {
+                ++dropped_;
+                continue;
+            }
+            records_.push_back(record);
+        }
+        
+        reserve(records_.size());
+        loaded_ = records_.size();
+        
+        return clean && dropped_ == 0;
+    }
+    
+public:
+    explicit PredictionCache(std::shared_ptr<Predictor> inner)
+        : inner_(inner) {}
+    
+    ~PredictionCache() {
+        close();
+    }
+    
+    PredictionCache(const PredictionCache&) = delete;
+    PredictionCache& operator=(const PredictionCache&) = delete;
+    
+    // Checks the wrapped predictor (which reports the model version), loads
+    // the matching entries from filename and opens it for appending. The
+    // file is created if missing.
+    bool open(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        filename_ = filename;
+        
+        {
+            std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+            if (!inner_->check_health()) {
+                printf("[ERROR] Prediction cache needs a working model to know its version\n");
+                return false;
+            }
+            model_version_ = inner_->model_version();
+        }
+        model_hash_ = hash_string(model_version_);
+        
+        if (load()) {
+            file_ = fopen(filename_.c_str(), "ab");
+        } else {
+            // Missing, damaged or holding other model versions: rewrite it
+            // with only what is still valid
+            file_ = fopen(filename_.c_str(), "wb");
+            if (file_ != nullptr) {
+                PredictionCacheHeader header = {};
+                std::memcpy(header.magic, PredictionCacheHeader::MAGIC, sizeof(header.magic));
+                header.version = PredictionCacheHeader::VERSION;
+                header.record_size = sizeof(PredictionCacheRecord);
+                fwrite(&header, sizeof(header), 1, file_);
+                flushed_ = 0;
+                write_pending();
+            }
+        }
+        
+        if (file_ == nullptr) {
+            printf("[ERROR] Could not open prediction cache: %s\n", filename_.c_str());
+            return false;
+        }
+        flushed_ = records_.size();
+        
+        printf("[INFO] Prediction cache: %zu entries for model %s loaded from %s",
+               loaded_, model_version_.c_str(), filename_.c_str());
+        if (dropped_ > 0) printf(" (%zu stale dropped)", dropped_);
+        printf("\n");
+        return true;
+    }
+    
+    // Writes out pending entries, closes the file and prints the counters.
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (file_ == nullptr) return;
+        
+        write_pending();
+        fclose(file_);
+        file_ = nullptr;
+        
+        size_t lookups = hits_ + misses_;
+        printf("[INFO] Prediction cache: %zu hits, %zu misses (%.1f%% hit rate), %zu entries in %s\n",
+               hits_, misses_, lookups > 0 ? 100.0 * hits_ / lookups : 0.0,
+               records_.size(), filename_.c_str());
+    }
+    
+    bool check_health() override {
+        std::lock_guard<std::mutex> lock(inner_mutex_);
+        return inner_->check_health();
+    }
+    
+    std::string model_version() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return model_version_;
+    }
+    
+    MLPrediction predict(const std::string& symbol, std::time_t timestamp,
+                         const std::vector<double>& features) override {
+        uint64_t symbol_hash = hash_string(symbol);
+        uint64_t feature_hash = hash_features(features.data(), features.size());
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            long position = find(symbol_hash, timestamp, feature_hash);
+            if (position >= 0) {
+                ++hits_;
+                return to_prediction(records_[position]);
+            }
+            ++misses_;
+        }
+        
+        MLPrediction result;
+        {
+            std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+            result = inner_->predict(symbol, timestamp, features);
+        }
+        
+        if (result.success) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            insert(symbol_hash, timestamp, feature_hash, result);
+        }
+        return result;
+    }
+    
+    // Hits are answered at once; misses go to the wrapped predictor's
+    // predict_async() and are stored when they arrive.
+    void predict_async(const std::string& symbol, std::time_t timestamp,
+                       const std::vector<double>& features, PredictionCallback done) override {
+        uint64_t symbol_hash = hash_string(symbol);
+        uint64_t feature_hash = hash_features(features.data(), features.size());
+        
+        MLPrediction cached;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            long position = find(symbol_hash, timestamp, feature_hash);
+            if (position >= 0) {
+                ++hits_;
+                cached = to_prediction(records_[position]);
+            } else {
+                ++misses_;
+            }
+        }
+        if (cached.success) {
+            done(cached);
+            return;
+        }
+        
+        std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+        inner_->predict_async(symbol, timestamp, features,
+            [this, symbol_hash, timestamp, feature_hash, done](const MLPrediction& result) {
+                if (result.success) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    insert(symbol_hash, timestamp, feature_hash, result);
+                }
+                done(result);
+            });
+    }
+    
+    // Batch rows have no symbol or timestamp, so they are cached by features
+    // (and model version) alone. Only the misses go to the wrapped predictor,
+    // in one batch.
+    bool predict_batch(const double* features, size_t rows, size_t feature_count,
+                       std::vector<MLPrediction>& out) override {
+        const uint64_t symbol_hash = hash_string(std::string());
+        out.assign(rows, MLPrediction());
+        
+        std::vector<uint64_t> hashes(rows);
+        std::vector<size_t> missing;
+        std::vector<double> matrix;
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < rows; ++i) {
+                const double* row = features + i * feature_count;
+                hashes[i] = hash_features(row, feature_count);
+                
+                long position = find(symbol_hash, 0, hashes[i]);
+                if (position >= 0) {
+                    out[i] = to_prediction(records_[position]);
+                    continue;
+                }
+                missing.push_back(i);
+                matrix.insert(matrix.end(), row, row + feature_count);
+            }
+            hits_ += rows - missing.size();
+            misses_ += missing.size();
+        }
+        
+        if (missing.empty()) return true;
+        
+        std::vector<MLPrediction> answers;
+        bool ok;
+        {
+            std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+            ok = inner_->predict_batch(matrix.data(), missing.size(), feature_count, answers);
+        }
+        if (answers.size() != missing.size()) return false;
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t j = 0; j < missing.size(); ++j) {
+            size_t i = missing[j];
+            out[i] = answers[j];
+            if (out[i].success) {
+                insert(symbol_hash, 0, hashes[i], out[i]);
+            }
+        }
+        return ok;
+    }
+    
+    size_t hits() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_;
+    }
+    
+    size_t misses() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return misses_;
+    }
+};
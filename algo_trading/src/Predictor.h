@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct MLPrediction {
+    int prediction;
+    std::vector<double> probabilities;
+    double score;
+    std::string model_version;
+    bool success;
+    std::string error_message;
+    
+    MLPrediction()
+        : prediction(0), score(0.0), success(false) {}
+};
+
+using PredictionCallback = std::function<void(const MLPrediction&)>;
+
+// Source of model predictions for a strategy. MLClient asks the prediction
+// server per bar; other implementations answer from precomputed results.
+class Predictor {
+public:
+    virtual ~Predictor() = default;
+    
+    virtual MLPrediction predict(const std::string& symbol, std::time_t timestamp,
+                                 const std::vector<double>& features) = 0;
+    
+    // Calls done with the prediction, possibly later and on another thread.
+    // The default answers synchronously before returning; AsyncMLClient
+    // queues the request and returns at once.
+    virtual void predict_async(const std::string& symbol, std::time_t timestamp,
+                               const std::vector<double>& features, PredictionCallback done) {
+        done(predict(symbol, timestamp, features));
+    }
+    
+    // True if predict_async() returns before the answer is ready rather than
+    // computing it on the caller's thread.
+    virtual bool is_asynchronous() const {
+        return false;
+    }
+    
+    std::future<MLPrediction> predict_future(const std::string& symbol, std::time_t timestamp,
+                                             const std::vector<double>& features) {
+        auto promise = std::make_shared<std::promise<MLPrediction>>();
+        std::future<MLPrediction> result = promise->get_future();
+        predict_async(symbol, timestamp, features,
+                      [promise](const MLPrediction& prediction) { promise->set_value(prediction); });
+        return result;
+    }
+    
+    // Predicts rows feature vectors of feature_count values each
+    // (row-major). Fills out with one prediction per row and returns false
+    // if any failed. Rows have no symbol or timestamp attached.
+    virtual bool predict_batch(const double* features, size_t rows, size_t feature_count,
+                               std::vector<MLPrediction>& out) {
+        out.resize(rows);
+        bool ok = true;
+        
+        for (size_t i = 0; i < rows; ++i) {
+            const double* row = features + i * feature_count;
+            out[i] = predict("", 0, std::vector<double>(row, row + feature_count));
+            ok = ok && out[i].success;
+        }
+        return ok;
+    }
+    
+    virtual bool check_health() {
+        return true;
+    }
+    
+    // Version of the model answering predict(), or empty if not known yet.
+    virtual std::string model_version() const {
+        return std::string();
+    }
+    
+    // FNV-1a over the raw bytes of a feature vector.
+    static uint64_t hash_features(const double* features, size_t count) {
+        uint64_t h = 0xcbf29ce484222325ull;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(features);
+        for (size_t i = 0; i < count * sizeof(double); ++i) {
+            h = (h ^ bytes[i]) * 0x100000001b3ull;
+        }
+        return h;
+    }
+};
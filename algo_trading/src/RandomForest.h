@@ -0,0 +1,231 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Predictor.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// On-disk layout written by export_forest() in backend_python/train_model.py.
+//
+//   ForestHeader
+//   uint32_t roots[tree_count]       node index of each tree's root,
+//                                    padded to a multiple of 16 bytes
+//   ForestNode nodes[node_count]
+//
+// Each tree is stored in depth-first preorder, so a split's left child is
+// the next node and only the right child needs an index. All integers are
+// little-endian.
+struct ForestHeader {
+    static constexpr char MAGIC[8] = {'A', 'L', 'G', 'O', 'F', 'R', 'S', 'T'};
+    static constexpr uint32_t VERSION = 1;
+    
+    char magic[8];
+    uint32_t version;
+    uint32_t feature_count;
+    uint32_t tree_count;
+    uint32_t class_count;
+    uint64_t node_count;
+    char model_version[32];  // NUL-padded
+};
+
+struct ForestNode {
+    double value;     // Split threshold, or P(BUY) for a leaf
+    uint32_t right;   // Right child index (splits only)
+    int32_t feature;  // Feature to compare, -1 for a leaf
+};
+
+static_assert(sizeof(ForestHeader) == 64, "ForestHeader layout changed");
+static_assert(sizeof(ForestNode) == 16, "ForestNode layout changed");
+
+// Evaluates an exported RandomForestClassifier in process. The file is
+// memory-mapped and used in place; nothing is copied at load time.
+//
+// Like scikit-learn, features are rounded to float32 before they are
+// compared with the thresholds, and the class probabilities are the mean of
+// the per-tree leaf probabilities. Evaluation only reads the mapping, so one
+// instance can be shared by several threads.
+class RandomForest : public Predictor {
+private:
+    static constexpr size_t BLOCK_ROWS = 64;
+    
+    MappedFile file_;
+    const ForestHeader* header_ = nullptr;
+    const uint32_t* roots_ = nullptr;
+    const ForestNode* nodes_ = nullptr;
+    std::string model_version_;
+    
+    double leaf_value(const ForestNode* node, const float* row) const {
+        while (node->feature >= 0) {
+            node = (static_cast<double>(row[node->feature]) <= node->value)
+                ? node + 1 : nodes_ + node->right;
+        }
+        return node->value;
+    }
+    
+public:
+    bool load(const std::string& filename) {
+        header_ = nullptr;
+        
+        if (!file_.open(filename)) {
+            printf("[ERROR] Could not open file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        if (file_.size() < sizeof(ForestHeader)) {
+            printf("[ERROR] Not a forest file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        auto header = reinterpret_cast<const ForestHeader*>(file_.data());
+        
+        if (std::memcmp(header->magic, ForestHeader::MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != ForestHeader::VERSION || header->class_count != 2) {
+            printf("[ERROR] Not a forest file (bad magic/version): %s\n", filename.c_str());
+            return false;
+        }
+        
+        // Counts are bounded by what is left of the file before anything is
+        // multiplied, so a corrupt count cannot wrap the size check
+        const uint64_t size = file_.size();
+        if (header->tree_count == 0 ||
+            header->tree_count > (size - sizeof(ForestHeader)) / sizeof(uint32_t)) {
+            printf("[ERROR] Truncated forest file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        uint64_t roots_size = (static_cast<uint64_t>(header->tree_count) * sizeof(uint32_t) + 15) / 16 * 16;
+        uint64_t nodes_offset = sizeof(ForestHeader) + roots_size;
+        
+        if (nodes_offset > size || header->node_count > (size - nodes_offset) / sizeof(ForestNode)) {
+            printf("[ERROR] Truncated forest file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        roots_ = reinterpret_cast<const uint32_t*>(file_.data() + sizeof(ForestHeader));
+        nodes_ = reinterpret_cast<const ForestNode*>(file_.data() + nodes_offset);
+        
+        // Check every index once so evaluation needs no bounds checks
+        for (uint32_t t = 0; t < header->tree_count; ++t) {
+            if (roots_[t] >= header->node_count) {
+                printf("[ERROR] Corrupt forest file: %s\n", filename.c_str());
+                return false;
+            }
+        }
+        for (uint64_t i = 0; i < header->node_count; ++i) {
+            const ForestNode& node = nodes_[i];
+            if (node.feature >= static_cast<int32_t>(header->feature_count) ||
+                (node.feature >= 0 && (node.right <= i + 1 || node.right >= header->node_count))) {
+                printf("[ERROR] Corrupt forest file: %s\n", filename.c_str());
+                return false;
+            }
+        }
+        
+        header_ = header;
+        model_version_.assign(header->model_version,
+                              strnlen(header->model_version, sizeof(header->model_version)));
+        
+        printf("[ML] Loaded forest: %u trees, %llu nodes, %u features (%s)\n",
+               header_->tree_count, static_cast<unsigned long long>(header_->node_count),
+               header_->feature_count, model_version_.c_str());
+        return true;
+    }
+    
+    bool is_loaded() const {
+        return header_ != nullptr;
+    }
+    
+    size_t feature_count() const {
+        return header_ ? header_->feature_count : 0;
+    }
+    
+    std::string model_version() const override {
+        return model_version_;
+    }
+    
+    // P(BUY) for rows row-major rows of `stride` values (stride >=
+    // feature_count()). Rows are taken BLOCK_ROWS at a time and each tree is
+    // walked for the whole block before moving on, so a tree's nodes stay in
+    // cache across rows. prob_sell may be null.
+    void predict_proba(const double* rows, size_t count, size_t stride,
+                       double* prob_buy, double* prob_sell = nullptr) const {
+        const size_t features = header_->feature_count;
+        const double trees = static_cast<double>(header_->tree_count);
+        std::vector<float> block(BLOCK_ROWS * features);
+        double buy[BLOCK_ROWS];
+        double sell[BLOCK_ROWS];
+        
+        for (size_t begin = 0; begin < count; begin += BLOCK_ROWS) {
+            size_t n = std::min(BLOCK_ROWS, count - begin);
+            
+            for (size_t r = 0; r < n; ++r) {
+                for (size_t f = 0; f < features; ++f) {
+                    block[r * features + f] = static_cast<float>(rows[(begin + r) * stride + f]);
+                }
+                buy[r] = 0.0;
+                sell[r] = 0.0;
+            }
+            
+            for (uint32_t t = 0; t < header_->tree_count; ++t) {
+                const ForestNode* root = nodes_ + roots_[t];
+                for (size_t r = 0; r < n; ++r) {
+                    double p = leaf_value(root, &block[r * features]);
+                    buy[r] += p;
+                    sell[r] += 1.0 - p;
+                }
+            }
+            
+            for (size_t r = 0; r < n; ++r) {
+                prob_buy[begin + r] = buy[r] / trees;
+                if (prob_sell) prob_sell[begin + r] = sell[r] / trees;
+            }
+        }
+    }
+    
+    bool check_health() override {
+        if (!is_loaded()) {
+            printf("[ML] Health check failed: no forest loaded\n");
+            return false;
+        }
+        return true;
+    }
+    
+    MLPrediction predict(const std::string& symbol, std::time_t timestamp,
+                         const std::vector<double>& features) override {
+        (void)symbol;
+        (void)timestamp;
+        
+        std::vector<MLPrediction> out;
+        predict_batch(features.data(), 1, features.size(), out);
+        return out[0];
+    }
+    
+    bool predict_batch(const double* features, size_t rows, size_t feature_count,
+                       std::vector<MLPrediction>& out) override {
+        out.assign(rows, MLPrediction());
+        
+        if (!is_loaded() || feature_count < header_->feature_count) {
+            for (auto& prediction : out) {
+                prediction.error_message = "Forest not loaded or too few features";
+            }
+            return false;
+        }
+        
+        std::vector<double> buy(rows);
+        std::vector<double> sell(rows);
+        predict_proba(features, rows, feature_count, buy.data(), sell.data());
+        
+        for (size_t i = 0; i < rows; ++i) {
+            // argmax as in predict(); a tie goes to class 0
+            out[i].prediction = (buy[i] > sell[i]) ? 1 : 0;
+            out[i].probabilities = {sell[i], buy[i]};
+            out[i].score = out[i].probabilities[out[i].prediction];
+            out[i].model_version = model_version_;
+            out[i].success = true;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <algorithm>
+
+enum class ReplayMode {
+    MaxSpeed,        // Dispatch events as fast as the strategy consumes them
+    ScaledRealTime,  // Reproduce the gaps between event timestamps / speed
+    Stepped          // Wait for the user before each event (debugging)
+};
+
+inline const char* replay_mode_name(ReplayMode mode) {
+    switch (mode) {
+        case ReplayMode::MaxSpeed:       return "max-speed";
+        case ReplayMode::ScaledRealTime: return "realtime";
+        case ReplayMode::Stepped:        return "stepped";
+    }
+    return "unknown";
+}
+
+// Paces event dispatch on the engine thread and keeps run statistics.
+//
+// In scaled real-time mode the first event anchors the clock: an event with
+// timestamp ts is due at wall_start + (ts - first_ts) / speed. Drift is how
+// late each event was actually released compared with that schedule.
+class ReplayClock {
+private:
+    using Clock = std::chrono::steady_clock;
+    
+    ReplayMode mode_;
+    ReplayMode configured_mode_;
+    double speed_;
+    
+    bool anchored_ = false;
+    Clock::time_point wall_start_;
+    std::time_t sim_start_ = 0;
+    
+    size_t events_ = 0;
+    double drift_sum_us_ = 0.0;
+    double drift_max_us_ = 0.0;
+    size_t steps_remaining_ = 0;
+    
+    void anchor(std::time_t timestamp) {
+        if (!anchored_) {
+            anchored_ = true;
+            wall_start_ = Clock::now();
+            sim_start_ = timestamp;
+        }
+    }
+    
+    void step_prompt(std::time_t timestamp) {
+        if (steps_remaining_ > 0) {
+            --steps_remaining_;
+            return;
+        }
+        
+        printf("[STEP] Event #%zu @ %lld - Enter: next, <n>: skip n, c: continue > ",
+               events_ + 1, static_cast<long long>(timestamp));
+        fflush(stdout);
+        
+        char line[64];
+        if (fgets(line, sizeof(line), stdin) == nullptr || line[0] == 'c') {
+            mode_ = ReplayMode::MaxSpeed;  // EOF or continue: run to the end
+            return;
+        }
+        
+        long n = std::strtol(line, nullptr, 10);
+        if (n > 1) {
+            steps_remaining_ = static_cast<size_t>(n - 1);
+        }
+    }
+    
+public:
+    explicit ReplayClock(ReplayMode mode = ReplayMode::MaxSpeed, double speed = 1.0)
+        : mode_(mode), configured_mode_(mode), speed_(speed > 0 ? speed : 1.0) {}
+    
+    // When an event with timestamp is due in scaled real time. The first
+    // event seen anchors the clock.
+    Clock::time_point due(std::time_t timestamp) {
+        anchor(timestamp);
+        double offset_s = static_cast<double>(timestamp - sim_start_) / speed_;
+        return wall_start_ + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(std::max(0.0, offset_s)));
+    }
+    
+    // Called by the engine right before an event is handed to the strategy.
+    void pace(std::time_t timestamp) {
+        anchor(timestamp);
+        
+        if (mode_ == ReplayMode::ScaledRealTime) {
+            auto due = this->due(timestamp);
+            auto now = Clock::now();
+            if (now < due) {
+                std::this_thread::sleep_until(due);
+                now = Clock::now();
+            }
+            
+            double drift_us = std::chrono::duration<double, std::micro>(now - due).count();
+            drift_sum_us_ += drift_us;
+            drift_max_us_ = std::max(drift_max_us_, drift_us);
+        }
+        else if (mode_ == ReplayMode::Stepped) {
+            step_prompt(timestamp);
+        }
+        
+        ++events_;
+    }
+    
+    ReplayMode mode() const {
+        return configured_mode_;
+    }
+    
+    double speed() const {
+        return speed_;
+    }
+    
+    size_t events() const {
+        return events_;
+    }
+    
+    double elapsed_seconds() const {
+        if (!anchored_) return 0.0;
+        return std::chrono::duration<double>(Clock::now() - wall_start_).count();
+    }
+    
+    void print_report() const {
+        double seconds = elapsed_seconds();
+        double rate = seconds > 0 ? events_ / seconds : 0.0;
+        
+        printf("[INFO] Replay (%s): %zu events in %.3f s (%.0f events/s)\n",
+               replay_mode_name(configured_mode_), events_, seconds, rate);
+        
+        if (configured_mode_ == ReplayMode::ScaledRealTime && events_ > 0) {
+            printf("[INFO] Clock drift (x%.1f): mean %.1f us, max %.1f us\n",
+                   speed_, drift_sum_us_ / events_, drift_max_us_);
+        }
+    }
+};
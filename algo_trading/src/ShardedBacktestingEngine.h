@@ -0,0 +1,261 @@
+#pragma once
+
+#include "BacktestingEngine.h"
+#include "MarketDataSource.h"
+#include "Portfolio.h"
+#include "TradeLogger.h"
+#include "TradingStrategy.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Runs one BacktestingEngine per shard and routes each event to the shard
+// owning its symbol. Every shard has its own strategy, portfolio and logger,
+// so workers share nothing on the hot path.
+//
+// Portfolios use per-symbol cash: a symbol's trades depend only on its own
+// events, and each symbol lives on exactly one shard. merged_trades() sorts
+// by timestamp, then symbol name, so the output is the same for any number
+// of shards.
+class ShardedBacktestingEngine {
+public:
+    using StrategyFactory =
+        std::function<std::shared_ptr<TradingStrategy>(std::shared_ptr<Portfolio>)>;
+        
+private:
+    struct Shard {
+        std::shared_ptr<TradeLogger> logger;
+        std::shared_ptr<Portfolio> portfolio;
+        std::shared_ptr<TradingStrategy> strategy;
+        std::unique_ptr<BacktestingEngine> engine;
+        std::vector<MarketDataEvent> pending;
+    };
+    
+    std::vector<Shard> shards_;
+    double initial_cash_;
+    
+    std::unique_ptr<MarketDataSource> source_;
+    std::thread router_thread_;
+    std::atomic<bool> routing_;
+    std::atomic<size_t> events_streamed_;
+    std::vector<double> last_close_;  // Indexed by SymbolId, written by the router
+    
+public:
+    // initial_cash is the cash sleeve given to every symbol.
+    ShardedBacktestingEngine(size_t shard_count, double initial_cash,
+                             const StrategyFactory& make_strategy,
+                             size_t max_queued_events = 0,
+                             WaitStrategy wait_strategy = WaitStrategy::Hybrid)
+        : initial_cash_(initial_cash), routing_(false), events_streamed_(0) {
+        shard_count = std::max<size_t>(1, shard_count);
+        shards_.resize(shard_count);
+        
+        for (auto& shard : shards_) {
+            shard.logger = std::make_shared<TradeLogger>();
+            shard.portfolio = std::make_shared<Portfolio>(initial_cash, shard.logger, true);
+            shard.strategy = make_strategy(shard.portfolio);
+            shard.engine = std::make_unique<BacktestingEngine>(
+                shard.strategy, max_queued_events, wait_strategy);
+        }
+    }
+    
+    ~ShardedBacktestingEngine() {
+        stop();
+    }
+    
+    size_t shard_count() const {
+        return shards_.size();
+    }
+    
+    // Fibonacci hashing spreads consecutive ids evenly over the shards.
+    size_t shard_of(SymbolId symbol) const {
+        uint64_t hash = static_cast<uint64_t>(symbol) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>((hash >> 32) % shards_.size());
+    }
+    
+    // Must be called before start(). Stepped replay needs a single reader of
+    // stdin, so it falls back to max speed with more than one shard.
+    void set_replay(ReplayMode mode, double speed = 1.0) {
+        if (mode == ReplayMode::Stepped && shards_.size() > 1) {
+            printf("[WARNING] Stepped replay needs --shards 1, replaying at max speed\n");
+            mode = ReplayMode::MaxSpeed;
+        }
+        
+        for (auto& shard : shards_) {
+            shard.engine->set_replay(mode, speed);
+        }
+    }
+    
+    void start() {
+        for (auto& shard : shards_) {
+            shard.engine->start();
+        }
+    }
+    
+    // Starts a router thread that reads the source chunk by chunk and hands
+    // each shard its slice of the chunk in one batch.
+    void stream_from(std::unique_ptr<MarketDataSource> source, const StreamOptions& options = {}) {
+        wait_for_stream();
+        
+        source_ = std::move(source);
+        routing_ = true;
+        
+        router_thread_ = std::thread([this, options]() {
+            std::vector<MarketDataEvent> chunk;
+            chunk.reserve(options.chunk_size);
+            
+            for (auto& shard : shards_) {
+                shard.pending.reserve(options.chunk_size);
+            }
+            
+            while (routing_) {
+                chunk.clear();
+                
+                size_t want = options.chunk_size;
+                if (options.max_events > 0) {
+                    want = std::min(want, options.max_events - events_streamed_);
+                }
+                
+                if (want == 0 || source_->read(chunk, want) == 0) {
+                    break;  // Limit reached or source exhausted
+                }
+                
+                for (const auto& event : chunk) {
+                    if (event.symbol_id >= last_close_.size()) {
+                        last_close_.resize(event.symbol_id + 1, 0.0);
+                    }
+                    last_close_[event.symbol_id] = event.close;
+                    shards_[shard_of(event.symbol_id)].pending.push_back(event);
+                }
+                
+                bool stopped = false;
+                for (auto& shard : shards_) {
+                    if (shard.pending.empty()) continue;
+                    
+                    size_t pushed = shard.engine->add_events(
+                        Span<const MarketDataEvent>(shard.pending.data(), shard.pending.size()));
+                    stopped = stopped || pushed < shard.pending.size();
+                    shard.pending.clear();
+                }
+                
+                events_streamed_ += chunk.size();
+                
+                if (stopped) {
+                    break;  // Engine stopped
+                }
+            }
+            
+            routing_ = false;
+            printf("[INFO] Routed %zu events from: %s across %zu shards\n",
+                   events_streamed_.load(), source_->name().c_str(), shards_.size());
+        });
+    }
+    
+    // Blocks until the router has pushed its last event.
+    void wait_for_stream() {
+        if (router_thread_.joinable()) {
+            router_thread_.join();
+        }
+    }
+    
+    // Stops the router, then lets every shard drain and joins its threads.
+    void stop() {
+        routing_ = false;
+        for (auto& shard : shards_) {
+            shard.engine->stop();
+        }
+        wait_for_stream();
+    }
+    
+    size_t events_processed() const {
+        size_t total = 0;
+        for (const auto& shard : shards_) {
+            total += shard.engine->events_processed();
+        }
+        return total;
+    }
+    
+    // Last close seen for every symbol. Call after wait_for_stream().
+    std::map<SymbolId, double> final_prices() const {
+        std::map<SymbolId, double> prices;
+        for (size_t id = 0; id < last_close_.size(); ++id) {
+            if (last_close_[id] != 0.0) {
+                prices[static_cast<SymbolId>(id)] = last_close_[id];
+            }
+        }
+        return prices;
+    }
+    
+    // All trades ordered by timestamp, then symbol name. Trades of one symbol
+    // come from one shard in execution order and the sort is stable, so ties
+    // keep that order. Call after stop().
+    std::vector<Trade> merged_trades() const {
+        std::vector<Trade> trades;
+        for (const auto& shard : shards_) {
+            const auto& shard_trades = shard.logger->get_trades();
+            trades.insert(trades.end(), shard_trades.begin(), shard_trades.end());
+        }
+        
+        std::stable_sort(trades.begin(), trades.end(), [](const Trade& a, const Trade& b) {
+            if (a.timestamp != b.timestamp) return a.timestamp < b.timestamp;
+            return a.symbol() < b.symbol();
+        });
+        return trades;
+    }
+    
+    // Writes merged_trades() to filename. Returns the number of trades.
+    size_t save_trades(const std::string& filename) const {
+        TradeLogger merged;
+        for (const auto& trade : merged_trades()) {
+            merged.log_trade(trade);
+        }
+        merged.save_to_csv(filename);
+        return merged.count();
+    }
+    
+    // Same layout as Portfolio::print_summary(), summed over all shards.
+    void print_summary(const std::map<SymbolId, double>& prices) const {
+        double capital = 0.0;
+        double cash = 0.0;
+        double total_value = 0.0;
+        std::map<SymbolId, int> positions;
+        
+        for (const auto& shard : shards_) {
+            capital += shard.portfolio->get_capital();
+            cash += shard.portfolio->get_cash();
+            total_value += shard.portfolio->get_total_value(prices);
+            for (const auto& [symbol, quantity] : shard.portfolio->get_positions()) {
+                positions[symbol] += quantity;
+            }
+        }
+        
+        printf("\n=== PORTFOLIO SUMMARY ===\n");
+        printf("Shards: %zu (per-symbol cash: $%.2f)\n", shards_.size(), initial_cash_);
+        printf("Initial Cash: $%.2f\n", capital);
+        printf("Current Cash: $%.2f\n", cash);
+        printf("\nPositions:\n");
+        
+        if (positions.empty()) {
+            printf("  (No positions)\n");
+        } else {
+            for (const auto& [symbol, quantity] : positions) {
+                auto it = prices.find(symbol);
+                double price = (it != prices.end()) ? it->second : 0.0;
+                double value = quantity * price;
+                printf("  %s: %d shares @ $%.2f = $%.2f\n",
+                       SymbolTable::instance().name(symbol).c_str(), quantity, price, value);
+            }
+        }
+        
+        double pnl = total_value - capital;
+        double pnl_pct = (capital > 0) ? (pnl / capital) * 100.0 : 0.0;
+        
+        printf("\nTotal Value: $%.2f\n", total_value);
+        printf("P&L: $%.2f (%.2f%%)\n", pnl, pnl_pct);
+        printf("=========================\n");
+    }
+};
@@ -0,0 +1,439 @@
+#pragma once
+
+#include "Predictor.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+// Shared-memory segment created by the reader loop in
+// backend_python/main_ml_api.py (shm_reader_loop).
+//
+//   ShmHeader                  128 bytes, written by the server
+//   ShmSlot slots[slot_count]  128 bytes each
+//
+// A slot moves FREE -> CLAIMED -> REQUEST (client) -> RESPONSE (server) ->
+// FREE (client). Each side writes the payload before it publishes the new
+// state, and only the client claims slots, so several client threads can
+// share the segment. A client that gives up on a slot remembers it and takes
+// it back once the late RESPONSE arrives, so the server never frees slots.
+// A claimed slot records its client's pid; a client attaching frees the
+// slots of clients that have exited, once the server is done with them.
+//
+// The server is Python and has no fences: it relies on x86-64 keeping its
+// stores in order, so the state is never seen before the payload. Both sides
+// refuse to use the segment on other machines. All integers are
+// little-endian.
+struct ShmHeader {
+    static constexpr char MAGIC[8] = {'A', 'L', 'G', 'O', 'S', 'H', 'M', 'Q'};
+    static constexpr uint32_t VERSION = 1;
+    
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t feature_count;
+    uint32_t slot_size;
+    uint32_t server_pid;
+    uint32_t reserved0;
+    uint64_t heartbeat_ns;    // Wall clock, refreshed by the server loop
+    char model_version[32];   // NUL-padded
+    char reserved[56];
+};
+
+struct ShmSlot {
+    static constexpr size_t MAX_FEATURES = 8;
+    
+    enum State : uint32_t { FREE = 0, CLAIMED = 1, REQUEST = 2, RESPONSE = 3 };
+    
+    std::atomic<uint32_t> state;
+    int32_t prediction;
+    int64_t timestamp;
+    double features[MAX_FEATURES];
+    double prob_sell;
+    double prob_buy;
+    double score;
+    std::atomic<uint32_t> owner;  // Pid of the client holding the slot, 0 while FREE
+    char reserved[20];
+};
+
+static_assert(sizeof(ShmHeader) == 128, "ShmHeader layout changed");
+static_assert(sizeof(ShmSlot) == 128, "ShmSlot layout changed");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Slot state must be lock-free");
+
+// Predictor that talks to the ML server through a shared-memory ring instead
+// of HTTP. Requests are a feature row written into a slot; the caller spins
+// (then yields) until the server flips the slot to RESPONSE, so a round trip
+// costs no syscalls and no JSON.
+//
+// POSIX on x86-64 only: open() fails elsewhere and callers fall back to
+// MLClient.
+class ShmPredictor : public Predictor {
+private:
+    static constexpr int64_t HEARTBEAT_TIMEOUT_NS = 2000000000;  // 2 s
+    
+    std::string name_;
+    std::chrono::milliseconds timeout_{10000};  // Same as MLClient's read timeout
+    void* mapping_ = nullptr;
+    size_t size_ = 0;
+    const ShmHeader* header_ = nullptr;
+    ShmSlot* slots_ = nullptr;
+    uint32_t slot_count_ = 0;
+    std::unique_ptr<std::atomic<bool>[]> abandoned_;  // By slot: caller gave up on it
+    uint32_t pid_ = 0;
+    
+    static void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    
+    int64_t heartbeat_age_ns() const {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        return now - static_cast<int64_t>(header_->heartbeat_ns);
+    }
+    
+    // Spins, then yields, until done(). Returns false at the deadline, or
+    // early if the server stops refreshing its heartbeat.
+    template<typename Done>
+    bool wait_until(Done done, std::chrono::steady_clock::time_point deadline) const {
+        for (uint32_t spins = 0; !done(); ++spins) {
+            if (spins < 4096) {
+                pause();
+                continue;
+            }
+            if ((spins & 63) == 0 && (std::chrono::steady_clock::now() > deadline ||
+                                      heartbeat_age_ns() > HEARTBEAT_TIMEOUT_NS)) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+    
+    // Claims a free slot, or an abandoned one the server has answered since,
+    // starting the search at a per-thread position so threads rarely contend
+    // for the same slots. Returns nullptr on timeout.
+    ShmSlot* claim(std::chrono::steady_clock::time_point deadline) {
+        thread_local uint32_t hint =
+            static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        ShmSlot* slot = nullptr;
+        
+        bool ok = wait_until([&]() {
+            for (uint32_t i = 0; i < slot_count_; ++i) {
+                uint32_t index = (hint + i) % slot_count_;
+                ShmSlot& candidate = slots_[index];
+                uint32_t expected = candidate.state.load(std::memory_order_relaxed);
+                bool reclaim = expected == ShmSlot::RESPONSE &&
+                               abandoned_[index].load(std::memory_order_acquire);
+                if ((expected == ShmSlot::FREE || reclaim) &&
+                    candidate.state.compare_exchange_strong(expected, ShmSlot::CLAIMED,
+                                                            std::memory_order_acquire)) {
+                    if (reclaim) {
+                        abandoned_[index].store(false, std::memory_order_relaxed);
+                    }
+                    candidate.owner.store(pid_, std::memory_order_relaxed);
+                    hint += i + 1;
+                    slot = &candidate;
+                    return true;
+                }
+            }
+            return false;
+        }, deadline);
+        
+        return ok ? slot : nullptr;
+    }
+    
+    static void post(ShmSlot& slot, std::time_t timestamp, const double* features, size_t count) {
+        slot.timestamp = static_cast<int64_t>(timestamp);
+        std::memset(slot.features, 0, sizeof(slot.features));
+        std::memcpy(slot.features, features, std::min(count, ShmSlot::MAX_FEATURES) * sizeof(double));
+        slot.state.store(ShmSlot::REQUEST, std::memory_order_release);
+    }
+    
+    // Reads the answer and frees the slot.
+    MLPrediction take(ShmSlot& slot) const {
+        MLPrediction result;
+        result.prediction = slot.prediction;
+        result.probabilities = {slot.prob_sell, slot.prob_buy};
+        result.score = slot.score;
+        result.model_version = model_version();
+        result.success = true;
+        
+        slot.owner.store(0, std::memory_order_relaxed);
+        slot.state.store(ShmSlot::FREE, std::memory_order_release);
+        return result;
+    }
+    
+    static bool process_alive(uint32_t pid) {
+#ifdef _WIN32
+        (void)pid;
+        return true;
+#else
+        return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+    }
+    
+    // Frees slots left behind by clients that exited or crashed while
+    // holding them. A slot still in REQUEST is waited for, since the server
+    // may be about to answer it. Winning the owner swap makes one client the
+    // one to free each slot.
+    size_t free_orphaned_slots() {
+        size_t freed = 0;
+        auto until = deadline();
+        
+        for (uint32_t i = 0; i < slot_count_; ++i) {
+            ShmSlot& slot = slots_[i];
+            if (slot.state.load(std::memory_order_acquire) == ShmSlot::FREE) continue;
+            uint32_t owner = slot.owner.load(std::memory_order_acquire);
+            if (owner == 0 || owner == pid_ || process_alive(owner)) continue;
+            
+            if (!wait_until([&slot]() {
+                    return slot.state.load(std::memory_order_acquire) != ShmSlot::REQUEST;
+                }, until)) {
+                continue;  // Server not answering; a later client tries again
+            }
+            if (slot.owner.compare_exchange_strong(owner, 0, std::memory_order_acq_rel)) {
+                slot.state.store(ShmSlot::FREE, std::memory_order_release);
+                ++freed;
+            }
+        }
+        return freed;
+    }
+    
+    // Gives up on a posted slot. Its answer may still come, so the slot is
+    // only reused once claim() sees it answered.
+    void abandon(const ShmSlot& slot) {
+        abandoned_[static_cast<size_t>(&slot - slots_)].store(true, std::memory_order_release);
+    }
+    
+    static bool answered(const ShmSlot& slot) {
+        return slot.state.load(std::memory_order_acquire) == ShmSlot::RESPONSE;
+    }
+    
+    static MLPrediction failure(const char* message) {
+        MLPrediction result;
+        result.error_message = message;
+        return result;
+    }
+    
+    std::chrono::steady_clock::time_point deadline() const {
+        return std::chrono::steady_clock::now() + timeout_;
+    }
+    
+public:
+    ShmPredictor() = default;
+    
+    ~ShmPredictor() {
+        close();
+    }
+    
+    ShmPredictor(const ShmPredictor&) = delete;
+    ShmPredictor& operator=(const ShmPredictor&) = delete;
+    
+    // Attaches to the segment the server created (name without the leading
+    // slash, e.g. "algo_ml"). Returns false if it is missing or incompatible.
+    bool open(const std::string& name) {
+        close();
+        name_ = name;
+        
+#if defined(_WIN32)
+        printf("[ML] Shared-memory transport is not supported on Windows\n");
+        return false;
+#elif !defined(__x86_64__)
+        printf("[ML] Shared-memory transport needs an x86-64 machine\n");
+        return false;
+#else
+        int fd = shm_open(("/" + name).c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            printf("[ML] Shared-memory segment /%s not found (is the server running?)\n",
+                   name.c_str());
+            return false;
+        }
+        
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmHeader)) {
+            ::close(fd);
+            printf("[ML] Shared-memory segment /%s is too small\n", name.c_str());
+            return false;
+        }
+        
+        size_ = static_cast<size_t>(st.st_size);
+        void* addr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);  // The mapping keeps its own reference
+        
+        if (addr == MAP_FAILED) {
+            size_ = 0;
+            printf("[ML] Could not map shared-memory segment /%s\n", name.c_str());
+            return false;
+        }
+        mapping_ = addr;
+        header_ = static_cast<const ShmHeader*>(addr);
+        
+        if (std::memcmp(header_->magic, ShmHeader::MAGIC, sizeof(header_->magic)) != 0 ||
+            header_->version != ShmHeader::VERSION ||
+            header_->slot_size != sizeof(ShmSlot) ||
+            header_->feature_count > ShmSlot::MAX_FEATURES ||
+            header_->slot_count == 0 ||
+            sizeof(ShmHeader) + static_cast<size_t>(header_->slot_count) * sizeof(ShmSlot) > size_) {
+            printf("[ML] /%s is not a compatible shared-memory segment\n", name.c_str());
+            close();
+            return false;
+        }
+        
+        slot_count_ = header_->slot_count;
+        abandoned_.reset(new std::atomic<bool>[slot_count_]);
+        for (uint32_t i = 0; i < slot_count_; ++i) {
+            abandoned_[i].store(false, std::memory_order_relaxed);
+        }
+        slots_ = reinterpret_cast<ShmSlot*>(static_cast<char*>(mapping_) + sizeof(ShmHeader));
+        pid_ = static_cast<uint32_t>(getpid());
+        
+        printf("[ML] Shared-memory transport: /%s, %u slots, model %s\n",
+               name.c_str(), slot_count_, model_version().c_str());
+        size_t orphaned = free_orphaned_slots();
+        if (orphaned > 0) {
+            printf("[ML] Freed %zu shared-memory slots left by exited clients\n", orphaned);
+        }
+        return true;
+#endif
+    }
+    
+    void close() {
+#ifndef _WIN32
+        if (mapping_ != nullptr) {
+            munmap(mapping_, size_);
+        }
+#endif
+        mapping_ = nullptr;
+        size_ = 0;
+        header_ = nullptr;
+        slots_ = nullptr;
+        slot_count_ = 0;
+        abandoned_.reset();
+    }
+    
+    // Longest a call waits for a free slot and for its answer.
+    void set_timeout(std::chrono::milliseconds timeout) {
+        timeout_ = timeout;
+    }
+    
+    bool is_open() const {
+        return header_ != nullptr;
+    }
+    
+    // The server refreshes its heartbeat several times a second.
+    bool check_health() override {
+        if (!is_open()) {
+            printf("[ML] Health check failed: shared memory not attached\n");
+            return false;
+        }
+        
+        int64_t age = heartbeat_age_ns();
+        if (age > HEARTBEAT_TIMEOUT_NS) {
+            printf("[ML] Health check failed: no server heartbeat for %.1f s\n", age / 1e9);
+            return false;
+        }
+        
+        printf("[ML] Health check: OK\n");
+        return true;
+    }
+    
+    std::string model_version() const override {
+        if (!is_open()) return std::string();
+        return std::string(header_->model_version,
+                           strnlen(header_->model_version, sizeof(header_->model_version)));
+    }
+    
+    MLPrediction predict(const std::string& symbol, std::time_t timestamp,
+                         const std::vector<double>& features) override {
+        (void)symbol;
+        
+        if (heartbeat_age_ns() > HEARTBEAT_TIMEOUT_NS) {
+            printf("[ML] Prediction failed: server not running\n");
+            return failure("Server not running");
+        }
+        
+        auto until = deadline();
+        ShmSlot* slot = claim(until);
+        if (slot == nullptr) {
+            printf("[ML] Prediction failed: no free shared-memory slot\n");
+            return failure("No free slot");
+        }
+        
+        post(*slot, timestamp, features.data(), features.size());
+        
+        if (!wait_until([slot]() { return answered(*slot); }, until)) {
+            abandon(*slot);
+            printf("[ML] Prediction failed: no answer from server\n");
+            return failure("Timeout");
+        }
+        return take(*slot);
+    }
+    
+    // Posts as many rows as there are free slots, then collects them, so the
+    // server predicts them together.
+    bool predict_batch(const double* features, size_t rows, size_t feature_count,
+                       std::vector<MLPrediction>& out) override {
+        out.assign(rows, MLPrediction());
+        if (heartbeat_age_ns() > HEARTBEAT_TIMEOUT_NS) {
+            printf("[ML] Batch prediction failed: server not running\n");
+            return false;
+        }
+        
+        std::vector<ShmSlot*> wave;
+        wave.reserve(slot_count_);
+        
+        size_t next = 0;
+        while (next < rows) {
+            auto until = deadline();
+            
+            wave.clear();
+            while (next + wave.size() < rows && wave.size() < slot_count_) {
+                // Wait only for the first slot of a wave
+                ShmSlot* slot = claim(wave.empty() ? until : std::chrono::steady_clock::now());
+                if (slot == nullptr) break;
+                
+                size_t row = next + wave.size();
+                post(*slot, 0, features + row * feature_count, feature_count);
+                wave.push_back(slot);
+            }
+            
+            if (wave.empty()) {
+                printf("[ML] Batch prediction failed: no free shared-memory slot\n");
+                return false;
+            }
+            
+            for (size_t i = 0; i < wave.size(); ++i) {
+                ShmSlot* slot = wave[i];
+                if (!wait_until([slot]() { return answered(*slot); }, until)) {
+                    // This slot and the rest of the wave are no longer awaited
+                    for (size_t j = i; j < wave.size(); ++j) {
+                        abandon(*wave[j]);
+                    }
+                    printf("[ML] Batch prediction failed: no answer from server\n");
+                    return false;
+                }
+                out[next + i] = take(*slot);
+            }
+            next += wave.size();
+        }
+        return true;
+    }
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+// Minimal non-owning view over contiguous elements (C++17 has no std::span).
+template<typename T>
+class Span {
+private:
+    T* data_;
+    size_t size_;
+    
+public:
+    Span() : data_(nullptr), size_(0) {}
+    
+    Span(T* data, size_t size) : data_(data), size_(size) {}
+    
+    T* data() const {
+        return data_;
+    }
+    
+    size_t size() const {
+        return size_;
+    }
+    
+    bool empty() const {
+        return size_ == 0;
+    }
+    
+    T& operator[](size_t index) const {
+        return data_[index];
+    }
+    
+    T* begin() const {
+        return data_;
+    }
+    
+    T* end() const {
+        return data_ + size_;
+    }
+    
+    Span subspan(size_t offset, size_t count) const {
+        if (offset > size_) offset = size_;
+        if (count > size_ - offset) count = size_ - offset;
+        return Span(data_ + offset, count);
+    }
+};
@@ -0,0 +1,343 @@
+#pragma once
+
+#include "Metrics.h"
+#include "Span.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// How a side of the ring waits when it cannot make progress.
+enum class WaitStrategy {
+    Blocking,  // Sleep on a condition variable right away
+    Spinning,  // Busy-poll (lowest latency, burns a core)
+    Hybrid     // Spin briefly, then yield, then block
+};
+
+inline const char* wait_strategy_name(WaitStrategy strategy) {
+    switch (strategy) {
+        case WaitStrategy::Blocking: return "blocking";
+        case WaitStrategy::Spinning: return "spin";
+        case WaitStrategy::Hybrid:   return "hybrid";
+    }
+    return "unknown";
+}
+
+inline void cpu_relax() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Bounded single-producer/single-consumer ring buffer.
+//
+// Head and tail live on separate cache lines and each side keeps a cached
+// copy of the other side's index, so in steady state a push or pop touches
+// no shared cache line except to publish. Exactly one thread may push and one
+// thread may pop at any time.
+//
+// finish() has the same meaning as ThreadSafeQueue::finish(): further pushes
+// fail, and the consumer drains what is left before pop() reports the end.
+//
+// With a wake-up metric set (and ALGO_METRICS), the time from a publish to
+// the consumer seeing it, after finding the ring empty, is recorded: how long
+// an idle consumer takes to react under its wait strategy.
+template<typename T>
+class SpscRingBuffer {
+private:
+    static constexpr size_t CACHE_LINE = 64;
+    static constexpr int SPIN_LIMIT = 4096;
+    static constexpr int YIELD_LIMIT = 64;
+    
+    // Consumer side
+    alignas(CACHE_LINE) std::atomic<size_t> head_{0};
+    size_t cached_tail_ = 0;
+    bool consumer_idle_ = false;  // Found the ring empty since its last item
+    
+    // Producer side
+    alignas(CACHE_LINE) std::atomic<size_t> tail_{0};
+    size_t cached_head_ = 0;
+    std::atomic<uint64_t> published_ns_{0};  // Of the last publish, for the wake-up metric
+    
+    // Shared, rarely written
+    alignas(CACHE_LINE) std::atomic<bool> finished_{false};
+    std::atomic<bool> consumer_waiting_{false};
+    std::atomic<bool> producer_waiting_{false};
+    WaitStrategy wait_strategy_;
+    MetricStage wakeup_metric_ = METRIC_STAGE_COUNT;  // None
+    size_t capacity_;
+    size_t mask_;
+    std::vector<T> buffer_;
+    
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+    
+    // Waits until ready() holds or the ring is finished, per wait strategy.
+    template<typename Ready>
+    void wait_for(Ready ready, std::atomic<bool>& waiting_flag, std::condition_variable& cv) {
+        if (wait_strategy_ != WaitStrategy::Blocking) {
+            for (int i = 0; i < SPIN_LIMIT; ++i) {
+                if (ready() || finished_.load(std::memory_order_acquire)) return;
+                cpu_relax();
+            }
+            
+            if (wait_strategy_ == WaitStrategy::Spinning) {
+                // Keep polling; yield now and then so an oversubscribed
+                // machine still makes progress
+                while (!ready() && !finished_.load(std::memory_order_acquire)) {
+                    for (int i = 0; i < SPIN_LIMIT && !ready(); ++i) {
+                        cpu_relax();
+                    }
+                    std::this_thread::yield();
+                }
+                return;
+            }
+            
+            for (int i = 0; i < YIELD_LIMIT; ++i) {
+                if (ready() || finished_.load(std::memory_order_acquire)) return;
+                std::this_thread::yield();
+            }
+        }
+        
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiting_flag.store(true, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait(lock, [&] {
+            return ready() || finished_.load(std::memory_order_acquire);
+        });
+        waiting_flag.store(false, std::memory_order_relaxed);
+    }
+    
+    static uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    
+    // Producer, just before publishing
+    void stamp_publish() {
+        if constexpr (METRICS_ENABLED) {
+            if (wakeup_metric_ != METRIC_STAGE_COUNT) {
+                published_ns_.store(now_ns(), std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    // Consumer, after looking for items: count is what it found
+    void note_wakeup(size_t count) {
+        if constexpr (METRICS_ENABLED) {
+            if (wakeup_metric_ == METRIC_STAGE_COUNT) return;
+            if (count == 0) {
+                consumer_idle_ = true;
+            } else if (consumer_idle_) {
+                consumer_idle_ = false;
+                uint64_t published = published_ns_.load(std::memory_order_relaxed);
+                uint64_t now = now_ns();
+                METRICS_RECORD(wakeup_metric_, now > published ? now - published : 0);
+            }
+        } else {
+            (void)count;
+        }
+    }
+    
+    void wake(std::atomic<bool>& waiting_flag, std::condition_variable& cv) {
+        if (wait_strategy_ == WaitStrategy::Spinning) return;
+        
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_flag.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv.notify_one();
+        }
+    }
+    
+    size_t free_slots() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t free = capacity_ - (tail - cached_head_);
+        if (free == 0) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            free = capacity_ - (tail - cached_head_);
+        }
+        return free;
+    }
+    
+    size_t available() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t count = cached_tail_ - head;
+        if (count == 0) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            count = cached_tail_ - head;
+        }
+        return count;
+    }
+    
+public:
+    explicit SpscRingBuffer(size_t capacity = 65536,
+                            WaitStrategy wait_strategy = WaitStrategy::Hybrid)
+        : wait_strategy_(wait_strategy),
+          capacity_(round_up_pow2(capacity < 2 ? 2 : capacity)),
+          mask_(capacity_ - 1),
+          buffer_(capacity_) {}
+    
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+    
+    // Producer: copies items in, waiting for space as needed. Returns the
+    // number pushed, which is less than items.size() only if finished.
+    size_t push_batch(Span<const T> items) {
+        size_t pushed = 0;
+        
+        while (pushed < items.size()) {
+            if (finished_.load(std::memory_order_acquire)) break;
+            
+            size_t free = free_slots();
+            if (free == 0) {
+                wait_for([this] { return free_slots() > 0; }, producer_waiting_, not_full_);
+                continue;
+            }
+            
+            size_t count = std::min(free, items.size() - pushed);
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            
+            for (size_t i = 0; i < count; ++i) {
+                buffer_[(tail + i) & mask_] = items[pushed + i];
+            }
+            
+            stamp_publish();
+            tail_.store(tail + count, std::memory_order_release);
+            pushed += count;
+            wake(consumer_waiting_, not_empty_);
+        }
+        
+        return pushed;
+    }
+    
+    bool push(const T& item) {
+        return push_batch(Span<const T>(&item, 1)) == 1;
+    }
+    
+    bool try_push(const T& item) {
+        if (finished_.load(std::memory_order_acquire) || free_slots() == 0) return false;
+        
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        buffer_[tail & mask_] = item;
+        stamp_publish();
+        tail_.store(tail + 1, std::memory_order_release);
+        wake(consumer_waiting_, not_empty_);
+        return true;
+    }
+    
+    // Consumer: waits for at least one item and copies out as many as fit.
+    // Returns 0 only once the ring is finished and drained.
+    size_t pop_batch(Span<T> out) {
+        if (out.empty()) return 0;
+        
+        size_t count = available();
+        if (count == 0) {
+            note_wakeup(0);
+            wait_for([this] { return available() > 0; }, consumer_waiting_, not_empty_);
+            count = available();
+            if (count == 0) return 0;  // Finished and empty
+        }
+        note_wakeup(count);
+        
+        count = std::min(count, out.size());
+        size_t head = head_.load(std::memory_order_relaxed);
+        
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = std::move(buffer_[(head + i) & mask_]);
+        }
+        
+        head_.store(head + count, std::memory_order_release);
+        wake(producer_waiting_, not_full_);
+        return count;
+    }
+    
+    // Consumer: copies out whatever is available without waiting.
+    size_t try_pop_batch(Span<T> out) {
+        size_t count = std::min(available(), out.size());
+        note_wakeup(count);
+        if (count == 0) return 0;
+        
+        size_t head = head_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = std::move(buffer_[(head + i) & mask_]);
+        }
+        
+        head_.store(head + count, std::memory_order_release);
+        wake(producer_waiting_, not_full_);
+        return count;
+    }
+    
+    std::optional<T> pop() {
+        T item;
+        if (pop_batch(Span<T>(&item, 1)) == 0) {
+            return std::nullopt;
+        }
+        return item;
+    }
+    
+    std::optional<T> try_pop() {
+        if (available() == 0) return std::nullopt;
+        
+        size_t head = head_.load(std::memory_order_relaxed);
+        T item = std::move(buffer_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        wake(producer_waiting_, not_full_);
+        return item;
+    }
+    
+    void finish() {
+        finished_.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(mutex_);
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+    
+    bool is_finished() const {
+        return finished_.load(std::memory_order_acquire);
+    }
+    
+    // Approximate when called concurrently with push/pop.
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+    
+    bool empty() const {
+        return size() == 0;
+    }
+    
+    size_t capacity() const {
+        return capacity_;
+    }
+    
+    WaitStrategy wait_strategy() const {
+        return wait_strategy_;
+    }
+    
+    // Records the consumer's wake-up latency under stage. Set before either
+    // side starts.
+    void set_wakeup_metric(MetricStage stage) {
+        wakeup_metric_ = stage;
+    }
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+using SymbolId = uint32_t;
+
+// Process-wide ticker interning table. Tickers are mapped to dense ids at
+// ingest time; the hot path only carries ids and names are resolved back at
+// the logging/reporting edges.
+class SymbolTable {
+private:
+    mutable std::shared_mutex mutex_;
+    std::deque<std::string> names_;  // deque keeps references stable on growth
+    std::unordered_map<std::string, SymbolId> ids_;
+    
+    SymbolTable() = default;
+    
+public:
+    static constexpr SymbolId INVALID_ID = 0xFFFFFFFFu;
+    
+    static SymbolTable& instance() {
+        static SymbolTable table;
+        return table;
+    }
+    
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+    
+    SymbolId intern(const char* data, size_t length) {
+        // Rows from one file are usually the same ticker; skip the lookup
+        thread_local const std::string* last_name = nullptr;
+        thread_local SymbolId last_id = INVALID_ID;
+        
+        if (last_name != nullptr && last_name->size() == length &&
+            last_name->compare(0, length, data, length) == 0) {
+            return last_id;
+        }
+        
+        std::string key(data, length);
+        SymbolId id;
+        
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            auto it = ids_.find(key);
+            if (it != ids_.end()) {
+                id = it->second;
+                last_name = &names_[id];
+                last_id = id;
+                return id;
+            }
+        }
+        
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto it = ids_.find(key);
+        if (it != ids_.end()) {
+            id = it->second;
+        } else {
+            id = static_cast<SymbolId>(names_.size());
+            names_.push_back(key);
+            ids_.emplace(std::move(key), id);
+        }
+        
+        last_name = &names_[id];
+        last_id = id;
+        return id;
+    }
+    
+    SymbolId intern(const std::string& name) {
+        return intern(name.data(), name.size());
+    }
+    
+    // Returns INVALID_ID if the ticker was never interned.
+    SymbolId find(const std::string& name) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = ids_.find(name);
+        return (it != ids_.end()) ? it->second : INVALID_ID;
+    }
+    
+    const std::string& name(SymbolId id) const {
+        static const std::string unknown = "?";
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return (id < names_.size()) ? names_[id] : unknown;
+    }
+    
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return names_.size();
+    }
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing thread pool.
+//
+// Every worker owns a deque. Tasks submitted from outside are dealt round
+// robin; tasks submitted from a worker go to its own deque. A worker runs its
+// own tasks newest first and, when it runs dry, steals the oldest task from
+// another worker, so long and short tasks even out across threads.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+    
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> threads_;
+    
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable all_done_;
+    std::atomic<size_t> queued_;   // Tasks sitting in a deque
+    std::atomic<size_t> pending_;  // Tasks queued or running
+    std::atomic<size_t> next_queue_;
+    bool stopping_;
+    
+    // Index of the calling thread in this pool, SIZE_MAX for other threads.
+    struct WorkerSlot {
+        const ThreadPool* pool = nullptr;
+        size_t index = SIZE_MAX;
+    };
+    
+    static WorkerSlot& current_worker() {
+        thread_local WorkerSlot slot;
+        return slot;
+    }
+    
+    bool pop_own(size_t index, Task& task) {
+        WorkQueue& queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+    
+    bool steal(size_t thief, Task& task) {
+        for (size_t i = 1; i < queues_.size(); ++i) {
+            WorkQueue& queue = *queues_[(thief + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+    
+    void worker_loop(size_t index) {
+        current_worker() = WorkerSlot{this, index};
+        Task task;
+        
+        while (true) {
+            if (pop_own(index, task) || steal(index, task)) {
+                queued_.fetch_sub(1);
+                task();
+                task = nullptr;
+                
+                if (pending_.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    all_done_.notify_all();
+                }
+                continue;
+            }
+            
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_available_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+            if (stopping_ && queued_.load() == 0) return;
+        }
+    }
+    
+public:
+    // thread_count 0 = one thread per hardware thread.
+    explicit ThreadPool(size_t thread_count = 0)
+        : queued_(0), pending_(0), next_queue_(0), stopping_(false) {
+        if (thread_count == 0) {
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        
+        for (size_t i = 0; i < thread_count; ++i) {
+            queues_.push_back(std::make_unique<WorkQueue>());
+        }
+        for (size_t i = 0; i < thread_count; ++i) {
+            threads_.emplace_back([this, i]() { worker_loop(i); });
+        }
+    }
+    
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_available_.notify_all();
+        
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    void submit(Task task) {
+        size_t index = current_worker().index;
+        if (current_worker().pool != this) {
+            index = next_queue_.fetch_add(1) % queues_.size();
+        }
+        
+        pending_.fetch_add(1);
+        {
+            // Queue and count under mutex_ so a worker about to sleep sees both
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::lock_guard<std::mutex> queue_lock(queues_[index]->mutex);
+            queues_[index]->tasks.push_back(std::move(task));
+            queued_.fetch_add(1);
+        }
+        work_available_.notify_one();
+    }
+    
+    // Blocks until every submitted task has finished.
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        all_done_.wait(lock, [this] { return pending_.load() == 0; });
+    }
+    
+    size_t thread_count() const {
+        return threads_.size();
+    }
+};
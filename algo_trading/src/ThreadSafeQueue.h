@@ -5,21 +5,41 @@
 #include <condition_variable>
 #include <optional>
 
+// Capacity 0 means unbounded. With a capacity, push() blocks while the queue
+// is full so a fast producer cannot run ahead of the consumer.
 template<typename T>
 class ThreadSafeQueue {
 private:
     std::queue<T> queue_;
     mutable std::mutex mutex_;
     std::condition_variable cond_var_;
+    std::condition_variable not_full_;
+    size_t capacity_;
     bool finished_ = false;
     
 public:
-    void push(T item) {
+    explicit ThreadSafeQueue(size_t capacity = 0)
+        : capacity_(capacity) {}
+    
+    // Returns false if the queue was finished before the item could be added.
+    bool push(T item) {
         {
-            std::lock_guard<std::mutex> lock(mutex_);
+            std::unique_lock<std::mutex> lock(mutex_);
+            
+            if (capacity_ > 0) {
+                not_full_.wait(lock, [this] {
+                    return queue_.size() < capacity_ || finished_;
+                });
+            }
+            
+            if (finished_) {
+                return false;
+            }
+            
             queue_.push(std::move(item));
         }
         cond_var_.notify_one();
+        return true;
     }
     
     std::optional<T> pop() {
@@ -35,6 +55,11 @@ public:
         
         T item = std::move(queue_.front());
         queue_.pop();
+        lock.unlock();
+        
+        if (capacity_ > 0) {
+            not_full_.notify_one();
+        }
         return item;
     }
     
@@ -47,6 +72,10 @@ public:
         
         T item = std::move(queue_.front());
         queue_.pop();
+        
+        if (capacity_ > 0) {
+            not_full_.notify_one();
+        }
         return item;
     }
     
@@ -56,6 +85,7 @@ public:
             finished_ = true;
         }
         cond_var_.notify_all();
+        not_full_.notify_all();
     }
     
     bool empty() const {
@@ -68,6 +98,10 @@ public:
         return queue_.size();
     }
     
+    size_t capacity() const {
+        return capacity_;
+    }
+    
     bool is_finished() const {
         std::lock_guard<std::mutex> lock(mutex_);
         return finished_;
@@ -0,0 +1,349 @@
+#pragma once
+
+#include "MarketDataEvent.h"
+#include "MappedFile.h"
+#include "Span.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary columnar tick store.
+//
+// Layout (native little-endian):
+//   TickStoreHeader
+//   symbol dictionary: [uint32 length][bytes] per symbol, ids are positions
+//   one column per field, each starting on a 64-byte boundary
+//
+// Columns are plain arrays, so a reader can serve them straight out of the
+// mapping without copying.
+struct TickStoreHeader {
+    static constexpr char MAGIC[8] = {'A', 'L', 'G', 'O', 'T', 'I', 'C', 'K'};
+    static constexpr uint32_t VERSION = 1;
+    
+    enum Column : uint32_t {
+        TIMESTAMP = 0, SYMBOL, OPEN, HIGH, LOW, CLOSE, ADJ_CLOSE, VOLUME, BID, ASK,
+        COLUMN_COUNT
+    };
+    
+    char magic[8];
+    uint32_t version;
+    uint32_t symbol_count;
+    uint64_t row_count;
+    uint64_t dict_offset;
+    uint64_t dict_size;
+    uint64_t column_offset[COLUMN_COUNT];
+};
+
+class TickStoreWriter {
+private:
+    std::vector<int64_t> timestamp_;
+    std::vector<uint32_t> symbol_;
+    std::vector<double> open_, high_, low_, close_, adj_close_;
+    std::vector<int64_t> volume_;
+    std::vector<double> bid_, ask_;
+    
+    std::vector<std::string> symbols_;
+    std::vector<uint32_t> local_ids_;  // SymbolId -> dictionary position
+    
+    template<typename T>
+    static void write_column(std::ofstream& out, const std::vector<T>& column) {
+        out.write(reinterpret_cast<const char*>(column.data()),
+                  static_cast<std::streamsize>(column.size() * sizeof(T)));
+    }
+    
+    static void pad_to(std::ofstream& out, uint64_t& offset, uint64_t alignment) {
+        static const char zeros[64] = {};
+        uint64_t padding = (alignment - offset % alignment) % alignment;
+        out.write(zeros, static_cast<std::streamsize>(padding));
+        offset += padding;
+    }
+    
+public:
+    void reserve(size_t rows) {
+        timestamp_.reserve(rows);
+        symbol_.reserve(rows);
+        open_.reserve(rows);
+        high_.reserve(rows);
+        low_.reserve(rows);
+        close_.reserve(rows);
+        adj_close_.reserve(rows);
+        volume_.reserve(rows);
+        bid_.reserve(rows);
+        ask_.reserve(rows);
+    }
+    
+    void append(const MarketDataEvent& event) {
+        if (event.symbol_id >= local_ids_.size()) {
+            local_ids_.resize(event.symbol_id + 1, SymbolTable::INVALID_ID);
+        }
+        
+        uint32_t id = local_ids_[event.symbol_id];
+        if (id == SymbolTable::INVALID_ID) {
+            id = static_cast<uint32_t>(symbols_.size());
+            symbols_.push_back(event.symbol());
+            local_ids_[event.symbol_id] = id;
+        }
+        
+        timestamp_.push_back(static_cast<int64_t>(event.timestamp));
+        symbol_.push_back(id);
+        open_.push_back(event.open);
+        high_.push_back(event.high);
+        low_.push_back(event.low);
+        close_.push_back(event.close);
+        adj_close_.push_back(event.adj_close);
+        volume_.push_back(static_cast<int64_t>(event.volume));
+        bid_.push_back(event.bid);
+        ask_.push_back(event.ask);
+    }
+    
+    size_t size() const {
+        return timestamp_.size();
+    }
+    
+    bool save(const std::string& filename) const {
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        
+        if (!out.is_open()) {
+            printf("[ERROR] Could not open file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        TickStoreHeader header = {};
+        std::memcpy(header.magic, TickStoreHeader::MAGIC, sizeof(header.magic));
+        header.version = TickStoreHeader::VERSION;
+        header.symbol_count = static_cast<uint32_t>(symbols_.size());
+        header.row_count = timestamp_.size();
+        
+        // Header is rewritten once the offsets are known
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t offset = sizeof(header);
+        
+        header.dict_offset = offset;
+        for (const auto& symbol : symbols_) {
+            uint32_t length = static_cast<uint32_t>(symbol.size());
+            out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            out.write(symbol.data(), length);
+            offset += sizeof(length) + length;
+        }
+        header.dict_size = offset - header.dict_offset;
+        
+        auto column = [&](TickStoreHeader::Column index, const auto& values) {
+            pad_to(out, offset, 64);
+            header.column_offset[index] = offset;
+            write_column(out, values);
+            offset += values.size() * sizeof(values[0]);
+        };
+        
+        column(TickStoreHeader::TIMESTAMP, timestamp_);
+        column(TickStoreHeader::SYMBOL, symbol_);
+        column(TickStoreHeader::OPEN, open_);
+        column(TickStoreHeader::HIGH, high_);
+        column(TickStoreHeader::LOW, low_);
+        column(TickStoreHeader::CLOSE, close_);
+        column(TickStoreHeader::ADJ_CLOSE, adj_close_);
+        column(TickStoreHeader::VOLUME, volume_);
+        column(TickStoreHeader::BID, bid_);
+        column(TickStoreHeader::ASK, ask_);
+        
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        
+        if (!out.good()) {
+            printf("[ERROR] Failed writing tick store: %s\n", filename.c_str());
+            return false;
+        }
+        
+        return true;
+    }
+    
+    // One-shot conversion from the CSV layout read by Utils::load_csv.
+    static bool convert_csv(const std::string& csv_file, const std::string& tick_file) {
+        MappedFile file;
+        
+        if (!file.open(csv_file)) {
+            printf("[ERROR] Could not open file: %s\n", csv_file.c_str());
+            return false;
+        }
+        
+        TickStoreWriter writer;
+        writer.reserve(file.size() / 128);
+        
+        const char* p = file.begin();
+        const char* end = file.end();
+        bool header = true;
+        size_t skipped = 0;
+        MarketDataEvent event;
+        
+        while (p < end) {
+            const char* line_end;
+            const char* next = Utils::next_line(p, end, line_end);
+            
+            if (header) {
+                header = false;
+            }
+            else if (Utils::parse_csv_row(p, line_end, event)) {
+                writer.append(event);
+            }
+            else {
+                ++skipped;
+            }
+            
+            p = next;
+        }
+        
+        if (!writer.save(tick_file)) {
+            return false;
+        }
+        
+        printf("[INFO] Converted %zu rows (%zu skipped, %zu symbols) from %s to %s\n",
+               writer.size(), skipped, writer.symbols_.size(),
+               csv_file.c_str(), tick_file.c_str());
+        return true;
+    }
+};
+
+class TickStoreReader {
+private:
+    MappedFile file_;
+    const TickStoreHeader* header_ = nullptr;
+    std::vector<std::string> symbols_;
+    std::vector<SymbolId> symbol_ids_;  // Dictionary position -> interned id
+    
+    template<typename T>
+    Span<const T> column(TickStoreHeader::Column index) const {
+        if (header_ == nullptr) return Span<const T>();
+        return Span<const T>(
+            reinterpret_cast<const T*>(file_.data() + header_->column_offset[index]),
+            static_cast<size_t>(header_->row_count));
+    }
+    
+public:
+    bool open(const std::string& filename) {
+        header_ = nullptr;
+        symbols_.clear();
+        symbol_ids_.clear();
+        
+        if (!file_.open(filename)) {
+            printf("[ERROR] Could not open file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        if (file_.size() < sizeof(TickStoreHeader)) {
+            printf("[ERROR] Not a tick store file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        auto header = reinterpret_cast<const TickStoreHeader*>(file_.data());
+        
+        if (std::memcmp(header->magic, TickStoreHeader::MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != TickStoreHeader::VERSION) {
+            printf("[ERROR] Not a tick store file (bad magic/version): %s\n", filename.c_str());
+            return false;
+        }
+        
+        static const size_t widths[TickStoreHeader::COLUMN_COUNT] = {
+            sizeof(int64_t), sizeof(uint32_t),
+            sizeof(double), sizeof(double), sizeof(double), sizeof(double), sizeof(double),
+            sizeof(int64_t), sizeof(double), sizeof(double)
+        };
+        
+        auto truncated = [&filename]() {
+            printf("[ERROR] Truncated tick store file: %s\n", filename.c_str());
+            return false;
+        };
+        
+        // Written as subtractions so a corrupt offset or count cannot wrap
+        const uint64_t size = file_.size();
+        for (uint32_t c = 0; c < TickStoreHeader::COLUMN_COUNT; ++c) {
+            uint64_t offset = header->column_offset[c];
+            if (offset > size || header->row_count > (size - offset) / widths[c]) {
+                return truncated();
+            }
+        }
+        
+        if (header->dict_offset > size || header->dict_size > size - header->dict_offset) {
+            return truncated();
+        }
+        
+        const char* p = file_.data() + header->dict_offset;
+        const char* dict_end = p + header->dict_size;
+        // Each entry takes at least its length field
+        symbols_.reserve(std::min<uint64_t>(header->symbol_count, header->dict_size / sizeof(uint32_t)));
+        
+        for (uint32_t i = 0; i < header->symbol_count; ++i) {
+            uint32_t length;
+            if (dict_end - p < static_cast<std::ptrdiff_t>(sizeof(length))) return truncated();
+            std::memcpy(&length, p, sizeof(length));
+            p += sizeof(length);
+            if (dict_end - p < static_cast<std::ptrdiff_t>(length)) return truncated();
+            symbols_.emplace_back(p, length);
+            symbol_ids_.push_back(SymbolTable::instance().intern(symbols_.back()));
+            p += length;
+        }
+        
+        // Checked once here so event() and the sources can index freely
+        header_ = header;
+        for (uint32_t local_id : symbol_ids()) {
+            if (local_id >= header->symbol_count) {
+                printf("[ERROR] Tick store row names symbol %u of %u: %s\n", local_id,
+                       header->symbol_count, filename.c_str());
+                header_ = nullptr;
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    size_t size() const {
+        return header_ ? static_cast<size_t>(header_->row_count) : 0;
+    }
+    
+    const std::vector<std::string>& symbols() const {
+        return symbols_;
+    }
+    
+    Span<const int64_t> timestamps() const { return column<int64_t>(TickStoreHeader::TIMESTAMP); }
+    // Positions into symbols(); see interned_id() for the process-wide id
+    Span<const uint32_t> symbol_ids() const { return column<uint32_t>(TickStoreHeader::SYMBOL); }
+    
+    SymbolId interned_id(uint32_t local_id) const {
+        return symbol_ids_[local_id];
+    }
+    Span<const double> open() const { return column<double>(TickStoreHeader::OPEN); }
+    Span<const double> high() const { return column<double>(TickStoreHeader::HIGH); }
+    Span<const double> low() const { return column<double>(TickStoreHeader::LOW); }
+    Span<const double> close() const { return column<double>(TickStoreHeader::CLOSE); }
+    Span<const double> adj_close() const { return column<double>(TickStoreHeader::ADJ_CLOSE); }
+    Span<const int64_t> volume() const { return column<int64_t>(TickStoreHeader::VOLUME); }
+    Span<const double> bid() const { return column<double>(TickStoreHeader::BID); }
+    Span<const double> ask() const { return column<double>(TickStoreHeader::ASK); }
+    
+    MarketDataEvent event(size_t row) const {
+        return MarketDataEvent(
+            static_cast<std::time_t>(timestamps()[row]),
+            symbol_ids_[symbol_ids()[row]],
+            open()[row], high()[row], low()[row], close()[row], adj_close()[row],
+            static_cast<long long>(volume()[row]), bid()[row], ask()[row]);
+    }
+    
+    std::vector<MarketDataEvent> load_events() const {
+        std::vector<MarketDataEvent> events;
+        events.reserve(size());
+        
+        for (size_t row = 0; row < size(); ++row) {
+            events.push_back(event(row));
+        }
+        
+        return events;
+    }
+    
+    static bool is_tick_store(const std::string& filename) {
+        const std::string ext = ".tick";
+        return filename.size() >= ext.size() &&
+               filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+    }
+};
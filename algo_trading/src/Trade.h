@@ -1,34 +1,89 @@
 #pragma once
 
+#include "SymbolTable.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <ctime>
+#include <type_traits>
 
+enum class Side : uint8_t {
+    Buy,
+    Sell
+};
+
+inline const char* side_name(Side side) {
+    return side == Side::Buy ? "BUY" : "SELL";
+}
+
+// Warns that a value too long for its trades.csv field was cut, once per
+// field: warned is that field's flag.
+inline void warn_cut_once(std::atomic<bool>& warned, const char* what, size_t limit,
+                          const std::string& value) {
+    if (!warned.exchange(true)) {
+        printf("[WARNING] %s longer than %zu characters is cut in trades.csv: %s\n",
+               what, limit, value.c_str());
+    }
+}
+
+// Fixed-size and trivially copyable so trades can be handed to the writer
+// thread through a ring buffer without allocating. Strategy and model names
+// are stored inline: strategies up to 31 characters, model versions (the
+// server reports its model file path) up to 159. A longer value is cut to
+// fit, with a warning the first time for each field.
 struct Trade {
     std::time_t timestamp;
-    std::string strategy;
-    std::string symbol;
-    std::string side;  // "BUY" or "SELL"
+    SymbolId symbol_id;
+    Side side;
     int quantity;
+    int position_after;
     double price;
     double cash_after;
-    int position_after;
     
     // ML prediction data
     int ml_prediction;
     double ml_score;
     double ml_prob_buy;
-    std::string model_version;
+    
+    char strategy[32];        // NUL-terminated
+    char model_version[160];  // NUL-terminated
     
     Trade()
-        : timestamp(0), strategy(""), symbol(""), side(""),
-          quantity(0), price(0), cash_after(0), position_after(0),
-          ml_prediction(0), ml_score(0), ml_prob_buy(0), model_version("") {}
+        : timestamp(0), symbol_id(SymbolTable::INVALID_ID), side(Side::Buy),
+          quantity(0), position_after(0), price(0), cash_after(0),
+          ml_prediction(0), ml_score(0), ml_prob_buy(0), strategy{}, model_version{} {}
     
-    Trade(std::time_t ts, const std::string& strat, const std::string& sym,
-          const std::string& sd, int qty, double px, double cash, int pos,
+    Trade(std::time_t ts, const std::string& strat, SymbolId sym,
+          Side sd, int qty, double px, double cash, int pos,
           int ml_pred, double ml_sc, double ml_pb, const std::string& mv)
-        : timestamp(ts), strategy(strat), symbol(sym), side(sd),
-          quantity(qty), price(px), cash_after(cash), position_after(pos),
-          ml_prediction(ml_pred), ml_score(ml_sc), ml_prob_buy(ml_pb),
-          model_version(mv) {}
+        : timestamp(ts), symbol_id(sym), side(sd),
+          quantity(qty), position_after(pos), price(px), cash_after(cash),
+          ml_prediction(ml_pred), ml_score(ml_sc), ml_prob_buy(ml_pb) {
+        static std::atomic<bool> strategy_cut{false};
+        static std::atomic<bool> model_version_cut{false};
+        copy_name(strategy, sizeof(strategy), strat, "Strategy name", strategy_cut);
+        copy_name(model_version, sizeof(model_version), mv, "Model version", model_version_cut);
+    }
+    
+    const std::string& symbol() const {
+        return SymbolTable::instance().name(symbol_id);
+    }
+    
+private:
+    static void copy_name(char* out, size_t size, const std::string& name, const char* what,
+                          std::atomic<bool>& warned) {
+        size_t length = std::min(name.size(), size - 1);
+        std::memcpy(out, name.data(), length);
+        std::memset(out + length, 0, size - length);
+        
+        if (length < name.size()) {
+            warn_cut_once(warned, what, size - 1, name);
+        }
+    }
 };
+
+static_assert(std::is_trivially_copyable<Trade>::value, "Trade must stay trivially copyable");
+static_assert(sizeof(Trade) == 256, "Trade layout changed");
@@ -1,55 +1,371 @@
 #pragma once
 
 #include "Trade.h"
-#include <fstream>
-#include <vector>
+#include "CheckpointState.h"
+#include "LowLatency.h"
+#include "SpscRingBuffer.h"
+#include "Metrics.h"
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
+
+// Formats trades as trades.csv rows. Numbers come out exactly as the
+// original std::ofstream << did: integers in decimal, doubles like %g
+// (6 significant digits), via std::to_chars instead of locale-aware streams.
+class TradeCsvFormatter {
+public:
+    static constexpr const char* HEADER =
+        "timestamp,strategy,symbol,side,qty,price,cash_after,position_after,"
+        "ml_prediction,ml_score,ml_prob_buy,model_version\n";
+    
+    // Longest row append() can produce
+    static constexpr size_t MAX_ROW = 1024;
+    
+    // Longer symbols are cut, with a warning the first time
+    static constexpr size_t SYMBOL_LENGTH = 64;
+    
+    // Appends one row; out must have MAX_ROW bytes free.
+    static char* append(char* out, const Trade& trade) {
+        out = put_int(out, static_cast<long long>(trade.timestamp));
+        out = put_text(out, trade.strategy, sizeof(trade.strategy));
+        const std::string& symbol = trade.symbol();
+        if (symbol.size() > SYMBOL_LENGTH) {
+            static std::atomic<bool> symbol_cut{false};
+            warn_cut_once(symbol_cut, "Symbol", SYMBOL_LENGTH, symbol);
+        }
+        out = put_text(out, symbol.c_str(), SYMBOL_LENGTH);
+        out = put_text(out, side_name(trade.side));
+        out = put_int(out, trade.quantity);
+        out = put_double(out, trade.price);
+        out = put_double(out, trade.cash_after);
+        out = put_int(out, trade.position_after);
+        out = put_int(out, trade.ml_prediction);
+        out = put_double(out, trade.ml_score);
+        out = put_double(out, trade.ml_prob_buy);
+        out = put_text(out, trade.model_version, sizeof(trade.model_version));
+        out[-1] = '\n';  // Replaces the last separator
+        return out;
+    }
+    
+private:
+    static char* put_int(char* out, long long value) {
+        out = std::to_chars(out, out + 24, value).ptr;
+        *out++ = ',';
+        return out;
+    }
+    
+    static char* put_double(char* out, double value) {
+        out = std::to_chars(out, out + 32, value, std::chars_format::general, 6).ptr;
+        *out++ = ',';
+        return out;
+    }
+    
+    static char* put_text(char* out, const char* text, size_t max_length = 63) {
+        for (size_t i = 0; i < max_length && text[i] != '\0'; ++i) {
+            *out++ = text[i];
+        }
+        *out++ = ',';
+        return out;
+    }
+};
 
+// Records executed trades.
+//
+// By default trades are kept in memory and written by save_to_csv(). After
+// open(), each trade is instead handed to a writer thread through a ring
+// buffer and streamed to the file: the logging thread only copies a 256-byte
+// record, and the writer formats into a large buffer that it writes out when
+// full and at least every flush interval, so a crash loses at most that much.
+// An idle writer sleeps a millisecond between polls, or with set_writer()
+// busy-polls on its own core instead.
+// Trades must be logged from one thread at a time.
 class TradeLogger {
 private:
-    std::vector<Trade> trades_;
+    static constexpr size_t RING_CAPACITY = 4096;
+    static constexpr size_t WRITE_BUFFER = 1 << 20;
+    static constexpr int YIELD_EVERY = 4096;  // Idle busy-polls between yields
+    
+    std::vector<Trade> trades_;  // In-memory mode
+    size_t count_ = 0;
+    
+    // Streaming mode
+    std::string filename_;
+    FILE* file_ = nullptr;
+    std::unique_ptr<SpscRingBuffer<Trade>> ring_;
+    std::chrono::milliseconds flush_interval_{100};
+    std::atomic<bool> write_failed_{false};
+    std::atomic<size_t> written_{0};  // Trades in the file
+    std::thread writer_;
+    int writer_cpu_ = -1;
+    bool busy_poll_ = false;
+    
+    static bool write_all(FILE* file, const char* data, size_t size) {
+        return fwrite(data, 1, size, file) == size && fflush(file) == 0;
+    }
+    
+    void start_writer(const std::string& filename, std::chrono::milliseconds flush_interval) {
+        filename_ = filename;
+        flush_interval_ = flush_interval;
+        write_failed_ = false;
+        written_ = count_;
+        // The producer never sleeps on the ring, so pushing costs no syscall;
+        // the writer polls instead of blocking
+        ring_ = std::make_unique<SpscRingBuffer<Trade>>(RING_CAPACITY, WaitStrategy::Spinning);
+        ring_->set_wakeup_metric(METRIC_LOGGER_WAKEUP);
+        writer_ = std::thread([this]() {
+            LowLatency::prepare_thread(writer_cpu_, "logger");
+            writer_loop();
+        });
+    }
+    
+    void writer_loop() {
+        std::vector<char> buffer(WRITE_BUFFER + TradeCsvFormatter::MAX_ROW);
+        std::vector<Trade> batch(256);
+        char* out = buffer.data();
+        size_t buffered = 0;
+        auto last_flush = std::chrono::steady_clock::now();
+        int idle_polls = 0;
+        
+        auto flush = [&]() {
+            if (out != buffer.data() && !write_failed_) {
+                if (write_all(file_, buffer.data(), static_cast<size_t>(out - buffer.data()))) {
+                    written_.fetch_add(buffered, std::memory_order_release);
+                } else {
+                    write_failed_ = true;
+                }
+            }
+            out = buffer.data();
+            buffered = 0;
+            last_flush = std::chrono::steady_clock::now();
+        };
+        
+        while (true) {
+            size_t count = ring_->try_pop_batch(Span<Trade>(batch.data(), batch.size()));
+            
+            for (size_t i = 0; i < count; ++i) {
+                out = TradeCsvFormatter::append(out, batch[i]);
+                ++buffered;
+                if (static_cast<size_t>(out - buffer.data()) >= WRITE_BUFFER) {
+                    flush();
+                }
+            }
+            
+            if (count > 0) {
+                idle_polls = 0;
+                continue;
+            }
+            
+            // Idle: finished() is checked before the final drain, so no
+            // trade pushed before close() is missed
+            if (ring_->is_finished() && ring_->empty()) break;
+            
+            if (std::chrono::steady_clock::now() - last_flush >= flush_interval_) {
+                flush();
+            }
+            if (!busy_poll_) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            } else if (++idle_polls % YIELD_EVERY == 0) {
+                std::this_thread::yield();  // Still progress on a shared core
+            } else {
+                cpu_relax();
+            }
+        }
+        flush();
+    }
     
 public:
+    TradeLogger() = default;
+    
+    ~TradeLogger() {
+        close();
+    }
+    
+    TradeLogger(const TradeLogger&) = delete;
+    TradeLogger& operator=(const TradeLogger&) = delete;
+    
+    // Must be called before open() or reopen(). Pins the writer thread to
+    // cpu (-1 = any) and, with busy_poll, keeps it polling when idle.
+    void set_writer(int cpu, bool busy_poll) {
+        writer_cpu_ = cpu;
+        busy_poll_ = busy_poll;
+    }
+    
+    // Starts streaming trades to filename (header first). Returns false if
+    // the file cannot be created.
+    bool open(const std::string& filename,
+              std::chrono::milliseconds flush_interval = std::chrono::milliseconds(100)) {
+        close();
+        
+        file_ = fopen(filename.c_str(), "wb");
+        if (file_ == nullptr) {
+            printf("[ERROR] Could not open file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        if (!write_all(file_, TradeCsvFormatter::HEADER, std::strlen(TradeCsvFormatter::HEADER))) {
+            printf("[ERROR] Could not write file: %s\n", filename.c_str());
+            fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+        
+        start_writer(filename, flush_interval);
+        return true;
+    }
+    
+    // Continues streaming to an existing filename after its first count()
+    // trades, dropping any rows past them. Used after load_state(), when the
+    // run that wrote the file got further than its checkpoint. Returns false
+    // if the file holds fewer trades.
+    bool reopen(const std::string& filename,
+                std::chrono::milliseconds flush_interval = std::chrono::milliseconds(100)) {
+        close();
+        
+        FILE* file = fopen(filename.c_str(), "rb");
+        if (file == nullptr) {
+            printf("[ERROR] Could not open file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        // The header line plus count_ rows are kept
+        std::vector<char> buffer(1 << 16);
+        size_t keep = count_ + 1;
+        size_t lines = 0;
+        uint64_t offset = 0;
+        size_t length;
+        while (lines < keep && (length = fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+            const char* p = buffer.data();
+            const char* end = p + length;
+            while (lines < keep) {
+                const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+                if (newline == nullptr) {
+                    p = end;
+                    break;
+                }
+                ++lines;
+                p = newline + 1;
+            }
+            offset += static_cast<uint64_t>(p - buffer.data());
+        }
+        fclose(file);
+        
+        if (lines < keep) {
+            printf("[ERROR] %s holds %zu trades, the checkpoint expects %zu\n", filename.c_str(),
+                   lines > 0 ? lines - 1 : 0, count_);
+            return false;
+        }
+        
+        std::error_code error;
+        std::filesystem::resize_file(filename, offset, error);
+        file_ = error ? nullptr : fopen(filename.c_str(), "ab");
+        if (file_ == nullptr) {
+            printf("[ERROR] Could not write file: %s\n", filename.c_str());
+            return false;
+        }
+        
+        start_writer(filename, flush_interval);
+        return true;
+    }
+    
+    // Writes out everything logged so far and closes the file. Returns false
+    // if anything could not be written. Does nothing unless open().
+    bool close() {
+        if (file_ == nullptr) return true;
+        
+        ring_->finish();
+        writer_.join();
+        bool ok = !write_failed_ && fclose(file_) == 0;
+        file_ = nullptr;
+        ring_.reset();
+        
+        if (ok) {
+            printf("[INFO] Saved %zu trades to: %s\n", count_, filename_.c_str());
+        } else {
+            printf("[ERROR] Could not write file: %s\n", filename_.c_str());
+        }
+        return ok;
+    }
+    
+    bool is_streaming() const {
+        return file_ != nullptr;
+    }
+    
     void log_trade(const Trade& trade) {
-        trades_.push_back(trade);
+        METRICS_SCOPE(METRIC_TRADE_LOG);
+        ++count_;
+        if (file_ != nullptr) {
+            ring_->push(trade);  // Waits only if the writer is 4096 trades behind
+        } else {
+            trades_.push_back(trade);
+        }
     }
     
+    // Writes the in-memory trades to filename.
     void save_to_csv(const std::string& filename) {
-        std::ofstream file(filename);
+        METRICS_SCOPE(METRIC_TRADE_LOG);
+        FILE* file = fopen(filename.c_str(), "wb");
         
-        if (!file.is_open()) {
+        if (file == nullptr) {
             printf("[ERROR] Could not open file: %s\n", filename.c_str());
             return;
         }
         
-        // Write header
-        file << "timestamp,strategy,symbol,side,qty,price,cash_after,position_after,"
-             << "ml_prediction,ml_score,ml_prob_buy,model_version\n";
+        std::vector<char> buffer(WRITE_BUFFER + TradeCsvFormatter::MAX_ROW);
+        bool ok = write_all(file, TradeCsvFormatter::HEADER, std::strlen(TradeCsvFormatter::HEADER));
         
-        // Write trades
-        for (const auto& trade : trades_) {
-            file << trade.timestamp << ","
-                 << trade.strategy << ","
-                 << trade.symbol << ","
-                 << trade.side << ","
-                 << trade.quantity << ","
-                 << trade.price << ","
-                 << trade.cash_after << ","
-                 << trade.position_after << ","
-                 << trade.ml_prediction << ","
-                 << trade.ml_score << ","
-                 << trade.ml_prob_buy << ","
-                 << trade.model_version << "\n";
+        char* out = buffer.data();
+        for (size_t i = 0; i < trades_.size() && ok; ++i) {
+            out = TradeCsvFormatter::append(out, trades_[i]);
+            if (static_cast<size_t>(out - buffer.data()) >= WRITE_BUFFER || i + 1 == trades_.size()) {
+                ok = write_all(file, buffer.data(), static_cast<size_t>(out - buffer.data()));
+                out = buffer.data();
+            }
         }
         
-        file.close();
+        if (fclose(file) != 0 || !ok) {
+            printf("[ERROR] Could not write file: %s\n", filename.c_str());
+            return;
+        }
         printf("[INFO] Saved %zu trades to: %s\n", trades_.size(), filename.c_str());
     }
     
+    // Trades logged so far, in either mode.
     size_t count() const {
-        return trades_.size();
+        return count_;
+    }
+    
+    // Trades written to the file so far while streaming. Safe to call from
+    // any thread.
+    size_t written() const {
+        return written_.load(std::memory_order_acquire);
+    }
+    
+    // The trade count, plus the trades themselves when they are kept in
+    // memory. A streaming log resumes with reopen() after load_state().
+    void save_state(StateWriter& state) const {
+        state.put<uint64_t>(count_);
+        state.put_vector(trades_);
+    }
+    
+    bool load_state(StateReader& state) {
+        uint64_t count = 0;
+        if (!state.get(count) || !state.get_vector(trades_)) return false;
+        for (Trade& trade : trades_) {
+            trade.symbol_id = state.symbol(trade.symbol_id);
+            if (trade.symbol_id == SymbolTable::INVALID_ID) return state.fail("missing a symbol");
+        }
+        count_ = static_cast<size_t>(count);
+        return true;
     }
     
+    // In-memory trades; empty while streaming.
     const std::vector<Trade>& get_trades() const {
         return trades_;
     }
@@ -2,6 +2,7 @@
 
 #include "MarketDataEvent.h"
 #include "Portfolio.h"
+#include "CheckpointState.h"
 #include <memory>
 #include <string>
 
@@ -9,6 +10,7 @@ class TradingStrategy {
 protected:
     std::shared_ptr<Portfolio> portfolio_;
     std::string name_;
+    bool verbose_ = true;
     
 public:
     TradingStrategy(std::shared_ptr<Portfolio> portfolio, const std::string& name)
@@ -18,7 +20,41 @@ public:
     
     virtual void on_market_data(const MarketDataEvent& event) = 0;
     
+    // Engines call this once per event: marks the portfolio to the bar's
+    // close, then runs the strategy.
+    void on_event(const MarketDataEvent& event) {
+        portfolio_->mark(event.symbol_id, event.close);
+        on_market_data(event);
+    }
+    
+    // Called once after the last event, before results are read. Strategies
+    // that defer work (such as outstanding predictions) complete it here.
+    virtual void on_finish() {}
+    
+    // Checkpointing: saves the strategy name and the portfolio. Strategies
+    // with state of their own extend both, and load into an instance
+    // configured like the one saved.
+    virtual void save_state(StateWriter& state) const {
+        state.put_string(name_);
+        portfolio_->save_state(state);
+    }
+    
+    virtual bool load_state(StateReader& state) {
+        std::string name;
+        if (!state.get_string(name)) return false;
+        if (name != name_) {
+            printf("[ERROR] Checkpoint is for strategy %s, not %s\n", name.c_str(), name_.c_str());
+            return state.fail("for another strategy");
+        }
+        return portfolio_->load_state(state);
+    }
+    
     std::string get_name() const {
         return name_;
     }
+    
+    // Turns off per-event console output (used when many runs share stdout).
+    void set_verbose(bool verbose) {
+        verbose_ = verbose;
+    }
 };
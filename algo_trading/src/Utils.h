@@ -1,80 +1,177 @@
 #pragma once
 
 #include "MarketDataEvent.h"
+#include "MappedFile.h"
 #include <vector>
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <cstring>
+#include <charconv>
+#include <chrono>
 #include <ctime>
 
 class Utils {
 public:
+    // Days since 1970-01-01 for a proleptic Gregorian date (Howard Hinnant's
+    // days_from_civil). Avoids mktime, which is slow and applies the local zone.
+    static long long days_from_civil(int year, int month, int day) {
+        year -= month <= 2 ? 1 : 0;
+        const long long era = (year >= 0 ? year : year - 399) / 400;
+        const unsigned yoe = static_cast<unsigned>(year - era * 400);
+        const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<long long>(doe) - 719468;
+    }
+    
+    // Fixed-format parser for ISO-8601 UTC timestamps: 2020-01-02T09:30:00Z.
+    // A trailing 'Z' is optional. Returns false on anything else.
+    static bool parse_timestamp(const char* begin, const char* end, std::time_t& out) {
+        if (end - begin < 19) {
+            return false;
+        }
+        
+        const char* p = begin;
+        if (p[4] != '-' || p[7] != '-' || (p[10] != 'T' && p[10] != ' ') ||
+            p[13] != ':' || p[16] != ':') {
+            return false;
+        }
+        
+        auto digits = [p](int pos, int count, int& value) {
+            value = 0;
+            for (int i = 0; i < count; ++i) {
+                unsigned d = static_cast<unsigned>(p[pos + i] - '0');
+                if (d > 9) return false;
+                value = value * 10 + static_cast<int>(d);
+            }
+            return true;
+        };
+        
+        int year, month, day, hour, minute, second;
+        if (!digits(0, 4, year) || !digits(5, 2, month) || !digits(8, 2, day) ||
+            !digits(11, 2, hour) || !digits(14, 2, minute) || !digits(17, 2, second)) {
+            return false;
+        }
+        
+        if (month < 1 || month > 12 || day < 1 || day > 31 ||
+            hour > 23 || minute > 59 || second > 60) {
+            return false;
+        }
+        
+        long long days = days_from_civil(year, month, day);
+        out = static_cast<std::time_t>(days * 86400 + hour * 3600 + minute * 60 + second);
+        return true;
+    }
+    
     static std::time_t parse_timestamp(const std::string& timestamp_str) {
-        // Simple parser for ISO format: 2020-01-02T09:30:00Z
-        std::tm tm = {};
-        std::istringstream ss(timestamp_str);
+        std::time_t ts = 0;
+        parse_timestamp(timestamp_str.data(), timestamp_str.data() + timestamp_str.size(), ts);
+        return ts;
+    }
+    
+    // Finds the end of the line starting at p (without '\n' or '\r\n') and
+    // returns the start of the following line.
+    static const char* next_line(const char* p, const char* end, const char*& line_end) {
+        const char* eol = static_cast<const char*>(
+            std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        line_end = eol ? eol : end;
+        
+        if (line_end > p && line_end[-1] == '\r') {
+            --line_end;
+        }
+        
+        return eol ? eol + 1 : end;
+    }
+    
+    // Parses one data row (no trailing newline) in place. Column order is
+    // timestamp,symbol,open,high,low,close,adj_close,volume,bid,ask.
+    static bool parse_csv_row(const char* begin, const char* end, MarketDataEvent& event) {
+        const char* fields[10];
+        const char* field_ends[10];
+        
+        const char* p = begin;
+        for (int i = 0; i < 10; ++i) {
+            const char* comma = static_cast<const char*>(
+                std::memchr(p, ',', static_cast<size_t>(end - p)));
+            fields[i] = p;
+            
+            if (comma == nullptr) {
+                field_ends[i] = end;
+                if (i != 9) return false;  // Too few columns
+            } else {
+                field_ends[i] = comma;
+                p = comma + 1;
+            }
+        }
+        
+        auto parse_double = [&](int i, double& value) {
+            if (fields[i] == field_ends[i]) return false;
+            auto res = std::from_chars(fields[i], field_ends[i], value);
+            return res.ec == std::errc();
+        };
         
-        // Parse YYYY-MM-DDTHH:MM:SSZ
-        char dash1, dash2, T, colon1, colon2, Z;
-        ss >> tm.tm_year >> dash1 >> tm.tm_mon >> dash2 >> tm.tm_mday
-           >> T >> tm.tm_hour >> colon1 >> tm.tm_min >> colon2 >> tm.tm_sec >> Z;
+        if (!parse_timestamp(fields[0], field_ends[0], event.timestamp)) return false;
+        if (fields[1] == field_ends[1]) return false;
+        if (!parse_double(2, event.open)) return false;
+        if (!parse_double(3, event.high)) return false;
+        if (!parse_double(4, event.low)) return false;
+        if (!parse_double(5, event.close)) return false;
+        if (!parse_double(6, event.adj_close)) return false;
         
-        tm.tm_year -= 1900;  // Years since 1900
-        tm.tm_mon -= 1;      // Months since January
-        tm.tm_isdst = 0;
+        if (fields[7] == field_ends[7]) return false;
+        auto vol = std::from_chars(fields[7], field_ends[7], event.volume);
+        if (vol.ec != std::errc()) return false;
         
-        return std::mktime(&tm);
+        if (!parse_double(8, event.bid)) return false;
+        if (!parse_double(9, event.ask)) return false;
+        
+        event.symbol_id = SymbolTable::instance().intern(
+            fields[1], static_cast<size_t>(field_ends[1] - fields[1]));
+        return true;
     }
     
     static std::vector<MarketDataEvent> load_csv(const std::string& filename) {
         std::vector<MarketDataEvent> events;
-        std::ifstream file(filename);
+        MappedFile file;
         
-        if (!file.is_open()) {
+        if (!file.open(filename)) {
             printf("[ERROR] Could not open file: %s\n", filename.c_str());
             return events;
         }
         
-        std::string line;
-        std::getline(file, line);  // Skip header
+        auto start_time = std::chrono::steady_clock::now();
         
-        while (std::getline(file, line)) {
-            std::stringstream ss(line);
-            std::string timestamp_str, symbol, open_str, high_str, low_str,
-                        close_str, adj_close_str, volume_str, bid_str, ask_str;
-            
-            std::getline(ss, timestamp_str, ',');
-            std::getline(ss, symbol, ',');
-            std::getline(ss, open_str, ',');
-            std::getline(ss, high_str, ',');
-            std::getline(ss, low_str, ',');
-            std::getline(ss, close_str, ',');
-            std::getline(ss, adj_close_str, ',');
-            std::getline(ss, volume_str, ',');
-            std::getline(ss, bid_str, ',');
-            std::getline(ss, ask_str, ',');
+        const char* p = file.begin();
+        const char* end = file.end();
+        
+        // Rough row estimate from the file size to avoid regrowth
+        events.reserve(file.size() / 128);
+        
+        bool header = true;
+        MarketDataEvent event;
+        
+        while (p < end) {
+            const char* line_end;
+            const char* next = next_line(p, end, line_end);
             
-            try {
-                std::time_t timestamp = parse_timestamp(timestamp_str);
-                double open = std::stod(open_str);
-                double high = std::stod(high_str);
-                double low = std::stod(low_str);
-                double close = std::stod(close_str);
-                double adj_close = std::stod(adj_close_str);
-                long long volume = std::stoll(volume_str);
-                double bid = std::stod(bid_str);
-                double ask = std::stod(ask_str);
-                
-                events.emplace_back(timestamp, symbol, open, high, low, close,
-                                    adj_close, volume, bid, ask);
+            if (header) {
+                header = false;  // Skip header
+            }
+            else if (parse_csv_row(p, line_end, event)) {
+                events.push_back(event);
             }
-            catch (const std::exception& e) {
-                printf("[WARNING] Skipping invalid line: %s\n", line.c_str());
+            else {
+                printf("[WARNING] Skipping invalid line: %.*s\n",
+                       static_cast<int>(line_end - p), p);
             }
+            
+            p = next;
         }
         
-        file.close();
-        printf("[INFO] Loaded %zu events from: %s\n", events.size(), filename.c_str());
+        double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start_time).count();
+        double rows_per_sec = seconds > 0 ? events.size() / seconds : 0.0;
+        
+        printf("[INFO] Loaded %zu events from: %s (%.3f s, %.0f rows/s)\n",
+               events.size(), filename.c_str(), seconds, rows_per_sec);
         
         return events;
     }
@@ -1,73 +1,779 @@
 #include "MarketDataEvent.h"
 #include "BacktestingEngine.h"
+#include "ShardedBacktestingEngine.h"
+#include "ParameterSweep.h"
+#include "FeatureKernel.h"
+#include "PrecomputedPredictor.h"
+#include "PredictionCache.h"
+#include "AsyncMLClient.h"
+#include "ShmPredictor.h"
+#include "CircuitBreaker.h"
+#include "Metrics.h"
+#include "RandomForest.h"
 #include "Portfolio.h"
+#include "PerformanceAnalytics.h"
+#include "Checkpoint.h"
 #include "TradeLogger.h"
 #include "TradingStrategy.h"
 #include "MovingAverageStrategy.h"
 #include "Utils.h"
+#include "TickStore.h"
+#include "MarketDataSource.h"
+#include "FeedHandler.h"
+#include "FeedReplayServer.h"
+#include "LowLatency.h"
 #include <iostream>
 #include <memory>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
 
-int main() {
+static void print_usage(const char* program) {
+    printf("Usage:\n");
+    printf("  %s [options] [data_file...]       Run a backtest (.csv or .tick); several\n", program);
+    printf("                      files or directories of them are merged by timestamp\n");
+    printf("  %s --convert <csv_file> <tick_file>  Convert CSV to the binary tick store\n", program);
+    printf("  %s --sweep-grid <shorts> <longs> <thresholds> [options] [data_file...]\n", program);
+    printf("  %s --sweep-file <configs.csv> [options] [data_file...]\n", program);
+    printf("                      Run many MovingAverage configurations in parallel\n");
+    printf("  %s --check-features [data_file...]  Compare the feature kernel with the per-bar path\n", program);
+    printf("  %s --serve-feed <url> [options] [data_file...]\n", program);
+    printf("                      Stream data files as a network feed (tcp://host:port, or\n");
+    printf("                      udp://host:port for unicast or multicast UDP)\n");
+    printf("\nOptions:\n");
+    printf("  --window <events>   Max events buffered ahead of the strategy (default 65536)\n");
+    printf("  --chunk <events>    Events read from the file per batch (default 4096)\n");
+    printf("  --wait <mode>       Engine queue wait: blocking, spin or hybrid (default hybrid);\n");
+    printf("                      spin also busy-polls the trade log writer and the feed\n");
+    printf("  --cpus <p,e,l>      Pin the producer, engine and trade log writer threads to\n");
+    printf("                      these cores (\"-\" leaves one unpinned), e.g. 2,3,4\n");
+    printf("  --lock-memory       Lock the process's memory so the hot path never page-faults\n");
+    printf("  --low-latency       Same as --wait spin --lock-memory\n");
+    printf("  --replay <mode>     max (no pacing), realtime (timestamp gaps / speed) or step\n");
+    printf("  --speed <factor>    Speed factor for --replay realtime (default 1.0)\n");
+    printf("  --max-events <n>    Stop after n events (default 0 = whole file)\n");
+    printf("  --feed <url>        Run against a live feed instead of data files\n");
+    printf("  --feed-timeout <s>  End the feed after s seconds without data (default 5,\n");
+    printf("                      0 = wait for ever)\n");
+    printf("  --rate <events/s>   Pace --serve-feed at a fixed rate; --replay realtime paces\n");
+    printf("                      it by timestamps instead (default: as fast as possible)\n");
+    printf("  --ticks             --serve-feed sends ticks (close, volume) instead of bars\n");
+    printf("  --shards <n>        Partition symbols across n worker threads; each symbol\n");
+    printf("                      trades its own cash, trades.csv is the same for any n\n");
+    printf("  --model <file>      Evaluate an exported forest (.forest) in process instead of\n");
+    printf("                      calling the ML server\n");
+    printf("  --batch-inference   Fetch all predictions up front via /predict_batch, then replay\n");
+    printf("  --transport <t>     Reach the ML server over http (default) or shm (shared\n");
+    printf("                      memory, same machine; falls back to http if unavailable)\n");
+    printf("  --async <n>         Keep up to 2n predictions in flight over n server connections\n");
+    printf("  --deadline <ms>     Give each prediction ms to answer; after 3 misses in a row\n");
+    printf("                      stop calling the model until it is healthy again\n");
+    printf("                      (not with --batch-inference, which has no per-bar calls)\n");
+    printf("  --fallback <s>      Signal for bars without a prediction: none (skip, default),\n");
+    printf("                      ma (short/long MA crossover) or last (last prediction)\n");
+    printf("  --cache <file>      Keep model answers in a prediction cache file; repeat runs\n");
+    printf("                      against the same model version skip inference\n");
+    printf("  --metrics <secs>    Also print the per-stage latency report every secs seconds\n");
+    printf("                      (it is always printed at exit in builds with ALGO_METRICS)\n");
+    printf("  --threads <n>       Sweep worker threads (default: all cores)\n");
+    printf("  --sweep-out <file>  Sweep summary file (default sweep_results.csv)\n");
+    printf("  --checkpoint <file> Snapshot engine, strategy and portfolio state to file every\n");
+    printf("                      --checkpoint-every seconds (default 10) and at the end\n");
+    printf("  --resume            Continue from the --checkpoint file; run with the same data\n");
+    printf("                      and options, trades.csv is cut back to the checkpoint\n");
+}
+
+// Restores engine from checkpoint_file and moves source past the events it
+// had processed. Returns false if the checkpoint does not fit this run.
+static bool resume_from_checkpoint(BacktestingEngine& engine, MarketDataSource& source,
+                                   const std::string& checkpoint_file, StreamOptions& stream_options) {
+    auto start = std::chrono::steady_clock::now();
+    
+    CheckpointHeader header;
+    std::vector<char> payload;
+    if (!CheckpointWriter::load(checkpoint_file, header, payload)) {
+        return false;
+    }
+    
+    StateReader state(payload.data(), payload.size());
+    if (!state.get_symbols() || !engine.load_state(state)) {
+        return false;
+    }
+    if (!state.at_end()) {
+        return state.fail("longer than this build expects");
+    }
+    
+    // The last event skipped must be the one the checkpoint ended on
+    size_t events = static_cast<size_t>(header.events);
+    MarketDataEvent last = engine.last_event();
+    std::vector<MarketDataEvent> check;
+    if (events == 0 || source.skip(events - 1) != events - 1 || source.read(check, 1) != 1 ||
+        check[0].timestamp != last.timestamp || check[0].symbol_id != last.symbol_id ||
+        check[0].close != last.close) {
+        printf("[ERROR] %s is not the data the checkpoint was taken on\n", source.name().c_str());
+        return false;
+    }
+    
+    if (stream_options.max_events > 0) {
+        if (stream_options.max_events <= events) {
+            printf("[ERROR] The checkpoint is already past --max-events\n");
+            return false;
+        }
+        stream_options.max_events -= events;
+    }
+    
+    printf("[INFO] Resumed from %s: %zu events, %llu trades, last at %lld (%.1f ms)\n",
+           checkpoint_file.c_str(), events, static_cast<unsigned long long>(header.trades),
+           static_cast<long long>(header.timestamp),
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+// Once the source is open and the hot buffers and threads exist, so they
+// are locked but files mapped later are not.
+static void lock_hot_memory(bool enabled) {
+    if (enabled && LowLatency::lock_memory()) {
+        printf("[INFO] Memory locked\n");
+    }
+}
+
+// Streams source to feed_url until it is exhausted.
+static int run_feed_server(MarketDataSource& source, const std::string& feed_url,
+                           const FeedReplayOptions& options, bool lock_memory) {
+    FeedAddress address;
+    FeedReplayServer server;
+    if (!FeedAddress::parse(feed_url, address) || !server.open(address, options)) {
+        printf("[ERROR] Could not open the feed. Exiting.\n");
+        return 1;
+    }
+    lock_hot_memory(lock_memory);
+    
+    printf("[INFO] Serving %s", source.name().c_str());
+    if (options.rate > 0) printf(" at %.0f events/s", options.rate);
+    else if (options.replay == ReplayMode::ScaledRealTime) printf(" in real time x%.1f", options.speed);
+    printf("\n");
+    
+    server.run(source);
+    return 0;
+}
+
+// Same five steps as the single-engine run, on a ShardedBacktestingEngine.
+static int run_sharded(std::unique_ptr<MarketDataSource> source, size_t shards,
+                       double initial_cash, const std::string& trades_file, size_t window,
+                       WaitStrategy wait_strategy, ReplayMode replay_mode, double replay_speed,
+                       const StreamOptions& stream_options,
+                       std::shared_ptr<Predictor> predictor, size_t pipeline_depth,
+                       FallbackSignal fallback, bool lock_memory) {
+    printf("[2/5] Initializing components (%zu shards)...\n", shards);
+    
+    ShardedBacktestingEngine engine(
+        shards, initial_cash,
+        [predictor, pipeline_depth, fallback](std::shared_ptr<Portfolio> portfolio) {
+            auto strategy = std::make_shared<MovingAverageStrategy>(portfolio, 10, 50, 0.7, predictor);
+            strategy->set_pipeline_depth(pipeline_depth);
+            strategy->set_fallback(fallback);
+            return strategy;
+        },
+        window, wait_strategy);
+    engine.set_replay(replay_mode, replay_speed);
+    
+    printf("[INFO] Components initialized\n\n");
+    
+    printf("[3/5] Starting backtesting engine...\n");
+    engine.start();
+    lock_hot_memory(lock_memory);
+    
+    printf("[INFO] Engine started\n\n");
+    
+    printf("[4/5] Processing market events...\n");
+    printf("========================================\n\n");
+    engine.stream_from(std::move(source), stream_options);
+    engine.wait_for_stream();
+    
+    printf("\n========================================\n");
+    printf("[INFO] All events processed\n\n");
+    
+    printf("[5/5] Finalizing...\n");
+    engine.stop();
+    
+    size_t trade_count = engine.save_trades(trades_file);
+    
+    printf("\n");
+    engine.print_summary(engine.final_prices());
+    
+    printf("\n========================================\n");
+    printf("  BACKTESTING COMPLETE!\n");
+    printf("========================================\n");
+    printf("\nResults saved to: %s\n", trades_file.c_str());
+    printf("Total trades executed: %zu\n\n", trade_count);
+    
+    return 0;
+}
+
+static int run_sweep(MarketDataSource& source, const std::vector<SweepConfig>& configs,
+                     size_t threads, double initial_cash, const std::string& out_file,
+                     size_t max_events, std::shared_ptr<Predictor> predictor) {
+    if (configs.empty()) {
+        printf("[ERROR] No valid sweep configurations. Exiting.\n");
+        return 1;
+    }
+    
+    printf("Loading market data...\n");
+    ParameterSweep sweep(initial_cash);
+    sweep.set_predictor(predictor);
+    if (!sweep.load(source, max_events)) {
+        printf("[ERROR] No market data loaded. Exiting.\n");
+        return 1;
+    }
+    
+    printf("\nRunning sweep...\n");
+    auto start = std::chrono::steady_clock::now();
+    std::vector<SweepResult> results = sweep.run(configs, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    printf("[INFO] %zu configurations in %.2f s\n\n", results.size(), seconds);
+    ParameterSweep::save_results(results, out_file);
+    
+    std::vector<SweepResult> ranked = results;
+    std::stable_sort(ranked.begin(), ranked.end(), [](const SweepResult& a, const SweepResult& b) {
+        return a.pnl > b.pnl;
+    });
+    
+    printf("\n=== TOP CONFIGURATIONS ===\n");
+    printf("%6s %6s %9s %7s %12s %8s %8s %7s\n",
+           "short", "long", "threshold", "trades", "P&L", "P&L %", "max DD", "sharpe");
+    for (size_t i = 0; i < ranked.size() && i < 10; ++i) {
+        const SweepResult& r = ranked[i];
+        printf("%6d %6d %9.2f %7zu %12.2f %7.2f%% %7.2f%% %7.2f\n",
+               r.config.short_period, r.config.long_period, r.config.ml_threshold,
+               r.trades, r.pnl, r.pnl_pct, r.max_drawdown_pct, r.sharpe);
+    }
+    printf("==========================\n");
+    
+    return 0;
+}
+
+// Computes the strategy features per symbol three ways - per bar with
+// FeatureCalculator, and with FeatureKernel's scalar and AVX2 paths - and
+// checks that they agree. Returns 0 on success.
+static int run_feature_check(MarketDataSource& source, size_t max_events) {
+    const int short_period = 10;
+    const int long_period = 50;
+    const double tolerance = 1e-9;
+    
+    std::vector<MarketDataEvent> events;
+    while (max_events == 0 || events.size() < max_events) {
+        size_t want = (max_events > 0) ? std::min<size_t>(65536, max_events - events.size()) : 65536;
+        if (source.read(events, want) == 0) break;
+    }
+    
+    std::map<SymbolId, std::pair<std::vector<double>, std::vector<double>>> series;
+    for (const auto& event : events) {
+        auto& [close, volume] = series[event.symbol_id];
+        close.push_back(event.close);
+        volume.push_back(static_cast<double>(event.volume));
+    }
+    
+    printf("[INFO] Checking features for %zu events, %zu symbols (AVX2: %s)\n",
+           events.size(), series.size(), FeatureKernel::avx2_available() ? "yes" : "no");
+    
+    FeatureKernel kernel(short_period, long_period);
+    double per_bar_seconds = 0.0;
+    double scalar_seconds = 0.0;
+    double simd_seconds = 0.0;
+    double max_error = 0.0;
+    bool ok = true;
+    
+    for (const auto& [symbol, columns] : series) {
+        const auto& [close, volume] = columns;
+        size_t n = close.size();
+        std::vector<double> per_bar(n * FEATURE_COUNT, 0.0);
+        std::vector<double> scalar(n * FEATURE_COUNT);
+        std::vector<double> simd(n * FEATURE_COUNT);
+        
+        auto start = std::chrono::steady_clock::now();
+        FeatureCalculator calculator(short_period, long_period);
+        size_t ready = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (calculator.update(close[i], volume[i], &per_bar[i * FEATURE_COUNT])) {
+                ++ready;
+            } else if (i >= kernel.first_row()) {
+                ok = false;
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        size_t rows = kernel.compute(close.data(), volume.data(), n, scalar.data(),
+                                     FeatureKernel::Path::Scalar);
+        auto t2 = std::chrono::steady_clock::now();
+        kernel.compute(close.data(), volume.data(), n, simd.data(), FeatureKernel::Path::Avx2);
+        auto t3 = std::chrono::steady_clock::now();
+        
+        per_bar_seconds += std::chrono::duration<double>(t1 - start).count();
+        scalar_seconds += std::chrono::duration<double>(t2 - t1).count();
+        simd_seconds += std::chrono::duration<double>(t3 - t2).count();
+        
+        if (rows != ready || scalar != simd) {
+            printf("[ERROR] %s: kernel paths disagree (rows %zu vs %zu per bar)\n",
+                   SymbolTable::instance().name(symbol).c_str(), rows, ready);
+            ok = false;
+        }
+        
+        for (size_t i = 0; i < per_bar.size(); ++i) {
+            double scale = std::max(1.0, std::fabs(per_bar[i]));
+            max_error = std::max(max_error, std::fabs(per_bar[i] - scalar[i]) / scale);
+        }
+    }
+    
+    double bars = static_cast<double>(events.size());
+    printf("[INFO] Per bar: %.1f ns/bar, kernel scalar: %.1f ns/bar, kernel AVX2: %.1f ns/bar\n",
+           per_bar_seconds * 1e9 / bars, scalar_seconds * 1e9 / bars, simd_seconds * 1e9 / bars);
+    printf("[INFO] Max difference kernel vs per bar: %.3g (tolerance %.0e)\n", max_error, tolerance);
+    
+    ok = ok && max_error <= tolerance;
+    printf(ok ? "[INFO] Feature check passed\n" : "[ERROR] Feature check failed\n");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> data_files;
+    size_t window = 65536;
+    WaitStrategy wait_strategy = WaitStrategy::Hybrid;
+    
+    ReplayMode replay_mode = ReplayMode::MaxSpeed;
+    double replay_speed = 1.0;
+    StreamOptions stream_options;
+    size_t shards = 0;  // 0 = single engine, shared cash
+    
+    std::vector<SweepConfig> sweep_configs;
+    bool sweep = false;
+    size_t sweep_threads = 0;
+    std::string sweep_out = "sweep_results.csv";
+    bool check_features = false;
+    bool batch_inference = false;
+    std::string model_file;
+    std::string cache_file;
+    size_t async_connections = 0;  // 0 = one blocking request at a time
+    std::string transport = "http";
+    long deadline_ms = 0;  // 0 = no deadline
+    FallbackSignal fallback = FallbackSignal::None;
+    long metrics_interval = 0;  // Seconds, 0 = only at exit
+    std::string checkpoint_file;
+    double checkpoint_every = 10.0;  // Seconds
+    bool resume = false;
+    std::string feed_url;
+    std::string serve_feed_url;
+    double feed_timeout = 5.0;  // Seconds, 0 = never
+    FeedReplayOptions feed_options;
+    CpuPlacement cpus;
+    bool lock_memory = false;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (arg == "--convert") {
+            if (argc != 4 || i != 1) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            return TickStoreWriter::convert_csv(argv[2], argv[3]) ? 0 : 1;
+        }
+        else if (arg == "--window" && i + 1 < argc) {
+            window = std::stoul(argv[++i]);
+        }
+        else if (arg == "--chunk" && i + 1 < argc) {
+            stream_options.chunk_size = std::max<size_t>(1, std::stoul(argv[++i]));
+        }
+        else if (arg == "--wait" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "blocking") wait_strategy = WaitStrategy::Blocking;
+            else if (mode == "spin") wait_strategy = WaitStrategy::Spinning;
+            else if (mode == "hybrid") wait_strategy = WaitStrategy::Hybrid;
+            else {
+                printf("[ERROR] Unknown wait mode: %s\n", mode.c_str());
+                return 1;
+            }
+        }
+        else if (arg == "--cpus" && i + 1 < argc) {
+            if (!CpuPlacement::parse(argv[++i], cpus)) return 1;
+        }
+        else if (arg == "--lock-memory") {
+            lock_memory = true;
+        }
+        else if (arg == "--low-latency") {
+            wait_strategy = WaitStrategy::Spinning;
+            lock_memory = true;
+        }
+        else if (arg == "--replay" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "max") replay_mode = ReplayMode::MaxSpeed;
+            else if (mode == "realtime") replay_mode = ReplayMode::ScaledRealTime;
+            else if (mode == "step") replay_mode = ReplayMode::Stepped;
+            else {
+                printf("[ERROR] Unknown replay mode: %s\n", mode.c_str());
+                return 1;
+            }
+        }
+        else if (arg == "--speed" && i + 1 < argc) {
+            replay_speed = std::stod(argv[++i]);
+        }
+        else if (arg == "--max-events" && i + 1 < argc) {
+            stream_options.max_events = std::stoul(argv[++i]);
+        }
+        else if (arg == "--shards" && i + 1 < argc) {
+            shards = std::max<size_t>(1, std::stoul(argv[++i]));
+        }
+        else if (arg == "--sweep-grid" && i + 3 < argc) {
+            auto configs = ParameterSweep::grid(argv[i + 1], argv[i + 2], argv[i + 3]);
+            sweep_configs.insert(sweep_configs.end(), configs.begin(), configs.end());
+            sweep = true;
+            i += 3;
+        }
+        else if (arg == "--sweep-file" && i + 1 < argc) {
+            auto configs = ParameterSweep::load_list(argv[++i]);
+            sweep_configs.insert(sweep_configs.end(), configs.begin(), configs.end());
+            sweep = true;
+        }
+        else if (arg == "--model" && i + 1 < argc) {
+            model_file = argv[++i];
+        }
+        else if (arg == "--transport" && i + 1 < argc) {
+            transport = argv[++i];
+            if (transport != "http" && transport != "shm") {
+                printf("[ERROR] Unknown transport: %s\n", transport.c_str());
+                return 1;
+            }
+        }
+        else if (arg == "--deadline" && i + 1 < argc) {
+            deadline_ms = std::max(0L, std::stol(argv[++i]));
+        }
+        else if (arg == "--fallback" && i + 1 < argc) {
+            std::string signal = argv[++i];
+            if (signal == "none") fallback = FallbackSignal::None;
+            else if (signal == "ma") fallback = FallbackSignal::MovingAverageCross;
+            else if (signal == "last") fallback = FallbackSignal::LastPrediction;
+            else {
+                printf("[ERROR] Unknown fallback signal: %s\n", signal.c_str());
+                return 1;
+            }
+        }
+        else if (arg == "--async" && i + 1 < argc) {
+            async_connections = std::max<size_t>(1, std::stoul(argv[++i]));
+        }
+        else if (arg == "--cache" && i + 1 < argc) {
+            cache_file = argv[++i];
+        }
+        else if (arg == "--batch-inference") {
+            batch_inference = true;
+        }
+        else if (arg == "--check-features") {
+            check_features = true;
+        }
+        else if (arg == "--metrics" && i + 1 < argc) {
+            metrics_interval = std::max(0L, std::stol(argv[++i]));
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            sweep_threads = std::stoul(argv[++i]);
+        }
+        else if (arg == "--sweep-out" && i + 1 < argc) {
+            sweep_out = argv[++i];
+        }
+        else if (arg == "--checkpoint" && i + 1 < argc) {
+            checkpoint_file = argv[++i];
+        }
+        else if (arg == "--checkpoint-every" && i + 1 < argc) {
+            checkpoint_every = std::max(0.0, std::stod(argv[++i]));
+        }
+        else if (arg == "--resume") {
+            resume = true;
+        }
+        else if (arg == "--feed" && i + 1 < argc) {
+            feed_url = argv[++i];
+        }
+        else if (arg == "--feed-timeout" && i + 1 < argc) {
+            feed_timeout = std::max(0.0, std::stod(argv[++i]));
+        }
+        else if (arg == "--serve-feed" && i + 1 < argc) {
+            serve_feed_url = argv[++i];
+        }
+        else if (arg == "--rate" && i + 1 < argc) {
+            feed_options.rate = std::max(0.0, std::stod(argv[++i]));
+        }
+        else if (arg == "--ticks") {
+            feed_options.ticks = true;
+        }
+        else if (!arg.empty() && arg[0] == '-') {
+            printf("[ERROR] Unknown option: %s\n", arg.c_str());
+            print_usage(argv[0]);
+            return 1;
+        }
+        else {
+            data_files.push_back(arg);
+        }
+    }
+    
+    if (data_files.empty()) {
+        data_files.push_back("data/sample_AAPL.csv");
+    }
+    
+    if (resume && checkpoint_file.empty()) {
+        printf("[ERROR] --resume needs --checkpoint <file>\n");
+        return 1;
+    }
+    if (!checkpoint_file.empty() && (sweep || shards > 0 || check_features)) {
+        printf("[ERROR] --checkpoint only applies to a single-engine backtest\n");
+        return 1;
+    }
+    if (resume && !feed_url.empty()) {
+        printf("[ERROR] --resume needs the data files the checkpoint was taken on, not a feed\n");
+        return 1;
+    }
+    if (cpus.any() && (sweep || shards > 0 || check_features || !serve_feed_url.empty())) {
+        printf("[WARNING] --cpus only applies to a single-engine backtest; ignored\n");
+    }
+    if (lock_memory && (sweep || check_features)) {
+        printf("[WARNING] --lock-memory only applies to a backtest or --serve-feed; ignored\n");
+    }
+    if (batch_inference && deadline_ms > 0) {
+        // One request covers the whole file; a per-bar budget would fail it
+        printf("[WARNING] --deadline ignored with --batch-inference: predictions are fetched up front\n");
+        deadline_ms = 0;
+    }
+    
+    if (!serve_feed_url.empty()) {
+        auto source = MarketDataSource::open(data_files);
+        if (!source) {
+            printf("[ERROR] Could not open market data. Exiting.\n");
+            return 1;
+        }
+        feed_options.replay = replay_mode;
+        feed_options.speed = replay_speed;
+        feed_options.max_events = stream_options.max_events;
+        return run_feed_server(*source, serve_feed_url, feed_options, lock_memory);
+    }
+    
     printf("\n");
     printf("========================================\n");
     printf("  ALGORITHMIC TRADING BACKTESTER\n");
     printf("  ML-Integrated System\n");
     printf("========================================\n\n");
     
+    // Reports once more when main returns, after everything else has stopped
+    MetricsReporter metrics_reporter{std::chrono::seconds(metrics_interval)};
+    
     // Configuration
-    const std::string data_file = "data/sample_AAPL.csv";
     const std::string trades_file = "trades.csv";
+    const std::string equity_curve_file = "equity_curve.csv";
     const double initial_cash = 10000.0;
     
     // Step 1: Load market data
-    printf("[1/5] Loading market data...\n");
-    auto events = Utils::load_csv(data_file);
+    printf("[1/5] Opening market data...\n");
+    std::unique_ptr<MarketDataSource> source;
+    if (!feed_url.empty()) {
+        FeedAddress address;
+        auto feed = std::make_unique<FeedHandler>();
+        feed->set_busy_poll(wait_strategy == WaitStrategy::Spinning);
+        if (FeedAddress::parse(feed_url, address) &&
+            feed->open(address, std::chrono::milliseconds(static_cast<long long>(feed_timeout * 1000)))) {
+            source = std::move(feed);
+        }
+    } else {
+        source = MarketDataSource::open(data_files);
+    }
     
-    if (events.empty()) {
-        printf("[ERROR] No events loaded. Exiting.\n");
+    if (!source) {
+        printf("[ERROR] Could not open market data. Exiting.\n");
         return 1;
     }
     
-    printf("[INFO] Loaded %zu events\n\n", events.size());
+    printf("[INFO] Streaming from: %s (window: %zu events, chunk: %zu events, wait: %s)\n",
+           source->name().c_str(), window, stream_options.chunk_size,
+           wait_strategy_name(wait_strategy));
+    printf("[INFO] Replay: %s", replay_mode_name(replay_mode));
+    if (replay_mode == ReplayMode::ScaledRealTime) printf(" x%.1f", replay_speed);
+    if (stream_options.max_events > 0) printf(", max %zu events", stream_options.max_events);
+    printf("\n\n");
+    
+    if (check_features) {
+        return run_feature_check(*source, stream_options.max_events);
+    }
+    
+    const std::chrono::milliseconds deadline(deadline_ms);
+    
+    std::shared_ptr<Predictor> predictor;
+    if (!model_file.empty()) {
+        auto forest = std::make_shared<RandomForest>();
+        if (!forest->load(model_file)) {
+            printf("[ERROR] Could not load model. Exiting.\n");
+            return 1;
+        }
+        predictor = forest;
+    }
+    
+    if (transport == "shm" && !predictor) {
+        const char* name = std::getenv("ML_SHM_NAME");  // Same variable as the server
+        auto shm = std::make_shared<ShmPredictor>();
+        if (shm->open(name != nullptr && *name != '\0' ? name : "algo_ml") && shm->check_health()) {
+            if (deadline_ms > 0) shm->set_timeout(deadline);
+            predictor = shm;
+        } else {
+            printf("[WARNING] Shared-memory transport unavailable, using HTTP\n");
+        }
+    }
+    
+    size_t pipeline_depth = 1;
+    if (async_connections > 0) {
+        if (predictor) {
+            printf("[WARNING] --async ignored: it only applies to the HTTP transport\n");
+        } else {
+            auto client = std::make_shared<AsyncMLClient>("127.0.0.1", 8000, async_connections, 0,
+                                                          deadline);
+            if (!client->check_health()) {
+                printf("[WARNING] ML server not available. Strategy will not work!\n");
+            }
+            pipeline_depth = client->max_in_flight();
+            predictor = client;
+            printf("[INFO] Async inference: %zu connections, up to %zu predictions in flight\n",
+                   client->connections(), pipeline_depth);
+        }
+    }
+    
+    if (deadline_ms > 0) {
+        if (!predictor) {
+            auto client = std::make_shared<MLClient>("127.0.0.1", 8000);
+            client->set_timeouts(deadline, deadline);
+            if (!client->check_health()) {
+                printf("[WARNING] ML server not available, starting with the circuit closed anyway\n");
+            }
+            predictor = client;
+        }
+        predictor = std::make_shared<CircuitBreaker>(predictor, deadline);
+        printf("[INFO] Prediction deadline: %ld ms, fallback signal: %s\n",
+               deadline_ms, fallback_signal_name(fallback));
+    }
+    
+    if (!cache_file.empty()) {
+        if (!predictor) {
+            predictor = std::make_shared<MLClient>("127.0.0.1", 8000);
+        }
+        auto cache = std::make_shared<PredictionCache>(predictor);
+        if (!cache->open(cache_file)) {
+            printf("[ERROR] Could not open prediction cache. Exiting.\n");
+            return 1;
+        }
+        predictor = cache;
+    }
+    
+    if (sweep) {
+        return run_sweep(*source, sweep_configs, sweep_threads, initial_cash, sweep_out,
+                         stream_options.max_events, predictor);
+    }
+    
+    if (batch_inference) {
+        printf("[INFO] Batch inference: fetching predictions before replay...\n");
+        auto events = std::make_shared<std::vector<MarketDataEvent>>();
+        while (stream_options.max_events == 0 || events->size() < stream_options.max_events) {
+            size_t want = stream_options.chunk_size;
+            if (stream_options.max_events > 0) {
+                want = std::min(want, stream_options.max_events - events->size());
+            }
+            if (source->read(*events, want) == 0) break;
+        }
+        
+        std::shared_ptr<Predictor> batch_source = predictor;
+        if (!batch_source) {
+            batch_source = std::make_shared<MLClient>("127.0.0.1", 8000);
+        }
+        
+        auto precomputed = std::make_shared<PrecomputedPredictor>();
+        auto start = std::chrono::steady_clock::now();
+        
+        if (!batch_source->check_health() || !precomputed->build(
+                Span<const MarketDataEvent>(events->data(), events->size()), 10, 50, *batch_source)) {
+            printf("[ERROR] Batch inference failed. Exiting.\n");
+            return 1;
+        }
+        
+        printf("[INFO] %zu predictions for %zu events in %.2f s\n\n", precomputed->size(),
+               events->size(),
+               std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        
+        source = std::make_unique<EventBufferSource>(events, source->name());
+        predictor = precomputed;
+    }
+    
+    if (shards > 0) {
+        return run_sharded(std::move(source), shards, initial_cash, trades_file, window,
+                           wait_strategy, replay_mode, replay_speed, stream_options, predictor,
+                           batch_inference ? 1 : pipeline_depth, fallback, lock_memory);
+    }
     
     // Step 2: Create components
     printf("[2/5] Initializing components...\n");
     
+    // Trades are written as they happen, so a crash keeps what ran. A
+    // resumed run reopens the file once the checkpoint is loaded.
     auto logger = std::make_shared<TradeLogger>();
+    logger->set_writer(cpus.logger, wait_strategy == WaitStrategy::Spinning);
+    if (!resume && !logger->open(trades_file)) {
+        return 1;
+    }
     auto portfolio = std::make_shared<Portfolio>(initial_cash, logger);
     
     auto strategy = std::make_shared<MovingAverageStrategy>(
         portfolio,
         10,   // Short MA period
         50,   // Long MA period
-        0.7   // ML confidence threshold
+        0.7,  // ML confidence threshold
+        predictor
     );
+    strategy->set_pipeline_depth(batch_inference ? 1 : pipeline_depth);
+    strategy->set_fallback(fallback);
+    
+    auto engine = std::make_unique<BacktestingEngine>(strategy, window, wait_strategy);
+    engine->set_replay(replay_mode, replay_speed);
+    engine->set_cpus(cpus.producer, cpus.engine);
+    if (cpus.any()) {
+        printf("[INFO] Threads pinned to CPUs: producer %d, engine %d, trade log %d (-1 = any; %u CPUs)\n",
+               cpus.producer, cpus.engine, cpus.logger, LowLatency::cpu_count());
+    }
     
-    auto engine = std::make_unique<BacktestingEngine>(strategy);
+    auto analytics = std::make_shared<PerformanceAnalytics>(portfolio);
+    engine->set_analytics(analytics);
+    
+    if (resume && (!resume_from_checkpoint(*engine, *source, checkpoint_file, stream_options) ||
+                   !logger->reopen(trades_file))) {
+        printf("[ERROR] Could not resume from checkpoint. Exiting.\n");
+        return 1;
+    }
+    
+    std::shared_ptr<CheckpointWriter> checkpoint;
+    if (!checkpoint_file.empty()) {
+        checkpoint = std::make_shared<CheckpointWriter>(checkpoint_file, logger);
+        engine->set_checkpoint(checkpoint, std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(checkpoint_every)));
+    }
     
     printf("[INFO] Components initialized\n\n");
     
     // Step 3: Start engine
     printf("[3/5] Starting backtesting engine...\n");
     engine->start();
+    lock_hot_memory(lock_memory);
     
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
     printf("[INFO] Engine started\n\n");
     
     // Step 4: Feed events
     printf("[4/5] Processing market events...\n");
     printf("========================================\n\n");
-    int count = 0;
-    for (const auto& event : events) {
-        if (count++ >= 200) break;  // Only 100 events
-        engine->add_event(event);
-        
-        // Small delay to simulate real-time (optional)
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
+    engine->stream_from(std::move(source), stream_options);
+    engine->wait_for_stream();
     
     printf("\n========================================\n");
     printf("[INFO] All events processed\n\n");
@@ -79,17 +785,21 @@ int main() {
     // Wait for engine to fully stop
     // std::this_thread::sleep_for(std::chrono::milliseconds(500));
     
-    // Save trades to CSV
-    logger->save_to_csv(trades_file);
+    // Write out the trades still buffered, then the final checkpoint
+    logger->close();
+    if (checkpoint) checkpoint->close();
     
     // Print portfolio summary
-    std::map<std::string, double> final_prices;
-    if (!events.empty()) {
-        final_prices[events.back().symbol] = events.back().close;
+    std::map<SymbolId, double> final_prices;
+    if (engine->events_processed() > 0) {
+        MarketDataEvent last = engine->last_event();
+        final_prices[last.symbol_id] = last.close;
     }
     
     printf("\n");
     portfolio->print_summary(final_prices);
+    analytics->print_report();
+    analytics->save_equity_curve(equity_curve_file);
     
     printf("\n========================================\n");
     printf("  BACKTESTING COMPLETE!\n");
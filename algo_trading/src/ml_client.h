@@ -1,5 +1,8 @@
 #pragma once
 
+#include "Predictor.h"
+#include "Metrics.h"
+#include <chrono>
 #include <string>
 #include <vector>
 #include <nlohmann/json.hpp>
@@ -7,32 +10,28 @@
 
 using json = nlohmann::json;
 
-struct MLPrediction {
-    int prediction;
-    std::vector<double> probabilities;
-    double score;
-    std::string model_version;
-    bool success;
-    std::string error_message;
-    
-    MLPrediction()
-        : prediction(0), score(0.0), success(false) {}
-};
-
-class MLClient {
+class MLClient : public Predictor {
 private:
     std::string host_;
     int port_;
     httplib::Client client_;
+    std::string model_version_;  // As reported by /health
     
 public:
     MLClient(const std::string& host = "127.0.0.1", int port = 8000)
         : host_(host), port_(port), client_(host_ + ":" + std::to_string(port_)) {
         client_.set_connection_timeout(5, 0);  // 5 seconds
         client_.set_read_timeout(10, 0);       // 10 seconds
+        client_.set_keep_alive(true);          // One connection for the whole run
+    }
+    
+    // Caps how long one request may take to connect and to read its answer.
+    void set_timeouts(std::chrono::milliseconds connect, std::chrono::milliseconds read) {
+        client_.set_connection_timeout(connect.count() / 1000, (connect.count() % 1000) * 1000);
+        client_.set_read_timeout(read.count() / 1000, (read.count() % 1000) * 1000);
     }
     
-    bool check_health() {
+    bool check_health() override {
         auto res = client_.Get("/health");
         
         if (!res) {
@@ -54,6 +53,10 @@ public:
                 return false;
             }
             
+            if (response.contains("model_version") && response["model_version"].is_string()) {
+                model_version_ = response["model_version"].get<std::string>();
+            }
+            
             printf("[ML] Health check: OK\n");
             return true;
         }
@@ -63,8 +66,12 @@ public:
         }
     }
     
+    std::string model_version() const override {
+        return model_version_;
+    }
+    
     MLPrediction predict(const std::string& symbol, std::time_t timestamp,
-                         const std::vector<double>& features) {
+                         const std::vector<double>& features) override {
         MLPrediction result;
         
         // Build JSON request
@@ -77,7 +84,11 @@ public:
         std::string request_body = request.dump();
         
         // Make POST request
-        auto res = client_.Post("/predict", request_body, "application/json");
+        httplib::Result res;
+        {
+            METRICS_SCOPE(METRIC_HTTP_ROUND_TRIP);
+            res = client_.Post("/predict", request_body, "application/json");
+        }
         
         if (!res) {
             result.error_message = "Connection failed";
@@ -111,4 +122,55 @@ public:
         
         return result;
     }
+    
+    // One /predict_batch call for all rows.
+    bool predict_batch(const double* features, size_t rows, size_t feature_count,
+                       std::vector<MLPrediction>& out) override {
+        json matrix = json::array();
+        for (size_t i = 0; i < rows; ++i) {
+            const double* row = features + i * feature_count;
+            matrix.push_back(std::vector<double>(row, row + feature_count));
+        }
+        
+        json request = {{"features", std::move(matrix)}};
+        auto res = client_.Post("/predict_batch", request.dump(), "application/json");
+        
+        if (!res) {
+            printf("[ML] Batch prediction failed: Connection error\n");
+            return false;
+        }
+        
+        if (res->status != 200) {
+            printf("[ML] Batch prediction failed: HTTP %d\n", res->status);
+            return false;
+        }
+        
+        try {
+            json response = json::parse(res->body);
+            const json& predictions = response["predictions"];
+            const json& probabilities = response["probabilities"];
+            const json& scores = response["scores"];
+            std::string model_version = response["model_version"].get<std::string>();
+            
+            if (predictions.size() != rows || probabilities.size() != rows || scores.size() != rows) {
+                printf("[ML] Batch prediction failed: expected %zu rows, got %zu\n",
+                       rows, predictions.size());
+                return false;
+            }
+            
+            out.resize(rows);
+            for (size_t i = 0; i < rows; ++i) {
+                out[i].prediction = predictions[i].get<int>();
+                out[i].probabilities = probabilities[i].get<std::vector<double>>();
+                out[i].score = scores[i].get<double>();
+                out[i].model_version = model_version;
+                out[i].success = true;
+            }
+            return true;
+        }
+        catch (const std::exception& e) {
+            printf("[ML] Parse error: %s\n", e.what());
+            return false;
+        }
+    }
 };
@@ -12,6 +12,11 @@ import uvicorn
 import logging
 from datetime import datetime
 import os
+import platform
+import struct
+import threading
+import time
+from multiprocessing import shared_memory
 
 logging.basicConfig(
     level=logging.INFO,
@@ -28,6 +33,23 @@ app = FastAPI(
 model = None
 MODEL_FILE = "model.pkl"
 
+# Shared-memory transport (see algo_trading/src/ShmPredictor.h for the
+# layout). Set ML_SHM_NAME to an empty string to disable it.
+SHM_NAME = os.environ.get("ML_SHM_NAME", "algo_ml")
+SHM_SLOTS = 256
+SHM_HEADER_SIZE = 128
+SHM_SLOT_SIZE = 128
+SHM_HEADER_FORMAT = "<8sIIIIIIQ32s"
+SHM_MAGIC = b"ALGOSHMQ"
+SHM_VERSION = 1
+SHM_FEATURES = 8
+SLOT_REQUEST = 2
+SLOT_RESPONSE = 3
+
+shm_segment = None
+shm_stop = threading.Event()
+shm_thread = None
+
 class PredictionRequest(BaseModel):
     """Request schema for prediction endpoint."""
     symbol: str = Field(..., description="Stock ticker symbol")
@@ -48,6 +70,20 @@ class PredictionResponse(BaseModel):
     score: float = Field(..., description="Confidence score")
     model_version: str
 
+class BatchPredictionRequest(BaseModel):
+    """Request schema for batch prediction endpoint."""
+    features: List[List[float]] = Field(
+        ...,
+        description="One feature vector per row, same order as /predict"
+    )
+
+class BatchPredictionResponse(BaseModel):
+    """Response schema for batch prediction endpoint (row i answers features[i])."""
+    predictions: List[int] = Field(..., description="0 = SELL, 1 = BUY")
+    probabilities: List[List[float]] = Field(..., description="[P(SELL), P(BUY)] per row")
+    scores: List[float] = Field(..., description="Confidence score per row")
+    model_version: str
+
 class HealthResponse(BaseModel):
     """Health check response."""
     status: str
@@ -76,10 +112,132 @@ async def load_model():
         logger.info(f"Model type: {type(model).__name__}")
         logger.info("=" * 60)
         
+        start_shm_transport()
+    
     except Exception as e:
         logger.error(f"Failed to load model: {str(e)}")
         raise
 
+def _pid_alive(pid):
+    """True if a process with this pid exists."""
+    try:
+        os.kill(pid, 0)
+        return True
+    except ProcessLookupError:
+        return False
+    except PermissionError:
+        return True
+
+def _write_shm_header(buf, heartbeat_ns):
+    struct.pack_into(
+        SHM_HEADER_FORMAT, buf, 0,
+        SHM_MAGIC, SHM_VERSION, SHM_SLOTS, SHM_FEATURES, SHM_SLOT_SIZE,
+        os.getpid(), 0, heartbeat_ns, MODEL_FILE.encode()[:32]
+    )
+
+def _create_shm_segment():
+    """Create the segment, replacing one left behind by a dead server.
+    
+    Returns None if a live server (e.g. another uvicorn worker) owns it.
+    """
+    size = SHM_HEADER_SIZE + SHM_SLOTS * SHM_SLOT_SIZE
+    try:
+        return shared_memory.SharedMemory(name=SHM_NAME, create=True, size=size)
+    except FileExistsError:
+        stale = shared_memory.SharedMemory(name=SHM_NAME)
+        owner = struct.unpack_from("<I", stale.buf, 24)[0]
+        if owner != 0 and _pid_alive(owner):
+            stale.close()
+            return None
+        stale.close()
+        stale.unlink()
+        return shared_memory.SharedMemory(name=SHM_NAME, create=True, size=size)
+
+def shm_reader_loop(segment):
+    """Answer requests posted to shared-memory slots until shm_stop is set.
+    
+    All slots found in REQUEST state are predicted together, then flipped to
+    RESPONSE after their results are written. Spins briefly when idle, then
+    backs off to short sleeps so an idle server stays cheap.
+    """
+    buf = segment.buf
+    base = SHM_HEADER_SIZE
+    stride = SHM_SLOT_SIZE
+    states = np.ndarray((SHM_SLOTS,), dtype="<u4", buffer=buf, offset=base, strides=(stride,))
+    predictions = np.ndarray((SHM_SLOTS,), dtype="<i4", buffer=buf, offset=base + 4, strides=(stride,))
+    features = np.ndarray((SHM_SLOTS, SHM_FEATURES), dtype="<f8", buffer=buf,
+                          offset=base + 16, strides=(stride, 8))
+    probabilities = np.ndarray((SHM_SLOTS, 2), dtype="<f8", buffer=buf,
+                               offset=base + 80, strides=(stride, 8))
+    scores = np.ndarray((SHM_SLOTS,), dtype="<f8", buffer=buf, offset=base + 96, strides=(stride,))
+    
+    idle = 0
+    last_beat = 0
+    while not shm_stop.is_set():
+        now = time.time_ns()
+        if now - last_beat > 100_000_000:
+            struct.pack_into("<Q", buf, 32, now)
+            last_beat = now
+        
+        ready = np.flatnonzero(states == SLOT_REQUEST)
+        if ready.size == 0:
+            idle += 1
+            if idle > 2000:
+                time.sleep(0.0005)
+            continue
+        idle = 0
+        
+        rows = features[ready]
+        row_predictions = model.predict(rows).astype(int)
+        row_probabilities = model.predict_proba(rows)
+        
+        predictions[ready] = row_predictions
+        probabilities[ready] = row_probabilities
+        scores[ready] = row_probabilities[np.arange(len(ready)), row_predictions]
+        states[ready] = SLOT_RESPONSE  # Publish after the payload
+    
+    del states, predictions, features, probabilities, scores
+
+def start_shm_transport():
+    """Serve the shared-memory transport from a background thread."""
+    global shm_segment, shm_thread
+    
+    if not SHM_NAME:
+        return
+    # The slots are published without fences, which is only safe with
+    # x86-64 store ordering (see ShmPredictor.h)
+    if platform.machine().lower() not in ("x86_64", "amd64"):
+        logger.info(f"Shared-memory transport needs x86-64, not {platform.machine()}; HTTP only")
+        return
+    try:
+        segment = _create_shm_segment()
+    except Exception as e:
+        logger.warning(f"Shared-memory transport unavailable: {str(e)}")
+        return
+    if segment is None:
+        logger.info(f"Shared-memory transport /{SHM_NAME} served by another worker")
+        return
+    
+    segment.buf[:] = bytes(len(segment.buf))
+    _write_shm_header(segment.buf, time.time_ns())
+    shm_segment = segment
+    shm_thread = threading.Thread(target=shm_reader_loop, args=(segment,), daemon=True)
+    shm_thread.start()
+    logger.info(f"Shared-memory transport on /{SHM_NAME} ({SHM_SLOTS} slots)")
+
+@app.on_event("shutdown")
+async def stop_shm_transport():
+    """Stop the reader and remove the segment."""
+    global shm_segment
+    
+    if shm_segment is None:
+        return
+    shm_stop.set()
+    shm_thread.join()
+    shm_segment.close()
+    shm_segment.unlink()
+    shm_segment = None
+
 @app.get("/")
 async def root():
     """Root endpoint."""
@@ -141,6 +299,43 @@ async def predict(request: PredictionRequest):
         logger.error(f"Prediction error: {str(e)}")
         raise HTTPException(status_code=500, detail=str(e))
 
+@app.post("/predict_batch", response_model=BatchPredictionResponse)
+async def predict_batch(request: BatchPredictionRequest):
+    """Make trading predictions for many feature vectors in one call."""
+    
+    if model is None:
+        raise HTTPException(
+            status_code=503, 
+            detail="Model not loaded"
+        )
+    
+    try:
+        features_array = np.array(request.features, dtype=np.float64)
+        
+        if features_array.ndim != 2 or features_array.shape[1] != 8:
+            raise ValueError(f"Expected rows of 8 features, got shape {features_array.shape}")
+        
+        logger.info(f"Batch prediction request for {features_array.shape[0]} rows")
+        
+        # Same calls as /predict, vectorized over all rows
+        predictions = model.predict(features_array).astype(int)
+        probabilities = model.predict_proba(features_array)
+        scores = probabilities[np.arange(len(predictions)), predictions]
+        
+        return BatchPredictionResponse(
+            predictions=predictions.tolist(),
+            probabilities=probabilities.tolist(),
+            scores=scores.tolist(),
+            model_version=MODEL_FILE
+        )
+        
+    except ValueError as e:
+        logger.error(f"Validation error: {str(e)}")
+        raise HTTPException(status_code=400, detail=str(e))
+    except Exception as e:
+        logger.error(f"Prediction error: {str(e)}")
+        raise HTTPException(status_code=500, detail=str(e))
+
 def main():
     """Run the FastAPI server."""
     uvicorn.run(
@@ -11,6 +11,7 @@ from sklearn.metrics import classification_report, accuracy_score
 import joblib
 import warnings
 import os
+import struct
 warnings.filterwarnings('ignore')
 
 
@@ -174,6 +175,73 @@ def save_model(model, filename='model.pkl'):
     print(f"[INFO] File size: {os.path.getsize(filename) / 1024:.2f} KB")
 
 
+FOREST_MAGIC = b'ALGOFRST'
+FOREST_VERSION = 1
+
+
+def export_forest(model, filename='model.forest', model_version='model.pkl'):
+    """
+    Export the Random Forest to the flat binary format evaluated in process by
+    the C++ backtester (algo_trading/src/RandomForest.h).
+    
+    Layout (little-endian):
+      64-byte header: magic, version, feature_count, tree_count, class_count,
+                      node_count, model_version (32 bytes, NUL-padded)
+      uint32 root node index per tree, padded to a multiple of 16 bytes
+      16-byte nodes: float64 threshold (leaf: P(BUY)), uint32 right child,
+                     int32 feature (-1 = leaf)
+    
+    Each tree is written in depth-first preorder, so a split's left child is
+    the node right after it.
+    """
+    if [int(c) for c in model.classes_] != [0, 1]:
+        raise ValueError(f"Expected classes [0, 1], got {list(model.classes_)}")
+    
+    roots = []
+    nodes = []  # [value, right, feature]
+    
+    for estimator in model.estimators_:
+        tree = estimator.tree_
+        roots.append(len(nodes))
+        
+        # (sklearn node, index of the split whose right child this is)
+        stack = [(0, None)]
+        while stack:
+            node_id, parent = stack.pop()
+            index = len(nodes)
+            if parent is not None:
+                nodes[parent][1] = index
+            
+            left = tree.children_left[node_id]
+            right = tree.children_right[node_id]
+            
+            if left == right:  # Leaf
+                counts = tree.value[node_id][0]
+                total = float(counts.sum())
+                prob_buy = float(counts[1]) / total if total > 0 else 0.0
+                nodes.append([prob_buy, 0, -1])
+            else:
+                nodes.append([float(tree.threshold[node_id]), 0, int(tree.feature[node_id])])
+                stack.append((right, index))
+                stack.append((left, None))  # Popped next, so it lands at index + 1
+    
+    version = model_version.encode('utf-8')[:31]
+    header = struct.pack('<8sIIIIQ32s', FOREST_MAGIC, FOREST_VERSION,
+                         int(model.n_features_in_), len(roots), 2, len(nodes), version)
+    
+    roots_blob = struct.pack(f'<{len(roots)}I', *roots)
+    roots_blob += b'\0' * (-len(roots_blob) % 16)
+    
+    with open(filename, 'wb') as f:
+        f.write(header)
+        f.write(roots_blob)
+        for value, right, feature in nodes:
+            f.write(struct.pack('<dIi', value, right, feature))
+    
+    print(f"[INFO] Forest exported to: {filename} ({len(roots)} trees, {len(nodes)} nodes)")
+    print(f"[INFO] File size: {os.path.getsize(filename) / 1024:.2f} KB")
+
+
 def main():
     """Main training pipeline - REAL DATA VERSION."""
     
@@ -238,6 +306,7 @@ def main():
     
     # Save model
     save_model(model, 'model.pkl')
+    export_forest(model, 'model.forest', model_version='model.pkl')
     
     print("\n" + "=" * 60)
     print("TRAINING COMPLETE!")
@@ -246,6 +315,7 @@ def main():
     print("\nNext steps:")
     print("1. Start the FastAPI server: python main_ml_api.py")
     print("2. Run the C++ backtester")
+    print("   (or skip the server: AlgoTradingSystem --model ../backend_python/model.forest)")
     print("\n")
 
 